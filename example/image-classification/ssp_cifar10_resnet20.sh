@@ -1,7 +1,6 @@
 
 python ../../tools/kill-mxnet.py hosts
 python ./scp_data_sharding.py
-python ./recover_ssp_miniters.py
 export PS_VERBOSE=1
 ../../tools/launch.py -H hosts -n 5 -s 5 -i eth1 --launcher ssh -H hosts \
 python train_resnet.py --data-dir /home/yegeyan/mxnet_data/cifar10/ \
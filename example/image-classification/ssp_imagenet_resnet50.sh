@@ -1,6 +1,5 @@
 python ../../tools/kill-mxnet.py hosts
 python ./scp_data_sharding.py
-python ./recover_ssp_miniters.py
 export PS_VERBOSE=1
 ../../tools/launch.py -H hosts -n 37 -s 37 -i ib0 --launcher ssh -H hosts \
 python train_resnet.py --data-dir /home/mxnet_data/ilsvrc12/ \
@@ -6,6 +6,10 @@ import os
 import getpass
 
 def fit(args, network, data_loader, batch_end_callback=None):
+    # number of worker groups in dist_gsync, the servers start with them and
+    # regroup workers by speed
+    group_num = int(os.environ.get('MXNET_KVSTORE_NUM_GROUPS', 2))
+
     # kvstore
     kv = mx.kvstore.create(args.kv_store)
 
@@ -73,8 +77,6 @@ def fit(args, network, data_loader, batch_end_callback=None):
 
     epoch_size = args.num_examples / args.batch_size
     batch_num = args.num_examples / args.batch_size #yegeyan 2016.12.13
-    groups_path = '/home/' + getpass.getuser() + '/MXNet-G/example/image-classification/groups'
-    group_num = len(open(groups_path, 'rU').readlines()) #yegeyan 2016.12.13
     
     if args.kv_store == 'dist_sync':
         epoch_size /= kv.num_workers
@@ -62,6 +62,10 @@ MXNET_EXTERN_C typedef void (*ExecutorMonitorCallback)(const char*,
                                                        NDArrayHandle,
                                                        void *);
 
+MXNET_EXTERN_C typedef void (*ExecutorGradReadyCallback)(mx_uint,
+                                                         NDArrayHandle,
+                                                         void *);
+
 MXNET_EXTERN_C {
 struct NativeOpInfo {
   void (*forward)(int, float**, int*, unsigned**, int*, void*);
@@ -161,6 +165,19 @@ MXNET_DLL int MXRandomSeed(int seed);
  * \return 0 when success, -1 when failure happens.
  */
 MXNET_DLL int MXNotifyShutdown();
+/*!
+ * \brief Start or stop recording the operations executed by the engine.
+ * \param state 1 to start, 0 to stop.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXSetProfilerState(int state);
+/*!
+ * \brief Write the operations recorded in the chrome tracing format,
+ *  to open in chrome://tracing. Should be called once stopped.
+ * \param filename the file written.
+ * \return 0 when success, -1 when failure happens.
+ */
+MXNET_DLL int MXDumpProfile(const char *filename);
 //-------------------------------------
 // Part 1: NDArray creation and deletion
 //-------------------------------------
@@ -992,6 +1009,19 @@ MXNET_DLL int MXExecutorBindEX(SymbolHandle symbol_handle,
 MXNET_DLL int MXExecutorSetMonitorCallback(ExecutorHandle handle,
                                            ExecutorMonitorCallback callback,
                                            void* callback_handle);
+/*!
+ * \brief set a call back fired during backward once the gradient of an
+ *  argument is final. the callback receives the argument index and a new
+ *  handle to the gradient, which it is responsible to free. operations on the
+ *  gradient pushed by the callback wait for the gradient to be computed.
+ * \param handle the executor handle
+ * \param callback the callback
+ * \param callback_handle the last argument passed to callback
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXExecutorSetGradReadyCallback(ExecutorHandle handle,
+                                             ExecutorGradReadyCallback callback,
+                                             void* callback_handle);
 //--------------------------------------------
 // Part 5: IO Interface
 //--------------------------------------------
@@ -1161,6 +1191,38 @@ MXNET_DLL int MXKVStorePull(KVStoreHandle handle,
                             const int* keys,
                             NDArrayHandle* vals,
                             int priority);
+/*!
+ * \brief Push only some rows of a list of (key,value) pairs to kvstore
+ * \param handle handle to the kvstore
+ * \param num the number of key-value pairs
+ * \param keys the list of keys
+ * \param vals the list of values
+ * \param row_ids the list of the row ids of each value
+ * \param priority the priority of the action
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStorePushRowSparse(KVStoreHandle handle,
+                                     mx_uint num,
+                                     const int* keys,
+                                     NDArrayHandle* vals,
+                                     NDArrayHandle* row_ids,
+                                     int priority);
+/*!
+ * \brief pull only some rows of a list of (key, value) pairs from the kvstore
+ * \param handle handle to the kvstore
+ * \param num the number of key-value pairs
+ * \param keys the list of keys
+ * \param vals the list of values
+ * \param row_ids the list of the row ids of each value
+ * \param priority the priority of the action
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStorePullRowSparse(KVStoreHandle handle,
+                                     mx_uint num,
+                                     const int* keys,
+                                     NDArrayHandle* vals,
+                                     NDArrayHandle* row_ids,
+                                     int priority);
 /*!
  * \brief user-defined updater for the kvstore
  * It's this updater's responsibility to delete \a recv and \a local
@@ -1255,6 +1317,69 @@ MXNET_DLL int MXKVStoreIsSchedulerNode(int *ret);
  */
 MXNET_DLL int MXKVStoreBarrier(KVStoreHandle handle);
 
+/**
+ * \brief block until all workers have finished at least \a clock iterations
+ *
+ * \param handle handle to the KVStore
+ * \param clock the required iteration clock
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStoreWaitForClock(KVStoreHandle handle, int clock);
+
+/**
+ * \brief regroup the workers by their speeds, for the group synchronous mode
+ *
+ * \param handle handle to the KVStore
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStoreRegroupWorkers(KVStoreHandle handle);
+
+/**
+ * \brief compress the gradients pushed to servers
+ *
+ * \param handle handle to the KVStore
+ * \param num_params number of compression parameters
+ * \param keys the parameter keys
+ * \param vals the parameter values
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStoreSetGradientCompression(KVStoreHandle handle,
+                                              mx_uint num_params,
+                                              const char** keys,
+                                              const char** vals);
+
+/**
+ * \brief update on the servers with a C++ optimizer instead of the updater
+ *
+ * \param handle handle to the KVStore
+ * \param name the name the optimizer is registered with
+ * \param num_params number of parameters
+ * \param keys the parameter keys
+ * \param vals the parameter values
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStoreSetServerOptimizer(KVStoreHandle handle,
+                                          const char* name,
+                                          mx_uint num_params,
+                                          const char** keys,
+                                          const char** vals);
+
+/**
+ * \brief return where the values of a key are stored
+ *
+ * \param handle handle to the KVStore
+ * \param key the key
+ * \param num_parts number of consecutive parts of the key
+ * \param servers the server rank of each part
+ * \param sizes the number of values of each part
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXKVStoreGetKeyPlacement(KVStoreHandle handle,
+                                       int key,
+                                       mx_uint *num_parts,
+                                       const int **servers,
+                                       const int **sizes);
+
 /**
  * \brief whether to do barrier when finalize
  *
@@ -10,6 +10,7 @@
 #include <vector>
 #include <unordered_map>
 #include <string>
+#include <utility>
 #include <functional>
 #include <atomic>
 #include "./ndarray.h"
@@ -129,9 +130,52 @@ class KVStore {
   virtual void Pull(const std::vector<int>& keys,
                     const std::vector<NDArray*>& values,
                     int priority = 0) = 0;
+  /*!
+   * \brief push only some rows of a list of key-value pairs into the store
+   *
+   * It is \ref Push for values of which only the rows given by \a row_ids
+   * are meant, such as the gradient of an embedding, whose rows are the ids
+   * seen in a batch. The other rows of a value are ignored, whatever they
+   * hold. The rows pushed for a key by different values are summed.
+   *
+   * With type == "dist", only these rows are sent and merged, and the
+   * servers update only them if they run a C++ optimizer (see \ref
+   * SetServerOptimizer), leaving the other rows and their optimizer states
+   * untouched.
+   *
+   * \param keys the list of keys
+   * \param values the list of values, each a matrix of rows along the first
+   *   dimension
+   * \param row_ids the row ids of each value, any shape, in real_t
+   * \param priority Priority of the action.
+   */
+  virtual void PushRowSparse(const std::vector<int>& keys,
+                             const std::vector<NDArray>& values,
+                             const std::vector<NDArray>& row_ids,
+                             int priority = 0) = 0;
+  /*!
+   * \brief pull only some rows of a list of key-value pairs from the store
+   *
+   * It is \ref Pull writing only the rows of each value given by \a row_ids,
+   * the other rows are left as they are. With type == "dist", only these
+   * rows are sent.
+   *
+   * \param keys the list of keys
+   * \param values the list of buffers for the pulled data, they should be preallocated
+   * \param row_ids the row ids of each value, any shape, in real_t
+   * \param priority Priority of the action.
+   */
+  virtual void PullRowSparse(const std::vector<int>& keys,
+                             const std::vector<NDArray*>& values,
+                             const std::vector<NDArray>& row_ids,
+                             int priority = 0) = 0;
 
   /**
    * \brief the prototype of user-defined updater
+   *
+   * The last argument is the scale the received value should be divided by:
+   * the number of merged pushes times their staleness. A stale gradient is
+   * therefore applied with a damped learning rate.
    */
   //typedef std::function<void(int, const NDArray&, NDArray*)> Updater;
   typedef std::function<void(int, const NDArray&, NDArray*, int)> Updater;
@@ -254,6 +298,77 @@ class KVStore {
    */
   virtual void Barrier() { }
 
+  /*!
+   * \brief block until all workers have finished at least \a clock iterations
+   *
+   * The iteration clock of a worker is the number of pushes it has issued on
+   * every key. It is used by the stale synchronous mode: a worker at iteration
+   * t with staleness s calls WaitForClock(t - s + 1) before the next
+   * iteration, so that it stays less than s iterations ahead of the slowest.
+   * It is called once per iteration, so that a server restored from a
+   * checkpoint recovers the clock of the worker from the number of calls.
+   *
+   * Always returns immediately when type == "local"
+   *
+   * \param clock the required clock
+   */
+  virtual void WaitForClock(int clock) { }
+
+  /*!
+   * \brief regroup the workers by their measured speeds
+   *
+   * Used by the group synchronous mode: workers of similar speeds are put
+   * into the same group. The servers switch each key to the new groups
+   * within one round of pushes on it.
+   *
+   * Does nothing when type != "dist_gsync"
+   */
+  virtual void RegroupWorkers() { }
+
+  /*!
+   * \brief compress the gradients pushed to servers
+   *
+   * All workers must call it with the same parameters before pushing, see
+   * GradientCompressionParam for the accepted keys. The residual of the
+   * compression is kept on the worker and added to the next push.
+   *
+   * Does nothing when type == "local"
+   *
+   * \param kwargs the compression parameters
+   */
+  virtual void SetGradientCompression(
+      const std::vector<std::pair<std::string, std::string> >& kwargs) { }
+
+  /*!
+   * \brief update on the servers with a C++ optimizer instead of the updater
+   *
+   * The servers create the optimizer registered as \a name by
+   * MXNET_REGISTER_OPTIMIZER and update keys in parallel without calling
+   * back into the frontend. Besides the parameters of the optimizer, \a
+   * kwargs may hold the learning rate schedule and the per key multipliers
+   * accepted by ServerOptimizerParam. All workers must call it before
+   * pushing.
+   *
+   * Does nothing when type == "local"
+   *
+   * \param name the registered name of the optimizer
+   * \param kwargs the parameters
+   */
+  virtual void SetServerOptimizer(
+      const std::string& name,
+      const std::vector<std::pair<std::string, std::string> >& kwargs) { }
+
+  /*!
+   * \brief return where the values of \a key are stored
+   *
+   * \param key the key
+   * \return (server rank, number of values) of each consecutive part of the
+   * key, empty if unknown or when type == "local"
+   */
+  virtual std::vector<std::pair<int, int> > GetKeyPlacement(int key) {
+    return std::vector<std::pair<int, int> >();
+  }
+
   /**
    * \brief Send a command to all server nodes
    *
@@ -57,6 +57,47 @@ class Optimizer {
    */
   virtual void Update(const int index, NDArray *weight,
                       const NDArray *grad, const float lr, const float wd) = 0;
+  /*!
+   * \brief Update some ranges of a weight only, leaving the other elements
+   *  and their states untouched. It runs on cpu.
+   * \param index the unique index for the weight.
+   * \param weight the weight to update.
+   * \param grad gradient of the same shape as weight, only read in the ranges.
+   * \param ranges the offset and the length of each range of the flattened
+   *  weight, sorted and disjoint.
+   * \param lr learning rate for this update.
+   * \param wd weight decay for this update.
+   */
+  virtual void UpdateRanges(const int index, NDArray *weight, const NDArray *grad,
+                            const std::vector<std::pair<size_t, size_t> > &ranges,
+                            const float lr, const float wd) {
+    LOG(FATAL) << "the optimizer does not update ranges";
+  }
+  /*!
+   * \brief Get the states of a weight, in order to save them. The arrays
+   *  returned are the ones the next Update writes, so copy them before.
+   *  Optimizers with states override it and SetState.
+   * \param index the unique index for the weight.
+   * \param arrays set to the state arrays, empty if none is created yet.
+   * \param counters set to the integer states.
+   */
+  virtual void GetState(const int index, std::vector<NDArray> *arrays,
+                        std::vector<int> *counters) {
+    arrays->clear();
+    counters->clear();
+  }
+  /*!
+   * \brief Restore the states of a weight got by GetState.
+   * \param index the unique index for the weight.
+   * \param weight the weight the states belong to.
+   * \param arrays the state arrays, copied.
+   * \param counters the integer states.
+   */
+  virtual void SetState(const int index, const NDArray *weight,
+                        const std::vector<NDArray> &arrays,
+                        const std::vector<int> &counters) {
+    CHECK(arrays.empty() && counters.empty()) << "the optimizer has no state";
+  }
   /*!
    * \brief create Optimizer
    * \param type_name the type string of the Optimizer
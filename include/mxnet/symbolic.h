@@ -389,6 +389,19 @@ class Executor {
    * \brief Install a callback to notify the completion of operation.
    */
   virtual void SetMonitorCallback(const MonitorCallback& callback) {}
+  /*!
+   * \brief the prototype of the callback notified that the gradient of the
+   *  index-th argument is final
+   */
+  typedef std::function<void(int, const NDArray&)> GradReadyCallback;
+  /*!
+   * \brief Install a callback fired by Backward for each argument gradient,
+   *  right after the operator producing it is pushed to the engine.
+   *  Operations on the gradient pushed in the callback, such as a KVStore
+   *  push, start as soon as it is computed, while the operators of earlier
+   *  layers are still running.
+   */
+  virtual void SetGradReadyCallback(const GradReadyCallback& callback) {}
 };  // class operator
 }  // namespace mxnet
 #endif  // MXNET_SYMBOLIC_H_
\ No newline at end of file
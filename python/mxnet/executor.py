@@ -24,6 +24,13 @@ def _monitor_callback_wrapper(callback):
         callback(name, array)
     return callback_handle
 
+def _grad_ready_callback_wrapper(callback):
+    """ a wrapper for the user-defined gradient ready handle """
+    def callback_handle(index, array, _):
+        """ ctypes function """
+        callback(index, NDArray(ctypes.cast(array, NDArrayHandle)))
+    return callback_handle
+
 class Executor(object):
     """ Executor is the actual executing object of MXNet."""
     def __init__(self, handle, symbol, ctx, grad_req, group2ctx):
@@ -51,6 +58,7 @@ class Executor(object):
         self._aux_dict = None
         self._output_dict = None
         self._monitor_callback = None
+        self._grad_ready_callback = None
         self._ctx = copy.deepcopy(ctx)
         self._grad_req = copy.deepcopy(grad_req)
         self._group2ctx = copy.deepcopy(group2ctx)
@@ -161,6 +169,27 @@ class Executor(object):
             self._monitor_callback,
             None))
 
+    def set_grad_ready_callback(self, callback):
+        """Install a callback fired during backward once the gradient of an
+        argument is final.
+
+        Operations on the gradient issued in the callback, such as a kvstore
+        push, start as soon as the gradient is computed, while the gradients
+        of earlier layers are still being computed.
+
+        Parameters
+        ----------
+        callback : function
+            Takes the index of the argument in list_arguments() and the
+            gradient NDArray.
+        """
+        cb_type = ctypes.CFUNCTYPE(None, mx_uint, NDArrayHandle, ctypes.c_void_p)
+        self._grad_ready_callback = cb_type(_grad_ready_callback_wrapper(callback))
+        check_call(_LIB.MXExecutorSetGradReadyCallback(
+            self.handle,
+            self._grad_ready_callback,
+            None))
+
     @property
     def arg_dict(self):
         """Get dictionary representation of argument arrrays.
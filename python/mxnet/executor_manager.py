@@ -239,6 +239,27 @@ class DataParallelExecutorGroup(object):
                            for i in range(len(self.aux_names))]
 
         self.slices = slices
+        # state of the gradient ready callbacks, which are installed on the
+        # first backward asking for them. it must not refer to the executors,
+        # otherwise they are never freed
+        self._grad_ready_state = None
+
+    def _install_grad_ready(self):
+        """ install the gradient ready callbacks on the executors """
+        num_devs = len(self.train_execs)
+        param_pos = {idx: pos for pos, idx in enumerate(self.param_idx)}
+        state = {'callback': None, 'count': []}
+        def on_grad_ready(index, _):
+            """ fire the callback once the gradient is ready on all devices """
+            pos = param_pos.get(index)
+            if pos is None or state['callback'] is None:
+                return
+            state['count'][pos] += 1
+            if state['count'][pos] == num_devs:
+                state['callback'](pos)
+        for texec in self.train_execs:
+            texec.set_grad_ready_callback(on_grad_ready)
+        self._grad_ready_state = state
 
     def load_data_batch(self, data_batch):
         """ load data and labels into arrays """
@@ -250,10 +271,25 @@ class DataParallelExecutorGroup(object):
         for texec in self.train_execs:
             texec.forward(is_train=is_train)
 
-    def backward(self):
-        """ Perform a backward pass on each executor """
+    def backward(self, grad_ready=None):
+        """ Perform a backward pass on each executor
+
+        Parameters
+        ----------
+        grad_ready : function, optional
+            Called with the index of a parameter in param_names as soon as
+            its gradients are final on all devices, while the gradients of
+            earlier layers are still being computed.
+        """
+        if grad_ready is not None and self._grad_ready_state is None:
+            self._install_grad_ready()
+        if self._grad_ready_state is not None:
+            self._grad_ready_state['callback'] = grad_ready
+            self._grad_ready_state['count'] = [0] * len(self.param_idx)
         for texec in self.train_execs:
             texec.backward()
+        if self._grad_ready_state is not None:
+            self._grad_ready_state['callback'] = None
 
     def update_metric(self, metric, labels):
         """ Update evaluation metric with label and current outputs """
@@ -397,9 +433,9 @@ class DataParallelExecutorManager(object):
         """run forward on the current executor"""
         self.curr_execgrp.forward(is_train=is_train)
 
-    def backward(self):
+    def backward(self, grad_ready=None):
         """run backward on the current executor"""
-        self.curr_execgrp.backward()
+        self.curr_execgrp.backward(grad_ready=grad_ready)
 
     def update_metric(self, metric, labels):
         """update metric with the current executor"""
@@ -229,12 +229,86 @@ class KVStore(object):
             self.handle, mx_uint(len(ckeys)), ckeys, cvals,
             ctypes.c_int(priority)))
 
+    def row_sparse_push(self, key, value, row_ids, priority=0):
+        """ Push only the rows given by row_ids of a single value or a sequence of values.
+
+        It is `push` for values of which only some rows are meant, such as the
+        gradient of an `Embedding` with `sparse_grad=True`, whose rows are the
+        ids in the batch. The other rows are ignored, whatever they hold.
+
+        With a `dist` store, only these rows are sent and merged, and a server
+        running a C++ optimizer (see `Optimizer.native_config`) updates only
+        them, leaving the other rows and their optimizer states untouched. The
+        values must be on cpu then.
+
+        Parameters
+        ----------
+        key : int or list of int
+            Keys
+
+        value : NDArray or list of NDArray or list of list of NDArray
+            According values, matrices of rows along the first dimension
+
+        row_ids : NDArray or list of NDArray or list of list of NDArray
+            The row ids of each value, of any shape, such as the data of the
+            `Embedding`
+
+        priority : int, optional
+            The priority of the push operation.
+
+        Examples
+        --------
+        >>> kv.init(3, mx.nd.zeros((1000, 8)))
+        >>> grad = mx.nd.ones((1000, 8))
+        >>> kv.row_sparse_push(3, grad, row_ids=mx.nd.array([2, 5]))
+        """
+        ckeys, cvals = _ctype_key_value(key, value)
+        _, cids = _ctype_key_value(key, row_ids)
+        assert(len(cids) == len(cvals))
+        check_call(_LIB.MXKVStorePushRowSparse(
+            self.handle, mx_uint(len(ckeys)), ckeys, cvals, cids,
+            ctypes.c_int(priority)))
+
+    def row_sparse_pull(self, key, out, row_ids, priority=0):
+        """ Pull only the rows given by row_ids of a single value or a sequence of values.
+
+        The other rows of out are left as they are. With a `dist` store, only
+        these rows are sent, and out must be on cpu.
+
+        Parameters
+        ----------
+        key : int or list of int
+            Keys
+
+        out: NDArray or list of NDArray or list of list of NDArray
+            According values
+
+        row_ids : NDArray or list of NDArray or list of list of NDArray
+            The row ids of each value, of any shape
+
+        priority : int, optional
+            The priority of the pull operation.
+
+        Examples
+        --------
+        >>> weight = mx.nd.zeros((1000, 8))
+        >>> kv.row_sparse_pull(3, out=weight, row_ids=mx.nd.array([2, 5]))
+        """
+        ckeys, cvals = _ctype_key_value(key, out)
+        _, cids = _ctype_key_value(key, row_ids)
+        assert(len(cids) == len(cvals))
+        check_call(_LIB.MXKVStorePullRowSparse(
+            self.handle, mx_uint(len(ckeys)), ckeys, cvals, cids,
+            ctypes.c_int(priority)))
+
     def set_optimizer(self, optimizer):
         """Register an optimizer to the store
 
         If there are multiple machines, this process (should be a worker node)
         will pack this optimizer and send it to all servers. It returns after
-        this action is done.
+        this action is done. If the optimizer has a C++ implementation, see
+        Optimizer.native_config, the servers update with it in parallel over
+        keys instead of calling back into python.
 
         Parameters
         ----------
@@ -245,7 +319,18 @@ class KVStore(object):
         check_call(_LIB.MXKVStoreIsWorkerNode(ctypes.byref(is_worker)))
 
         # pylint: disable=invalid-name
-        if 'dist' in self.type and is_worker.value:
+        # allreduce has no servers, every worker updates its own copy
+        if 'dist' in self.type and 'allreduce' not in self.type and is_worker.value:
+            native = optimizer.native_config()
+            if native is not None:
+                name, params = native
+                keys = [c_str(k) for k in params]
+                vals = [c_str(str(params[k])) for k in params]
+                check_call(_LIB.MXKVStoreSetServerOptimizer(
+                    self.handle, c_str(name), mx_uint(len(keys)),
+                    c_array(ctypes.c_char_p, keys),
+                    c_array(ctypes.c_char_p, vals)))
+                return
             # send the optimizer to server
             try:
                 # use ASCII protocol 0, might be slower, but not a big ideal
@@ -341,6 +426,84 @@ class KVStore(object):
         """
         check_call(_LIB.MXKVStoreBarrier(self.handle))
 
+    def wait_for_clock(self, clock):
+        """Block until all worker nodes have finished at least `clock` iterations
+
+        Used by the stale synchronous mode ('dist_ssync'): a worker at
+        iteration t with staleness s calls wait_for_clock(t - s + 1) before
+        starting the next iteration, so that it stays less than s iterations
+        ahead of the slowest worker. It costs one request to each server.
+
+        Parameters
+        ----------
+        clock : int
+            The required iteration clock
+        """
+        check_call(_LIB.MXKVStoreWaitForClock(self.handle, ctypes.c_int(clock)))
+
+    def regroup_workers(self):
+        """Regroup the worker nodes by their speeds
+
+        Used by the group synchronous mode ('dist_gsync'): the servers measure
+        the iteration time of every worker, and this worker puts workers of
+        similar speeds into the same group and sends the groups to all
+        servers. One worker calling it is enough.
+        """
+        check_call(_LIB.MXKVStoreRegroupWorkers(self.handle))
+
+    def set_gradient_compression(self, compression_params):
+        """Compress the gradients pushed to servers
+
+        Only works for the distributed kvstores. All workers must call it with
+        the same parameters before pushing gradients. What a push does not
+        send is kept on the worker and added to the next push of the key.
+
+        Parameters
+        ----------
+        compression_params : dict
+            'type' is 'none', '2bit', 'topk', 'fp16' or 'bf16'. '2bit' sends
+            each element as 0 or +/- 'threshold', 'topk' sends the fraction
+            'ratio' of the elements with the largest magnitudes. 'fp16' and
+            'bf16' send every element in 16 bits, and the servers send the
+            pulled weights in 16 bits too, while keeping the weights and the
+            optimizer states in 32 bits.
+
+        Examples
+        --------
+        >>> kv.set_gradient_compression({'type': '2bit', 'threshold': 0.5})
+        """
+        keys = []
+        vals = []
+        for k, val in compression_params.items():
+            keys.append(c_str(k))
+            vals.append(c_str(str(val)))
+        check_call(_LIB.MXKVStoreSetGradientCompression(
+            self.handle, mx_uint(len(keys)),
+            c_array(ctypes.c_char_p, keys),
+            c_array(ctypes.c_char_p, vals)))
+
+    def key_placement(self, key):
+        """Return where the values of a key are stored
+
+        Parameters
+        ----------
+        key : int
+            The key
+
+        Returns
+        -------
+        list of (int, int)
+            The server rank and the number of values of each consecutive part
+            of the key. Empty for a local kvstore or a key not initialized.
+        """
+        num_parts = mx_uint()
+        servers = ctypes.POINTER(ctypes.c_int)()
+        sizes = ctypes.POINTER(ctypes.c_int)()
+        check_call(_LIB.MXKVStoreGetKeyPlacement(
+            self.handle, ctypes.c_int(key), ctypes.byref(num_parts),
+            ctypes.byref(servers), ctypes.byref(sizes)))
+        return [(servers[i], sizes[i]) for i in range(num_parts.value)]
+
     def _send_command_to_servers(self, head, body):
         """Send a command to all server nodes
 
@@ -358,7 +521,7 @@ class KVStore(object):
             the body of the command
         """
         check_call(_LIB.MXKVStoreSendCommmandToServers(
-            self.handle, mx_uint(head), c_str(body)))
+            self.handle, ctypes.c_int(head), c_str(body)))
 
 def create(name='local'):
     """Create a new KVStore.
@@ -81,24 +81,27 @@ def _create_kvstore(kvstore, num_device, arg_params):
 def _initialize_kvstore(kvstore, param_arrays, arg_params, param_names,
                         update_on_kvstore):
     """ Initialize kvstore"""
+    # init all keys at once, so the servers are balanced over all of them
+    kvstore.init(list(range(len(param_arrays))),
+                 [arg_params[param_names[idx]] for idx in range(len(param_arrays))])
     for idx, param_on_devs in enumerate(param_arrays):
-        kvstore.init(idx, arg_params[param_names[idx]])
-
         if update_on_kvstore:
             kvstore.pull(idx, param_on_devs, priority=-idx)
 
+def _update_param_on_kvstore(index, arg_list, grad_list, kvstore):
+    """ Perform update of the index-th parameter from its gradient on kvstore."""
+    if grad_list[0] is None:
+        return
+    # push gradient, priority is negative index
+    kvstore.push(index, grad_list, priority=-index)
+    # pull back the weights
+    kvstore.pull(index, arg_list, priority=-index)
+
 def _update_params_on_kvstore(param_arrays, grad_arrays, kvstore):
     """ Perform update of param_arrays from grad_arrays on kvstore."""
-    #key_num = 0;
     for index, pair in enumerate(zip(param_arrays, grad_arrays)):
         arg_list, grad_list = pair
-        if grad_list[0] is None:
-            continue
-        # push gradient, priority is negative index
-        kvstore.push(index, grad_list, priority=-index)
-        #key_num += 1
-        # pull back the weights
-        kvstore.pull(index, arg_list, priority=-index)
+        _update_param_on_kvstore(index, arg_list, grad_list, kvstore)
 
 def _update_params(param_arrays, grad_arrays, updater, num_device,
                    kvstore=None):
@@ -214,11 +217,6 @@ def record_accuracy():
     t.start()
 
 max_stale = 0
-min_iters = '0'
-miniters_filename = None
-miniters_file_op = None
-
-is_straggler = False 
 
 def _train_multi_device(symbol, ctx, arg_names, param_names, aux_names,
                         arg_params, aux_params,
@@ -295,7 +293,6 @@ def _train_multi_device(symbol, ctx, arg_names, param_names, aux_names,
     global train_accuracy_10per
     global train_accuracy_top5
     global stop_train_record
-    global is_straggler
     global current_time
 
     global val_accuracy_epoch_filename
@@ -311,9 +308,6 @@ def _train_multi_device(symbol, ctx, arg_names, param_names, aux_names,
     global val_accuracy_top5
 
     global max_stale
-    global min_iters
-    global miniters_filename
-    global miniters_file_op
 
     if logger is None:
         logger = logging
@@ -358,16 +352,9 @@ def _train_multi_device(symbol, ctx, arg_names, param_names, aux_names,
         while True:
             do_reset = True
             for data_batch in train_data:
-                if kvstore.type == "dist_ssync" and not is_straggler:
-                    wait_time = 0.0
-                    while (not min_iters.isdigit()) or (min_iters.isdigit() and total_batch - int(min_iters) >= max_stale):
-                        time.sleep(0.01)
-                        miniters_file_op = open(miniters_filename, "r")
-                        min_iters = miniters_file_op.read()
-                        miniters_file_op.close()
-                        wait_time += 0.01
-                        if (abs(wait_time - 10.0) <= 1):
-                            break
+                if kvstore.type == "dist_ssync":
+                    # stay less than max_stale iterations ahead of the slowest worker
+                    kvstore.wait_for_clock(total_batch - max_stale + 1)
 
                 executor_manager.load_data_batch(data_batch)
 
@@ -375,13 +362,20 @@ def _train_multi_device(symbol, ctx, arg_names, param_names, aux_names,
                     monitor.tic()
 
                 executor_manager.forward(is_train=True)
-                executor_manager.backward()
 
                 if update_on_kvstore:
-                    _update_params_on_kvstore(executor_manager.param_arrays,
-                                              executor_manager.grad_arrays,
-                                              kvstore)
+                    # push every gradient as soon as backward computes it,
+                    # overlapping the communication with the earlier layers
+                    param_arrays = executor_manager.param_arrays
+                    grad_arrays = executor_manager.grad_arrays
+                    def grad_ready(index):
+                        """push the gradient and pull the weight back"""
+                        # pylint: disable=cell-var-from-loop
+                        _update_param_on_kvstore(index, param_arrays[index],
+                                                 grad_arrays[index], kvstore)
+                    executor_manager.backward(grad_ready=grad_ready)
                 else:
+                    executor_manager.backward()
                     _update_params(executor_manager.param_arrays,
                                    executor_manager.grad_arrays,
                                    updater=updater,
@@ -456,6 +450,10 @@ def _train_multi_device(symbol, ctx, arg_names, param_names, aux_names,
         toc = time.time()
         logger.info('Epoch[%d] Time cost=%.3f', epoch, (toc - tic))
 
+        if kvstore and kvstore.type == "dist_gsync" and kvstore.rank == 0:
+            # put workers of similar speeds into the same group
+            kvstore.regroup_workers()
+
         if epoch_end_callback or epoch + 1 == end_epoch:
             executor_manager.copy_to(arg_params, aux_params)
 
@@ -945,7 +943,6 @@ class FeedForward(BASE_ESTIMATOR):
         global train_accuracy_top5_epoch_file_op
         global train_interval_batch
         global train_interval_time
-        global is_straggler
 
         global val_accuracy_filename
         global val_accuracy_epoch_filename
@@ -959,14 +956,9 @@ class FeedForward(BASE_ESTIMATOR):
         global val_accuracy_top5_epoch_file_op
         global val_interval_batch
 
-        global miniters_filename
-        global miniters_file_op
-        global min_iters
         global max_stale
 
         user = getpass.getuser()
-        if hostname == "node16":
-            is_straggler = True
 
         if dataset == "mnist":
             train_accuracy_filename = "/home/"+user+"/MXNet-G/example/image-classification/log/mnist/mnist_accuracy_cluster" + hostname + "_worker" + str(kvstore.rank) + ".log"
@@ -1049,11 +1041,8 @@ class FeedForward(BASE_ESTIMATOR):
         val_accuracy_top5_epoch_file_op = open(val_accuracy_top5_epoch_filename, "a")
 
         if kvstore.type == "dist_ssync":
+            assert staleness > 0, "dist_ssync needs a staleness of at least 1"
             max_stale = staleness
-            miniters_filename = "/home/"+user+"/MXNet-G/example/image-classification/ssp/miniters.log"
-            miniters_file_op = open(miniters_filename, "w+")
-            miniters_file_op.write("%d" % int(min_iters))
-            miniters_file_op.close()
 
         data = self._init_iter(X, y, is_train=True)
         eval_data = self._init_eval_iter(eval_data)
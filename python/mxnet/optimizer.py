@@ -8,9 +8,22 @@ from .base import c_array, mx_uint, mx_float, c_str
 from .base import OptimizerHandle, OptimizerCreator
 from .ndarray import NDArray, zeros, clip, sqrt, square
 from .random import normal
+from .lr_scheduler import FactorScheduler
 import time
 import numpy as np
 
+# the keys of the slices of large arrays on dist servers, which mirror
+# kSliceKeyBase and kMaxSlices in src/kvstore/kvstore_dist_server.h
+_SLICE_KEY_BASE = 1 << 30
+_MAX_SLICES = 1024
+
+def _array_index(index):
+    """Return the index of the array of which index is a slice on a server,
+    or index itself if it is not a slice."""
+    if isinstance(index, int) and index >= _SLICE_KEY_BASE:
+        return (index - _SLICE_KEY_BASE) // _MAX_SLICES
+    return index
+
 class Optimizer(object):
     """Base class of all optimizers."""
     opt_registry = {}
@@ -124,6 +137,47 @@ class Optimizer(object):
     def update(self, index, weight, grad, state):
         """Update the parameters. override in implementations"""
 
+    # pylint: disable=no-self-use
+    def native_config(self):
+        """Return the C++ optimizer doing the same updates, so that a
+        distributed kvstore updates on the servers without calling python.
+        override in implementations.
+
+        Returns
+        -------
+        (str, dict) or None
+            The name the C++ optimizer is registered with and its parameters,
+            or None if there is no such optimizer.
+        """
+        return None
+
+    def _native_params(self):
+        """Return the learning rate, weight decay and their schedule and
+        multipliers in the form the kvstore servers accept, or None if the
+        learning rate scheduler is not supported."""
+        params = {'lr': self.lr, 'wd': self.wd,
+                  'begin_num_update': self.num_update}
+        if self.lr_scheduler is not None:
+            if not isinstance(self.lr_scheduler, FactorScheduler):
+                return None
+            params.update({'lr': self.lr_scheduler.base_lr,
+                           'lr_step': self.lr_scheduler.step,
+                           'lr_factor': self.lr_scheduler.factor,
+                           'lr_stop': self.lr_scheduler.stop_factor_lr,
+                           'lr_count': self.lr_scheduler.count})
+        indices = set(self.idx2name.keys())
+        indices.update(k for k in self.lr_mult if isinstance(k, int))
+        indices.update(k for k in self.wd_mult if isinstance(k, int))
+        for index in indices:
+            name = self.idx2name.get(index)
+            lr_mult = self.lr_mult.get(index, self.lr_mult.get(name, 1.0))
+            wd_mult = self.wd_mult.get(index, self.wd_mult.get(name, 1.0))
+            if lr_mult != 1.0:
+                params['lr_mult.%d' % index] = lr_mult
+            if wd_mult != 1.0:
+                params['wd_mult.%d' % index] = wd_mult
+        return params
+
     # pylint: disable=no-self-use
     def set_lr_scale(self, args_lrscale):
         """set lr scale is deprecated. Use set_lr_mult instead."""
@@ -201,6 +255,9 @@ class Optimizer(object):
         else:
             lr = self.lr
 
+        # a slice shares the multipliers of its array, while keeping its own
+        # state and update count
+        index = _array_index(index)
         if index in self.lr_mult:
             lr *= self.lr_mult[index]
         elif index in self.idx2name:
@@ -222,6 +279,7 @@ class Optimizer(object):
             weight decay for this index
         """
         wd = self.wd
+        index = _array_index(index)
         if index in self.wd_mult:
             wd *= self.wd_mult[index]
         elif index in self.idx2name:
@@ -260,6 +318,16 @@ class SGD(Optimizer):
         super(SGD, self).__init__(**kwargs)
         self.momentum = momentum
 
+    def native_config(self):
+        params = self._native_params()
+        # ccsgd clips the gradient before rescaling it
+        if type(self) is not SGD or params is None or self.clip_gradient is not None:
+            return None
+        # the gradient is divided by rescale_grad, see update
+        params.update({'momentum': self.momentum,
+                       'rescale_grad': 1.0 / self.rescale_grad})
+        return ('ccsgd', params)
+
     def create_state(self, index, weight):
         """Create additional optimizer state such as momentum.
 
@@ -482,6 +550,15 @@ class ccSGD(Optimizer):
             ['momentum', 'rescale_grad', 'clip_gradient'],
             [momentum, rescale_grad, clip_gradient])
 
+    def native_config(self):
+        params = self._native_params()
+        if type(self) is not ccSGD or params is None:
+            return None
+        params.update({'momentum': self.momentum,
+                       'rescale_grad': self.rescale_grad,
+                       'clip_gradient': self.clip_gradient})
+        return ('ccsgd', params)
+
     def __getstate__(self):
         this = self.__dict__.copy()
         this['handle'] = this.get('handle', None) is not None
@@ -570,6 +647,16 @@ class Adam(Optimizer):
         self.epsilon = epsilon
         self.decay_factor = decay_factor
 
+    def native_config(self):
+        params = self._native_params()
+        if type(self) is not Adam or params is None:
+            return None
+        params.update({'beta1': self.beta1, 'beta2': self.beta2,
+                       'epsilon': self.epsilon,
+                       'rescale_grad': self.rescale_grad,
+                       'clip_gradient': self.clip_gradient or -1.0})
+        return ('ccadam', params)
+
     def create_state(self, index, weight):
         """Create additional optimizer state: mean, variance
 
@@ -707,6 +794,15 @@ class RMSProp(Optimizer):
         self.gamma1 = gamma1
         self.gamma2 = gamma2
 
+    def native_config(self):
+        params = self._native_params()
+        if type(self) is not RMSProp or params is None:
+            return None
+        params.update({'gamma1': self.gamma1, 'gamma2': self.gamma2,
+                       'rescale_grad': self.rescale_grad,
+                       'clip_gradient': self.clip_gradient or -1.0})
+        return ('ccrmsprop', params)
+
     def create_state(self, index, weight):
         """Create additional optimizer state: mean, variance
         Parameters
@@ -0,0 +1,35 @@
+# coding: utf-8
+"""Profiler of the operations executed by the engine."""
+from __future__ import absolute_import
+
+from .base import _LIB, check_call, c_str
+
+
+def profiler_set_state(state='stop'):
+    """Start or stop recording the operations executed by the engine.
+
+    Each operation is recorded with its name, device, thread, the time it
+    waited for a thread once ready and the time it ran.
+
+    Parameters
+    ----------
+    state : str
+        'run' to start recording, 'stop' to stop.
+    """
+    state2int = {'stop': 0, 'run': 1}
+    if state not in state2int:
+        raise ValueError('state must be "run" or "stop", got %s' % state)
+    check_call(_LIB.MXSetProfilerState(state2int[state]))
+
+
+def dump_profile(filename='profile.json'):
+    """Write the operations recorded in the chrome tracing format, to open
+    in chrome://tracing. Should be called once stopped, after
+    `mx.nd.waitall()`.
+
+    Parameters
+    ----------
+    filename : str
+        The file written.
+    """
+    check_call(_LIB.MXDumpProfile(c_str(filename)))
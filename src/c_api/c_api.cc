@@ -27,6 +27,7 @@
 #include <utility>
 #include "./c_api_error.h"
 #include "../common/thread_local.h"
+#include "../engine/profiler.h"
 #include "../operator/custom-inl.h"
 
 using namespace mxnet;
@@ -49,6 +50,8 @@ struct MXAPIThreadLocalEntry {
   std::vector<mx_uint> arg_shape_ndim, out_shape_ndim, aux_shape_ndim;
   /*! \brief result holder for returning shape pointer */
   std::vector<const mx_uint*> arg_shape_data, out_shape_data, aux_shape_data;
+  /*! \brief result holder for returning key placements */
+  std::vector<int> placement_servers, placement_sizes;
   // helper function to setup return value of shape array
   inline static void SetupShapeArrayReturn(
       const std::vector<TShape> &shapes,
@@ -114,6 +117,20 @@ int MXNotifyShutdown() {
   API_END();
 }
 
+int MXSetProfilerState(int state) {
+  API_BEGIN();
+  CHECK(state == 0 || state == 1) << "invalid profiler state " << state;
+  engine::Profiler::Get()->SetState(
+      static_cast<engine::Profiler::ProfilerState>(state));
+  API_END();
+}
+
+int MXDumpProfile(const char *filename) {
+  API_BEGIN();
+  engine::Profiler::Get()->DumpProfile(filename);
+  API_END();
+}
+
 int MXNDArrayCreateNone(NDArrayHandle *out) {
   API_BEGIN();
   *out = new NDArray();
@@ -1096,6 +1113,22 @@ int MXExecutorSetMonitorCallback(ExecutorHandle handle,
   API_END();
 }
 
+int MXExecutorSetGradReadyCallback(ExecutorHandle handle,
+                                   ExecutorGradReadyCallback callback,
+                                   void* callback_handle) {
+  API_BEGIN();
+  ExecutorGradReadyCallback callback_temp = callback;
+  void* callback_handle_temp = callback_handle;
+  Executor::GradReadyCallback clbk
+  = [callback_temp, callback_handle_temp](int index, const NDArray& grad) {
+    callback_temp(static_cast<mx_uint>(index), new NDArray(grad),
+                  callback_handle_temp);
+  };
+  Executor *exec = static_cast<Executor*>(handle);
+  exec->SetGradReadyCallback(clbk);
+  API_END();
+}
+
 //--------------------------------------------
 // Part 5: IO Interface
 //--------------------------------------------
@@ -1257,6 +1290,43 @@ int MXKVStorePull(KVStoreHandle handle,
   API_END();
 }
 
+int MXKVStorePushRowSparse(KVStoreHandle handle,
+                           mx_uint num,
+                           const int* keys,
+                           NDArrayHandle* vals,
+                           NDArrayHandle* row_ids,
+                           int priority) {
+  API_BEGIN();
+  std::vector<int> v_keys(num);
+  std::vector<NDArray> v_vals(num), v_row_ids(num);
+  for (mx_uint i = 0; i < num; ++i) {
+    v_keys[i] = keys[i];
+    v_vals[i] = *static_cast<NDArray*>(vals[i]);
+    v_row_ids[i] = *static_cast<NDArray*>(row_ids[i]);
+  }
+  static_cast<KVStore*>(handle)->PushRowSparse(v_keys, v_vals, v_row_ids, priority);
+  API_END();
+}
+
+int MXKVStorePullRowSparse(KVStoreHandle handle,
+                           mx_uint num,
+                           const int* keys,
+                           NDArrayHandle* vals,
+                           NDArrayHandle* row_ids,
+                           int priority) {
+  API_BEGIN();
+  std::vector<int> v_keys(num);
+  std::vector<NDArray*> v_vals(num);
+  std::vector<NDArray> v_row_ids(num);
+  for (mx_uint i = 0; i < num; ++i) {
+    v_keys[i] = keys[i];
+    v_vals[i] = static_cast<NDArray*>(vals[i]);
+    v_row_ids[i] = *static_cast<NDArray*>(row_ids[i]);
+  }
+  static_cast<KVStore*>(handle)->PullRowSparse(v_keys, v_vals, v_row_ids, priority);
+  API_END();
+}
+
 int MXKVStoreSetUpdater(KVStoreHandle handle,
                         MXKVStoreUpdater updater,
                         void* updater_handle) {
@@ -1303,6 +1373,65 @@ int MXKVStoreBarrier(KVStoreHandle handle) {
   API_END();
 }
 
+int MXKVStoreWaitForClock(KVStoreHandle handle, int clock) {
+  API_BEGIN();
+  static_cast<KVStore*>(handle)->WaitForClock(clock);
+  API_END();
+}
+
+int MXKVStoreRegroupWorkers(KVStoreHandle handle) {
+  API_BEGIN();
+  static_cast<KVStore*>(handle)->RegroupWorkers();
+  API_END();
+}
+
+int MXKVStoreSetGradientCompression(KVStoreHandle handle,
+                                    mx_uint num_params,
+                                    const char** keys,
+                                    const char** vals) {
+  API_BEGIN();
+  std::vector<std::pair<std::string, std::string> > kwargs;
+  for (mx_uint i = 0; i < num_params; ++i) {
+    kwargs.push_back({std::string(keys[i]), std::string(vals[i])});
+  }
+  static_cast<KVStore*>(handle)->SetGradientCompression(kwargs);
+  API_END();
+}
+
+int MXKVStoreSetServerOptimizer(KVStoreHandle handle,
+                                const char* name,
+                                mx_uint num_params,
+                                const char** keys,
+                                const char** vals) {
+  API_BEGIN();
+  std::vector<std::pair<std::string, std::string> > kwargs;
+  for (mx_uint i = 0; i < num_params; ++i) {
+    kwargs.push_back({std::string(keys[i]), std::string(vals[i])});
+  }
+  static_cast<KVStore*>(handle)->SetServerOptimizer(name, kwargs);
+  API_END();
+}
+
+int MXKVStoreGetKeyPlacement(KVStoreHandle handle,
+                             int key,
+                             mx_uint *num_parts,
+                             const int **servers,
+                             const int **sizes) {
+  MXAPIThreadLocalEntry *ret = MXAPIThreadLocalStore::Get();
+  API_BEGIN();
+  auto placement = static_cast<KVStore*>(handle)->GetKeyPlacement(key);
+  ret->placement_servers.clear();
+  ret->placement_sizes.clear();
+  for (const auto& part : placement) {
+    ret->placement_servers.push_back(part.first);
+    ret->placement_sizes.push_back(part.second);
+  }
+  *num_parts = static_cast<mx_uint>(placement.size());
+  *servers = dmlc::BeginPtr(ret->placement_servers);
+  *sizes = dmlc::BeginPtr(ret->placement_sizes);
+  API_END();
+}
+
 int MXKVStoreSetBarrierBeforeExit(KVStoreHandle handle,
                                   const int barrier_before_exit) {
   API_BEGIN();
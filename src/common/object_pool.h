@@ -6,14 +6,24 @@
 #define MXNET_COMMON_OBJECT_POOL_H_
 #include <dmlc/logging.h>
 #include <cstdlib>
+#include <memory>
 #include <mutex>
 #include <utility>
 #include <vector>
+#include "./thread_local.h"
 
 namespace mxnet {
 namespace common {
 /*!
  * \brief Object pool for fast allocation and deallocation.
+ *
+ *  Each thread allocates from and frees to a cache of its own, without
+ *  locking. A thread with an empty cache takes a batch of objects from the
+ *  pool, and a thread caching two batches gives one back, so that objects
+ *  allocated by one thread and freed by another, like the blocks of the
+ *  engine, only take the lock of the pool once per batch. The objects
+ *  cached by a thread are given back when it exits, after which it takes
+ *  the lock for every object.
  */
 template <typename T>
 class ObjectPool {
@@ -63,18 +73,59 @@ class ObjectPool {
     };
 #endif
   };
+  /*!
+   * \brief Objects cached by a thread.
+   */
+  struct ThreadCache {
+    /*! \brief head of the free list */
+    LinkedList* head{nullptr};
+    /*! \brief length of the free list */
+    std::size_t size{0};
+  };
+  /*!
+   * \brief Owner of the cache of a thread, giving it back when the thread
+   *  exits.
+   */
+  class ThreadCacheHolder {
+   public:
+    /*!
+     * \param slot the pointer to the cache of the thread, reset on exit.
+     * \param exited set on exit.
+     */
+    ThreadCacheHolder(ThreadCache** slot, bool* exited)
+        : slot_(slot), exited_(exited), pool_(_GetSharedRef()) {}
+    ~ThreadCacheHolder() {
+      *slot_ = nullptr;
+      *exited_ = true;
+      pool_->GiveBackAll(&cache_);
+    }
+    ThreadCache* cache() { return &cache_; }
+
+   private:
+    ThreadCache cache_;
+    ThreadCache** slot_;
+    bool* exited_;
+    /*! \brief keeps the pool alive until the cache is given back */
+    std::shared_ptr<ObjectPool> pool_;
+  };
   /*!
    * \brief Page size of allocation.
    *
    * Currently defined to be 4KB.
    */
   constexpr static std::size_t kPageSize = 1 << 12;
+  /*!
+   * \brief Number of objects moved between the pool and a thread at once,
+   *  those of a page.
+   */
+  constexpr static std::size_t kBatchSize = kPageSize / sizeof(LinkedList);
   /*! \brief internal mutex */
   std::mutex m_;
   /*!
-   * \brief Head of free list.
+   * \brief Free lists of kBatchSize objects, or fewer for the remainder of
+   *  a page, and their lengths.
    */
-  LinkedList* head_{nullptr};
+  std::vector<std::pair<LinkedList*, std::size_t> > batches_;
   /*!
    * \brief Pages allocated.
    */
@@ -89,6 +140,23 @@ class ObjectPool {
    * This function is not protected and must be called with caution.
    */
   void AllocateChunk();
+  /*! \return the cache of the calling thread, null once it is exiting */
+  static ThreadCache* GetThreadCache();
+  /*!
+   * \brief Move a batch of objects from the pool to an empty cache.
+   * \param cache the cache of the calling thread.
+   */
+  void Refill(ThreadCache* cache);
+  /*!
+   * \brief Move a batch of objects from a cache back to the pool.
+   * \param cache the cache of the calling thread.
+   */
+  void GiveBack(ThreadCache* cache);
+  /*!
+   * \brief Move all objects of the cache of an exiting thread to the pool.
+   * \param cache the cache.
+   */
+  void GiveBackAll(ThreadCache* cache);
   DISALLOW_COPY_AND_ASSIGN(ObjectPool);
 };  // class ObjectPool
 
@@ -112,6 +180,9 @@ struct ObjectPoolAllocatable {
   static void Delete(T* ptr);
 };  // struct ObjectPoolAllocatable
 
+template <typename T>
+constexpr std::size_t ObjectPool<T>::kBatchSize;
+
 template <typename T>
 ObjectPool<T>::~ObjectPool() {
   // TODO(hotpxl): mind destruction order
@@ -123,14 +194,26 @@ ObjectPool<T>::~ObjectPool() {
 template <typename T>
 template <typename... Args>
 T* ObjectPool<T>::New(Args&&... args) {
+  ThreadCache* cache = GetThreadCache();
   LinkedList* ret;
-  {
+  if (cache != nullptr) {
+    if (cache->head == nullptr) {
+      Refill(cache);
+    }
+    ret = cache->head;
+    cache->head = ret->next;
+    --cache->size;
+  } else {
     std::lock_guard<std::mutex> lock{m_};
-    if (head_->next == nullptr) {
+    if (batches_.empty()) {
       AllocateChunk();
     }
-    ret = head_;
-    head_ = head_->next;
+    auto& batch = batches_.back();
+    ret = batch.first;
+    batch.first = ret->next;
+    if (--batch.second == 0) {
+      batches_.pop_back();
+    }
   }
   return new (static_cast<void*>(ret)) T(std::forward<Args>(args)...);
 }
@@ -139,11 +222,81 @@ template <typename T>
 void ObjectPool<T>::Delete(T* ptr) {
   ptr->~T();
   auto linked_list_ptr = reinterpret_cast<LinkedList*>(ptr);
-  {
+  ThreadCache* cache = GetThreadCache();
+  if (cache != nullptr) {
+    linked_list_ptr->next = cache->head;
+    cache->head = linked_list_ptr;
+    if (++cache->size >= 2 * kBatchSize) {
+      GiveBack(cache);
+    }
+  } else {
     std::lock_guard<std::mutex> lock{m_};
-    linked_list_ptr->next = head_;
-    head_ = linked_list_ptr;
+    if (batches_.empty() || batches_.back().second >= kBatchSize) {
+      linked_list_ptr->next = nullptr;
+      batches_.emplace_back(linked_list_ptr, 1);
+    } else {
+      linked_list_ptr->next = batches_.back().first;
+      batches_.back().first = linked_list_ptr;
+      ++batches_.back().second;
+    }
+  }
+}
+
+template <typename T>
+typename ObjectPool<T>::ThreadCache* ObjectPool<T>::GetThreadCache() {
+  static MX_TREAD_LOCAL ThreadCache* cache = nullptr;
+  static MX_TREAD_LOCAL bool exited = false;
+  if (cache == nullptr && !exited) {
+    // the holder is reached once per thread, through a plain pointer after.
+    // once it is destructed, objects still freed at exit, such as by the
+    // engine, go to the pool directly
+    static thread_local ThreadCacheHolder holder(&cache, &exited);
+    cache = holder.cache();
+  }
+  return cache;
+}
+
+template <typename T>
+void ObjectPool<T>::Refill(ThreadCache* cache) {
+  std::lock_guard<std::mutex> lock{m_};
+  if (batches_.empty()) {
+    AllocateChunk();
+  }
+  cache->head = batches_.back().first;
+  cache->size = batches_.back().second;
+  batches_.pop_back();
+}
+
+template <typename T>
+void ObjectPool<T>::GiveBack(ThreadCache* cache) {
+  // cut the first kBatchSize objects off the cache
+  LinkedList* batch = cache->head;
+  LinkedList* last = batch;
+  for (std::size_t i = 1; i < kBatchSize; ++i) {
+    last = last->next;
+  }
+  cache->head = last->next;
+  cache->size -= kBatchSize;
+  last->next = nullptr;
+  std::lock_guard<std::mutex> lock{m_};
+  batches_.emplace_back(batch, kBatchSize);
+}
+
+template <typename T>
+void ObjectPool<T>::GiveBackAll(ThreadCache* cache) {
+  std::lock_guard<std::mutex> lock{m_};
+  while (cache->head != nullptr) {
+    LinkedList* batch = cache->head;
+    LinkedList* last = batch;
+    std::size_t size = 1;
+    for (; size < kBatchSize && last->next != nullptr; ++size) {
+      last = last->next;
+    }
+    cache->head = last->next;
+    last->next = nullptr;
+    batches_.emplace_back(batch, size);
   }
+  cache->size = 0;
 }
 
 template <typename T>
@@ -182,8 +335,8 @@ void ObjectPool<T>::AllocateChunk() {
   for (std::size_t i = 0; i < size - 1; ++i) {
     new_chunk[i].next = &new_chunk[i + 1];
   }
-  new_chunk[size - 1].next = head_;
-  head_ = new_chunk;
+  new_chunk[size - 1].next = nullptr;
+  batches_.emplace_back(new_chunk, size);
 }
 
 template <typename T>
@@ -0,0 +1,156 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file profiler.cc
+ * \brief implements the profiler of the engine.
+ */
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <utility>
+#include "./profiler.h"
+#include "../common/thread_local.h"
+
+namespace mxnet {
+namespace engine {
+
+namespace {
+inline uint64_t SteadyUsec() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline const char* DeviceName(int dev_type) {
+  switch (dev_type) {
+    case Context::kCPU: return "cpu";
+    case Context::kGPU: return "gpu";
+    case Context::kCPUPinned: return "cpu_pinned";
+    default: return "unknown";
+  }
+}
+
+// the process of a device in the trace
+inline int DevicePid(int dev_type, int dev_id) {
+  return dev_type * 1000 + dev_id;
+}
+
+// write s as a JSON string
+inline void WriteJSONString(std::ostream& os, const char* s) {
+  os << '"';
+  for (; *s != '\0'; ++s) {
+    if (*s == '"' || *s == '\\') {
+      os << '\\' << *s;
+    } else if (static_cast<unsigned char>(*s) >= 0x20) {
+      os << *s;
+    }
+  }
+  os << '"';
+}
+}  // namespace
+
+Profiler* Profiler::Get() {
+  // never destructed, since engine threads may still record at exit
+  static Profiler* inst = new Profiler();
+  return inst;
+}
+
+Profiler::Profiler() {
+  ring_size_ = std::max(dmlc::GetEnv("MXNET_PROFILER_BUFFER_SIZE", 1 << 15), 1);
+  init_us_ = SteadyUsec();
+}
+
+void Profiler::SetState(ProfilerState state) {
+  state_.store(state);
+}
+
+uint64_t Profiler::NowInUsec() const {
+  return SteadyUsec() - init_us_;
+}
+
+int Profiler::ThreadIndex() {
+  static MX_TREAD_LOCAL int index = -1;
+  if (index < 0) {
+    std::lock_guard<std::mutex> lock{m_};
+    index = static_cast<int>(rings_.size());
+    rings_.emplace_back(new Ring(ring_size_));
+  }
+  return index;
+}
+
+Profiler::Ring* Profiler::ThreadRing() {
+  int index = ThreadIndex();
+  std::lock_guard<std::mutex> lock{m_};
+  return rings_[index].get();
+}
+
+void Profiler::AddOprStat(const char* opr_name, const Context& ctx, int thread_id,
+                          uint64_t ready_us, uint64_t start_us, uint64_t end_us) {
+  static MX_TREAD_LOCAL Ring* ring = nullptr;
+  if (ring == nullptr) ring = ThreadRing();
+  uint64_t count = ring->count.load(std::memory_order_relaxed);
+  OprExecStat& stat = ring->stats[count % ring->stats.size()];
+  strncpy(stat.opr_name, opr_name != nullptr ? opr_name : "unknown",
+          OprExecStat::kNameSize - 1);
+  stat.opr_name[OprExecStat::kNameSize - 1] = '\0';
+  stat.ready_us = ready_us != 0 ? ready_us : start_us;
+  stat.start_us = start_us;
+  stat.end_us = end_us;
+  stat.dev_type = ctx.dev_type;
+  stat.dev_id = ctx.dev_id;
+  stat.thread_id = thread_id;
+  // publishes the record to DumpProfile
+  ring->count.store(count + 1, std::memory_order_release);
+}
+
+void Profiler::DumpProfile(const std::string& filename) {
+  std::vector<OprExecStat> stats;
+  {
+    std::lock_guard<std::mutex> lock{m_};
+    for (const auto& ring : rings_) {
+      uint64_t count = ring->count.load(std::memory_order_acquire);
+      uint64_t size = ring->stats.size();
+      for (uint64_t i = count > size ? count - size : 0; i < count; ++i) {
+        stats.push_back(ring->stats[i % size]);
+      }
+    }
+  }
+  std::sort(stats.begin(), stats.end(),
+            [](const OprExecStat& a, const OprExecStat& b) {
+              return a.start_us < b.start_us;
+            });
+
+  std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(filename.c_str(), "w"));
+  dmlc::ostream os(fo.get());
+  os << "{\n\"traceEvents\": [\n";
+  bool first = true;
+  // name the process of each device
+  std::map<std::pair<int, int>, bool> devices;
+  for (const auto& s : stats) devices[std::make_pair(s.dev_type, s.dev_id)] = true;
+  for (const auto& d : devices) {
+    if (!first) os << ",\n";
+    first = false;
+    os << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": "
+       << DevicePid(d.first.first, d.first.second)
+       << ", \"args\": {\"name\": \"" << DeviceName(d.first.first) << "/"
+       << d.first.second << "\"}}";
+  }
+  for (const auto& s : stats) {
+    if (!first) os << ",\n";
+    first = false;
+    os << "{\"name\": ";
+    WriteJSONString(os, s.opr_name);
+    os << ", \"cat\": \"operator\", \"ph\": \"X\", \"ts\": " << s.start_us
+       << ", \"dur\": " << s.end_us - s.start_us
+       << ", \"pid\": " << DevicePid(s.dev_type, s.dev_id)
+       << ", \"tid\": " << s.thread_id
+       << ", \"args\": {\"queue_wait_us\": " << s.start_us - s.ready_us << "}}";
+  }
+  os << "\n],\n\"displayTimeUnit\": \"ms\"\n}\n";
+  os.set_stream(nullptr);
+}
+
+}  // namespace engine
+}  // namespace mxnet
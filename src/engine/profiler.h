@@ -0,0 +1,123 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file profiler.h
+ * \brief records the operations executed by the engine, in the chrome
+ *  tracing format.
+ */
+#ifndef MXNET_ENGINE_PROFILER_H_
+#define MXNET_ENGINE_PROFILER_H_
+
+#include <dmlc/base.h>
+#include <mxnet/base.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mxnet {
+namespace engine {
+
+/*! \brief the execution of an operation */
+struct OprExecStat {
+  /*! \brief maximum length of the name kept */
+  static const int kNameSize = 48;
+  /*! \brief name of the operation, truncated */
+  char opr_name[kNameSize];
+  /*! \brief time it was ready to run, in microseconds */
+  uint64_t ready_us;
+  /*! \brief time it started to run, in microseconds */
+  uint64_t start_us;
+  /*! \brief time it completed, in microseconds */
+  uint64_t end_us;
+  /*! \brief device type of the context */
+  int dev_type;
+  /*! \brief device id of the context */
+  int dev_id;
+  /*! \brief index of the thread which ran it */
+  int thread_id;
+};
+
+/*!
+ * \brief Profiler of the engine.
+ *
+ *  Each thread completing operations writes their records to a ring buffer
+ *  of its own, without locking, keeping the latest ones once full. The
+ *  rings are only merged when the profile is dumped, which should be done
+ *  once stopped: records written during the dump may be torn.
+ */
+class Profiler {
+ public:
+  /*! \brief state of the profiler */
+  enum ProfilerState {
+    kNotRunning = 0,
+    kRunning = 1
+  };
+  /*! \return the profiler singleton */
+  static Profiler* Get();
+  /*!
+   * \brief start or stop recording.
+   * \param state the new state.
+   */
+  void SetState(ProfilerState state);
+  /*! \return the state */
+  ProfilerState GetState() const {
+    return static_cast<ProfilerState>(state_.load(std::memory_order_relaxed));
+  }
+  /*! \return whether operations are recorded */
+  bool IsRunning() const {
+    return state_.load(std::memory_order_relaxed) == kRunning;
+  }
+  /*!
+   * \brief the index of the calling thread in the profile, registering it
+   *  on the first call.
+   */
+  int ThreadIndex();
+  /*!
+   * \brief record the execution of an operation.
+   * \param opr_name name of the operation, null if unknown.
+   * \param ctx context it ran in.
+   * \param thread_id index of the thread which ran it.
+   * \param ready_us time it was ready to run, 0 if unknown.
+   * \param start_us time it started to run.
+   * \param end_us time it completed.
+   */
+  void AddOprStat(const char* opr_name, const Context& ctx, int thread_id,
+                  uint64_t ready_us, uint64_t start_us, uint64_t end_us);
+  /*!
+   * \brief write the records in the chrome tracing format, to open in
+   *  chrome://tracing.
+   * \param filename the file written.
+   */
+  void DumpProfile(const std::string& filename);
+  /*! \return the time in microseconds since the profiler was created */
+  uint64_t NowInUsec() const;
+
+ private:
+  /*! \brief records of a thread, written by this thread only */
+  struct Ring {
+    explicit Ring(size_t size) : stats(size) {}
+    std::vector<OprExecStat> stats;
+    /*! \brief number of records ever written */
+    std::atomic<uint64_t> count{0};
+  };
+  Profiler();
+  /*! \return the ring of the calling thread */
+  Ring* ThreadRing();
+  /*! \brief current ProfilerState */
+  std::atomic<int> state_{kNotRunning};
+  /*! \brief number of records kept per thread */
+  size_t ring_size_;
+  /*! \brief time of creation, in steady clock microseconds */
+  uint64_t init_us_;
+  /*! \brief guards rings_ */
+  std::mutex m_;
+  /*! \brief the rings of all threads, indexed by thread index */
+  std::vector<std::unique_ptr<Ring> > rings_;
+  DISALLOW_COPY_AND_ASSIGN(Profiler);
+};
+
+}  // namespace engine
+}  // namespace mxnet
+#endif  // MXNET_ENGINE_PROFILER_H_
@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <condition_variable>
 #include <mutex>
+#include <thread>
 #include <utility>
 #include "./threaded_engine.h"
 #include "../common/cuda_utils.h"
@@ -23,158 +24,151 @@ std::atomic<std::size_t> ThreadedVar::counter{0};
 std::atomic<std::size_t> ThreadedOpr::counter{0};
 #endif  // ENGINE_DEBUG
 
-ThreadedVar::ThreadedVar(VersionedVarBlock* head) : head_{head} {
+ThreadedVar::ThreadedVar(VersionedVarBlock* head) : head_{head}, tail_{head} {
 #if ENGINE_DEBUG
   LOG(INFO) << __func__ << " " << ++counter;
 #endif  // ENGINE_DEBUG
 }
 
+inline void ThreadedVar::Enqueue(OprBlock* opr_block, bool write) {
+  auto&& new_var_block = VersionedVarBlock::New();
+  new_var_block->trigger = opr_block;
+  new_var_block->write = write;
+  // the exchange orders the appending threads, each then links its block
+  VersionedVarBlock* prev = tail_.exchange(new_var_block);
+  prev->next.store(new_var_block, std::memory_order_release);
+}
+
+inline VersionedVarBlock* ThreadedVar::NextBlock(VersionedVarBlock* blk) {
+  VersionedVarBlock* next;
+  // counted in state_ but not linked yet, the appending thread is between
+  // two instructions
+  while ((next = blk->next.load(std::memory_order_acquire)) == nullptr) {
+    std::this_thread::yield();
+  }
+  return next;
+}
+
 inline void ThreadedVar::AppendReadDependency(OprBlock* opr_block) {
-  std::lock_guard<std::mutex> lock{m_};
-  if (pending_write_ == nullptr) {
-    // invariant: is_ready_to_read()
-    CHECK_GE(num_pending_reads_, 0);
-    // STATE CHANGE
-    ++num_pending_reads_;
-    // decrease wait counter
-    opr_block->decr_wait();
-  } else {
-    auto&& new_var_block = VersionedVarBlock::New();
-    assert(head_->next == nullptr);
-    assert(head_->trigger == nullptr);
-    assert(head_->write == false);
-    // append things to next.
-    head_->next = new_var_block;
-    head_->trigger = opr_block;
-    head_ = new_var_block;
+  uint64_t s = state_.load();
+  while (true) {
+    if ((s & kWritePending) == 0) {
+      // invariant: ready_to_read()
+      CHECK_LT(NumReads(s), NumReads(kReadMask)) << "too many pending reads";
+      // STATE CHANGE
+      if (state_.compare_exchange_weak(s, s + 1)) {
+        // decrease wait counter
+        opr_block->decr_wait();
+        return;
+      }
+    } else if (state_.compare_exchange_weak(s, s + kQueuedOne)) {
+      Enqueue(opr_block, false);
+      return;
+    }
   }
 }
 
 inline void ThreadedVar::AppendWriteDependency(OprBlock* opr_block) {
-  auto&& new_var_block = VersionedVarBlock::New();
-  std::lock_guard<std::mutex> lock{m_};
-  // invariant.
-  assert(head_->next == nullptr);
-  assert(head_->trigger == nullptr);
-  assert(head_->write == false);
-  // attach to head.
-  head_->next = new_var_block;
-  head_->trigger = opr_block;
-  head_->write = true;
-
-  // check if it is ready to write
-  if (pending_write_ == nullptr) {
-    // invariant: is_ready_to_read()
-    pending_write_ = head_;
-    CHECK_GE(num_pending_reads_, 0);
-    if (num_pending_reads_ == 0) {
+  uint64_t s = state_.load();
+  while (true) {
+    if ((s & kWritePending) == 0) {
       // STATE CHANGE
-      opr_block->decr_wait();
-      num_pending_reads_ = kWriteTriggered;
+      if (state_.compare_exchange_weak(s, s | kWritePending)) break;
+    } else if (state_.compare_exchange_weak(s, s + kQueuedOne)) {
+      Enqueue(opr_block, true);
+      return;
     }
-  } else {
-    CHECK_NE(num_pending_reads_, 0);
   }
-  head_ = new_var_block;
+  // this write is now the pending one
+  if (NumReads(s) == 0) {
+    opr_block->decr_wait();
+  } else if (pending_write_.exchange(opr_block) == ReadsDoneMark()) {
+    // the reads completed in between
+    pending_write_.store(nullptr);
+    opr_block->decr_wait();
+  }
 }
 
 template <typename Dispatcher>
 inline void ThreadedVar::CompleteReadDependency(Dispatcher dispatcher) {
-  OprBlock *trigger = nullptr;
-  {
-    // this is lock scope
-    std::lock_guard<std::mutex> lock{m_};
-    CHECK_GT(num_pending_reads_, 0);
-
-    if (--num_pending_reads_ == 0) {
-      if (pending_write_ != nullptr) {
-        // STATE CHANGE
-        trigger = pending_write_->trigger;
-        num_pending_reads_ = kWriteTriggered;
+  uint64_t s = state_.fetch_sub(1);
+  CHECK_GT(NumReads(s), 0U);
+  if (NumReads(s) == 1 && (s & kWritePending) != 0) {
+    // STATE CHANGE
+    OprBlock *trigger = pending_write_.exchange(ReadsDoneMark());
+    if (trigger != nullptr) {
+      pending_write_.store(nullptr);
+      if (trigger->decr_wait() == 0) {
+        dispatcher(trigger);
       }
     }
   }
-  if (trigger != nullptr && trigger->decr_wait() == 0) {
-    dispatcher(trigger);
-  }
 }
 
 template <typename Dispatcher>
 inline bool ThreadedVar::CompleteWriteDependency(Dispatcher dispatcher) {
-  // this is lock scope
-  VersionedVarBlock *old_pending_write, *end_of_read_chain;
+  // really delete
+  if (to_delete_) {
+    VersionedVarBlock::Delete(head_);
+    return true;
+  }
+  // invariants: no read runs, and appending threads only add to the queue
+  // while this thread takes from it
+  VersionedVarBlock *old_head = head_, *end_of_read_chain = head_;
   OprBlock* trigger_write = nullptr;
-  {
-    std::lock_guard<std::mutex> lock{m_};
-    // invariants
-    assert(head_->next == nullptr);
-    assert(pending_write_ != nullptr);
-    CHECK_EQ(num_pending_reads_, kWriteTriggered);
-
-    // really delete
-    if (to_delete_) {
-      VersionedVarBlock *head = pending_write_->next;
-      VersionedVarBlock::Delete(pending_write_);
-      assert(head_ == head);
-      VersionedVarBlock::Delete(head);
-      return true;
-    }
-    // detach pending write
-    old_pending_write = pending_write_;
+  uint64_t num_reads = 0, num_taken = 0;
+  uint64_t s = state_.load();
+  while (true) {
+    CHECK_EQ(NumReads(s), 0U);
+    CHECK_NE(s & kWritePending, 0U);
     // search for chains to trigger
-    end_of_read_chain = old_pending_write->next;
-    // reset to 0 pending reads
-    num_pending_reads_ = 0;
-    while (end_of_read_chain != head_ &&
-           end_of_read_chain->write == false) {
-      ++num_pending_reads_;
-      end_of_read_chain = end_of_read_chain->next;
-    }
-    if (end_of_read_chain == head_) {
-      pending_write_ = nullptr;
-    } else {
-      // check if there is pending reads, if not trigger write
-      assert(end_of_read_chain->write == true);
-      pending_write_ = end_of_read_chain;
-      if (num_pending_reads_ == 0) {
-        // mark write as already actived in this var
-        num_pending_reads_ = kWriteTriggered;
+    while (trigger_write == nullptr && num_taken < NumQueued(s)) {
+      end_of_read_chain = NextBlock(end_of_read_chain);
+      ++num_taken;
+      if (end_of_read_chain->write) {
         trigger_write = end_of_read_chain->trigger;
+      } else {
+        ++num_reads;
       }
     }
+    uint64_t next = s - num_taken * kQueuedOne + num_reads;
+    if (trigger_write == nullptr) {
+      next &= ~kWritePending;
+    } else if (num_reads != 0) {
+      // triggered by the last of the reads
+      pending_write_.store(trigger_write);
+    }
+    // fails only if more were queued
+    if (state_.compare_exchange_weak(s, next)) break;
   }
-  // This is outside of lock scope
-  // Be very carful, pending_write_ and num_pending_reads_
-  // can change now, do not reply ont the two variables.
-  // The linked list \in [old_pending_write, end_of_read_chain)
-  // is already detached from this Var.
-  // So it is safe to modify these
-  VersionedVarBlock *cur_head = old_pending_write->next;
-  VersionedVarBlock::Delete(old_pending_write);
-  // dispatch all the events
+  // The blocks in [old_head, end_of_read_chain) are detached from this Var,
+  // so it is safe to delete them. end_of_read_chain is the new head, and
+  // must not be touched once the last read is dispatched, since it may
+  // complete and trigger the next write at once.
+  head_ = end_of_read_chain;
+  VersionedVarBlock *cur_head = old_head;
   while (cur_head != end_of_read_chain) {
+    VersionedVarBlock *next = cur_head->next.load(std::memory_order_relaxed);
+    VersionedVarBlock::Delete(cur_head);
+    cur_head = next;
+    if (cur_head == end_of_read_chain && trigger_write != nullptr) break;
     if (cur_head->trigger->decr_wait() == 0) {
       dispatcher(cur_head->trigger);
     }
-    auto prev = cur_head;
-    cur_head = cur_head->next;
-    assert(cur_head != nullptr);
-    VersionedVarBlock::Delete(prev);
   }
-  if (trigger_write != nullptr && trigger_write->decr_wait() == 0) {
+  if (trigger_write != nullptr && num_reads == 0 &&
+      trigger_write->decr_wait() == 0) {
     dispatcher(trigger_write);
   }
   return false;
 }
 
 inline void ThreadedVar::SetToDelete() {
-  std::lock_guard<std::mutex> lock{m_};
   to_delete_ = true;
 }
 
 inline bool ThreadedVar::ready_to_read() {
-  std::lock_guard<std::mutex> lock{m_};
-  return this->is_ready_to_read();
+  return (state_.load() & kWritePending) == 0;
 }
 
 // implementation of threaded engine
@@ -186,10 +180,12 @@ ThreadedOpr* ThreadedEngine::NewOperator(
     ThreadedEngine::AsyncFn fn,
     std::vector<VarHandle> const& const_vars,
     std::vector<VarHandle> const& mutable_vars,
-    FnProperty prop) {
+    FnProperty prop,
+    const char* opr_name) {
   auto ret = ThreadedOpr::New();
   ret->fn = fn;
   ret->prop = prop;
+  ret->opr_name = opr_name;
   ret->const_vars.resize(const_vars.size());
   ret->mutable_vars.resize(mutable_vars.size());
   std::transform(const_vars.begin(), const_vars.end(),
@@ -277,15 +273,16 @@ void ThreadedEngine::Push(OprHandle op, Context exec_ctx, int priority) {
     i->AppendWriteDependency(opr_block);
   }
   if (opr_block->decr_wait() == 0) {
-    this->PushToExecute(opr_block, true);
+    this->PushReady(opr_block, true);
   }
 }
 
 void ThreadedEngine::PushAsync(AsyncFn fn, Context exec_ctx,
                                std::vector<VarHandle> const& const_vars,
                                std::vector<VarHandle> const& mutable_vars,
-                               FnProperty prop, int priority) {
-  ThreadedOpr *opr = NewOperator(fn, const_vars, mutable_vars, prop);
+                               FnProperty prop, int priority,
+                               const char* opr_name) {
+  ThreadedOpr *opr = NewOperator(fn, const_vars, mutable_vars, prop, opr_name);
   opr->temporary = true;
   Push(opr, exec_ctx, priority);
 }
@@ -342,7 +339,7 @@ inline void ThreadedEngine::OnComplete(ThreadedOpr* threaded_opr) {
   // Mark complete for read variables
   for (auto&& i : threaded_opr->const_vars) {
     i->CompleteReadDependency([this](OprBlock* opr) {
-        this->PushToExecute(opr, false);
+        this->PushReady(opr, false);
       });
   }
   // Mark complete for write variables.
@@ -357,7 +354,7 @@ inline void ThreadedEngine::OnComplete(ThreadedOpr* threaded_opr) {
             LOG(INFO) << "PushToExecute " << opr;
             debug_push_opr_ = opr;
           }
-          this->PushToExecute(opr, false);
+          this->PushReady(opr, false);
           if (debug_info) {
             LOG(INFO) << "Fin PushToExecute " << opr;
           }
@@ -384,9 +381,17 @@ inline void ThreadedEngine::OnComplete(ThreadedOpr* threaded_opr) {
 }
 
 void ThreadedEngine::OnCompleteStatic(
-    Engine *engine, void *threaded_opr) {
-  static_cast<ThreadedEngine*>(engine)->OnComplete(
-      static_cast<ThreadedOpr*>(threaded_opr));
+    Engine *engine, void *param) {
+  OprBlock *opr_block = static_cast<OprBlock*>(param);
+  ThreadedOpr *threaded_opr = opr_block->opr;
+  if (opr_block->start_us != 0) {
+    Profiler* profiler = Profiler::Get();
+    profiler->AddOprStat(threaded_opr->opr_name, opr_block->ctx,
+                         opr_block->profile_thread, opr_block->ready_us,
+                         opr_block->start_us, profiler->NowInUsec());
+  }
+  OprBlock::Delete(opr_block);
+  static_cast<ThreadedEngine*>(engine)->OnComplete(threaded_opr);
 }
 
 }  // namespace engine
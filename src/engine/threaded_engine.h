@@ -11,6 +11,7 @@
 
 #include <dmlc/base.h>
 #include <dmlc/logging.h>
+#include <cstdint>
 #include <vector>
 #include <functional>
 #include <condition_variable>
@@ -18,6 +19,7 @@
 #include <mutex>
 #include <string>
 #include "./engine_impl.h"
+#include "./profiler.h"
 #include "../common/object_pool.h"
 
 namespace mxnet {
@@ -51,6 +53,12 @@ struct OprBlock : public common::ObjectPoolAllocatable<OprBlock> {
   Context ctx;
   /*! \brief priority of the function */
   int priority;
+  /*! \brief time it was ready to run, recorded while profiling */
+  uint64_t ready_us{0};
+  /*! \brief time it started to run, recorded while profiling */
+  uint64_t start_us{0};
+  /*! \brief profiler index of the thread running it */
+  int profile_thread{-1};
   // define possible debug information
   DEFINE_ENGINE_DEBUG_INFO(OprBlock);
   /*!
@@ -71,8 +79,8 @@ struct OprBlock : public common::ObjectPoolAllocatable<OprBlock> {
  */
 struct VersionedVarBlock
     : public common::ObjectPoolAllocatable<VersionedVarBlock> {
-  /*! \brief next block in the LinkedList */
-  VersionedVarBlock* next{nullptr};
+  /*! \brief next block in the LinkedList, linked by the appending thread */
+  std::atomic<VersionedVarBlock*> next{nullptr};
   /*! \brief the operation this block triggers */
   OprBlock* trigger{nullptr};
   /*! \brief whether this operation is a write(mutate) operation. */
@@ -84,6 +92,13 @@ struct VersionedVarBlock
 /*!
  * \brief Variable implementation.
  *  Each ThreadedVar is a linked list(queue) of operations to be performed.
+ *
+ *  The state of the variable is a single atomic word, changed by
+ *  compare-and-swap instead of under a lock: the number of reads running,
+ *  whether a write is pending, and the number of operations queued behind it.
+ *  Reads are only queued while a write is pending, and then the operations
+ *  are appended to the list without locking. Only the completion of the
+ *  pending write takes operations from the list, so it has a single consumer.
  */
 class ThreadedVar final : public Var,
                           public common::ObjectPoolAllocatable<ThreadedVar> {
@@ -150,43 +165,56 @@ class ThreadedVar final : public Var,
 #endif  // ENGINE_DEBUG
 
  private:
-  // TODO(hotpxl) change this to spinlock for faster runtime
-  // TODO(hotpxl) consider rename head
-  /*! \brief inetrnal mutex of the ThreadedVar */
-  std::mutex m_;
+  /*! \brief bits of state_ counting the reads running */
+  static constexpr uint64_t kReadMask = (1ULL << 31) - 1;
+  /*! \brief bit of state_ set while a write is pending */
+  static constexpr uint64_t kWritePending = 1ULL << 31;
+  /*! \brief one operation queued in the higher bits of state_ */
+  static constexpr uint64_t kQueuedOne = 1ULL << 32;
+  /*! \return number of reads running in state \a s */
+  static inline uint64_t NumReads(uint64_t s) { return s & kReadMask; }
+  /*! \return number of operations queued in state \a s */
+  static inline uint64_t NumQueued(uint64_t s) { return s >> 32; }
   /*!
-   * \brief number of pending reads operation in the variable.
-   *  will be marked as -1 when there is a already triggered pending write.
+   * \brief mark left in pending_write_ by the last read completing before
+   *  the write pending is published there.
    */
-  int num_pending_reads_{0};
+  static inline OprBlock* ReadsDoneMark() {
+    return reinterpret_cast<OprBlock*>(static_cast<uintptr_t>(1));
+  }
+  /*! \brief append an operation to the list, by any thread */
+  inline void Enqueue(OprBlock* opr_block, bool write);
   /*!
-   * \brief Points to the last VersionedVarBlock in the queue.
-   *  head_ always points to a empty VersionedVarBlock.
-   *  So when we want to append an operation to the queue:
-   *    1) update head_->trigger to be new op
-   *    2) update head_->next to be a new VersionedVarBlock
-   *    3) move head to head->next.
+   * \brief the block after \a blk, waiting for the thread appending it to
+   *  link it if needed.
    */
-  VersionedVarBlock* head_{nullptr};
+  static inline VersionedVarBlock* NextBlock(VersionedVarBlock* blk);
   /*!
-   * \brief The pointer to next write to perform.
-   *  This pointer will only be updated when the write completes.
-   *  This is actually the head(oldest operation) in the queue.
+   * \brief the state: number of reads running, the pending write bit and
+   *  number of operations queued.
+   *  While a write is pending and no read runs, the write is triggered.
    */
-  VersionedVarBlock* pending_write_{nullptr};
+  std::atomic<uint64_t> state_{0};
   /*!
-   * \brief If true, delete after operation completes.
+   * \brief The write to trigger once the reads running complete.
+   *  Set by the completion of the previous write, or exchanged with
+   *  ReadsDoneMark() when a write appended to a variable with reads running
+   *  races with the completion of the last of them, so that whichever comes
+   *  second triggers the write.
    */
-  bool to_delete_{false};
-  /*! \brief special const on num_pending_reads_ to mark write being triggered */
-  static constexpr int kWriteTriggered = -1;
+  std::atomic<OprBlock*> pending_write_{nullptr};
   /*!
-   * \brief derived invariant of ready to ready, without lock.
-   * \return whether the current variable is ready to read.
+   * \brief The last block taken from the list, always empty of meaning.
+   *  The operations queued are the blocks after it. Only accessed by the
+   *  completion of the pending write.
    */
-  inline bool is_ready_to_read() const {
-    return pending_write_ == nullptr;
-  }
+  VersionedVarBlock* head_{nullptr};
+  /*! \brief The last block appended, exchanged by the appending threads. */
+  std::atomic<VersionedVarBlock*> tail_{nullptr};
+  /*!
+   * \brief If true, delete after operation completes.
+   */
+  bool to_delete_{false};
 };  // struct ThreadedVar
 
 /*!
@@ -202,6 +230,8 @@ struct ThreadedOpr final : public Opr,
   std::vector<ThreadedVar*> mutable_vars;
   /*! \brief the property of the operator */
   FnProperty prop;
+  /*! \brief the name shown by the profiler, may be null */
+  const char* opr_name{nullptr};
   /*!
    * \brief Whether this is an temporary operator
    *        that can be deleted right after the operation completed.
@@ -235,14 +265,16 @@ class ThreadedEngine : public Engine {
   ThreadedOpr* NewOperator(AsyncFn fn,
                            std::vector<VarHandle> const& const_vars,
                            std::vector<VarHandle> const& mutable_vars,
-                           FnProperty prop) override;
+                           FnProperty prop,
+                           const char* opr_name) override;
   void DeleteOperator(OprHandle op) override;
   void Push(OprHandle op, Context exec_ctx, int priority) override;
   void PushAsync(AsyncFn exec_fun, Context exec_ctx,
                  std::vector<VarHandle> const& const_vars,
                  std::vector<VarHandle> const& mutable_vars,
                  FnProperty prop,
-                 int priority) override;
+                 int priority,
+                 const char* opr_name) override;
   void DeleteVariable(SyncFn delete_fn, Context exec_ctx, VarHandle var) override;
   void WaitForVar(VarHandle var) override;
   void WaitForAll() override;
@@ -278,14 +310,19 @@ class ThreadedEngine : public Engine {
   virtual void PushToExecute(OprBlock* opr_block, bool pusher_thread) = 0;
   /*!
    * \brief Call this function to actually execute an opr_block
-   *  This function also deletes the opr_block after execution.
+   *  The opr_block is deleted once the execution completes.
    * \param run_ctx runtime context used to execute the function.
    * \param opr_block the opr_block to be executed and deleted.
    */
   void ExecuteOprBlock(RunContext run_ctx, OprBlock *opr_block) {
     ThreadedOpr* threaded_opr = opr_block->opr;
+    Profiler* profiler = Profiler::Get();
+    if (profiler->IsRunning()) {
+      opr_block->profile_thread = profiler->ThreadIndex();
+      opr_block->start_us = profiler->NowInUsec();
+    }
     CallbackOnComplete callback = this->CreateCallback(
-        ThreadedEngine::OnCompleteStatic, threaded_opr);
+        ThreadedEngine::OnCompleteStatic, opr_block);
     bool debug_info = (engine_info_ && debug_push_opr_ == opr_block);
     if (debug_info) {
       LOG(INFO) << "ExecuteOprBlock " << opr_block
@@ -318,8 +355,6 @@ class ThreadedEngine : public Engine {
     } else {
       callback();
     }
-
-    OprBlock::Delete(opr_block);
   }
 
  private:
@@ -337,7 +372,18 @@ class ThreadedEngine : public Engine {
    */
   inline void OnComplete(ThreadedOpr* threaded_opr);
   // callback to the threaded engine
-  static void OnCompleteStatic(Engine *engine, void *threaded_opr);
+  static void OnCompleteStatic(Engine *engine, void *opr_block);
+  /*!
+   * \brief Push an opr_block whose dependencies are all satisfied
+   *  to execute, recording the time for the profiler.
+   */
+  inline void PushReady(OprBlock* opr_block, bool pusher_thread) {
+    Profiler* profiler = Profiler::Get();
+    if (profiler->IsRunning()) {
+      opr_block->ready_us = profiler->NowInUsec();
+    }
+    this->PushToExecute(opr_block, pusher_thread);
+  }
   /*!
    * \brief Number of pending operations.
    */
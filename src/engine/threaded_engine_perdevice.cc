@@ -11,6 +11,7 @@
 #include <dmlc/concurrency.h>
 #include "./threaded_engine.h"
 #include "./thread_pool.h"
+#include "./work_stealing_pool.h"
 #include "../common/lazy_alloc_array.h"
 #include "../common/utils.h"
 
@@ -21,6 +22,8 @@ namespace engine {
  * The policy of this Engine:
  *  - Execute Async operation immediately if pushed from Pusher.
  *  - Use fixed amount of threads for each device.
+ *  - CPU threads steal work from each other, and run an operation made
+ *    ready by the one they complete right after it.
  *  - Use special threads for copy operations.
  *  - Each stream is allocated and bound to each of the thread.
  */
@@ -71,13 +74,13 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
         } else {
           int dev_id = ctx.dev_id;
           int nthread = cpu_worker_nthreads_;
-          cpu_normal_workers_.Get(dev_id, [this, dev_id, nthread]() {
-              auto blk = new ThreadWorkerBlock<kWorkerQueue>();
-              blk->pool.reset(new ThreadPool(nthread, [this, blk] () {
-                    this->CPUWorker(blk);
-                  }));
-              return blk;
-            })->task_queue.Push(opr_block, opr_block->priority);
+          cpu_normal_workers_.Get(dev_id, [this, nthread]() {
+              return new WorkStealingPool<OprBlock*>(nthread, [this](OprBlock* blk) {
+                  RunContext run_ctx;
+                  run_ctx.stream = nullptr;
+                  this->ExecuteOprBlock(run_ctx, blk);
+                });
+            })->Push(opr_block);
         }
       } else {
         CHECK_EQ(ctx.dev_mask(), gpu::kDevMask);
@@ -128,7 +131,7 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
   /*! \brief number of concurrent thread each gpu copy worker uses */
   int gpu_copy_nthreads_;
   // cpu worker
-  common::LazyAllocArray<ThreadWorkerBlock<kWorkerQueue> > cpu_normal_workers_;
+  common::LazyAllocArray<WorkStealingPool<OprBlock*> > cpu_normal_workers_;
   // cpu priority worker
   std::unique_ptr<ThreadWorkerBlock<kPriorityQueue> > cpu_priority_worker_;
   // workers doing normal works on GPU
@@ -0,0 +1,325 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file work_stealing_pool.h
+ * \brief thread pool whose threads take tasks from the deques of each other.
+ */
+#ifndef MXNET_ENGINE_WORK_STEALING_POOL_H_
+#define MXNET_ENGINE_WORK_STEALING_POOL_H_
+
+#include <dmlc/base.h>
+#include <dmlc/logging.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "mxnet/base.h"
+#include "../common/thread_local.h"
+
+namespace mxnet {
+namespace engine {
+
+/*!
+ * \brief Lock-free deque of Chase and Lev, in the formulation of Le et al.
+ *  for weak memory models. The owner thread pushes and pops at the bottom,
+ *  any other thread steals from the top.
+ * \tparam T trivially copyable type of the elements.
+ */
+template<typename T>
+class WorkStealingDeque {
+ public:
+  /*!
+   * \brief Constructor.
+   * \param capacity initial capacity, a power of two. It grows when full.
+   */
+  explicit WorkStealingDeque(int64_t capacity = 256) {
+    CHECK(capacity > 0 && (capacity & (capacity - 1)) == 0)
+        << "capacity must be a power of two";
+    arrays_.emplace_back(new Array(capacity));
+    array_.store(arrays_.back().get(), std::memory_order_relaxed);
+  }
+  /*!
+   * \brief Push at the bottom, by the owner only.
+   * \param x the element.
+   */
+  void Push(T x) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    Array* a = array_.load(std::memory_order_relaxed);
+    if (b - t > a->capacity - 1) {
+      a = Grow(a, t, b);
+    }
+    a->Put(b, x);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+  /*!
+   * \brief Pop the last element pushed, by the owner only.
+   * \param x the element popped.
+   * \return false if empty.
+   */
+  bool Pop(T* x) {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    Array* a = array_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+    *x = a->Get(b);
+    if (t < b) return true;
+    // the last element, raced with thieves
+    bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                            std::memory_order_relaxed);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return won;
+  }
+  /*!
+   * \brief Steal the first element pushed, by any thread.
+   * \param x the element stolen.
+   * \return false if empty or another thread took the element first.
+   */
+  bool Steal(T* x) {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) return false;
+    Array* a = array_.load(std::memory_order_acquire);
+    T v = a->Get(t);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return false;
+    }
+    *x = v;
+    return true;
+  }
+  /*! \return whether the deque looks empty, by any thread. */
+  bool Empty() const {
+    int64_t t = top_.load(std::memory_order_acquire);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    return t >= b;
+  }
+
+ private:
+  /*! \brief circular array of the elements */
+  struct Array {
+    explicit Array(int64_t c) : capacity(c), data(new std::atomic<T>[c]) {}
+    T Get(int64_t i) const {
+      return data[i & (capacity - 1)].load(std::memory_order_relaxed);
+    }
+    void Put(int64_t i, T x) {
+      data[i & (capacity - 1)].store(x, std::memory_order_relaxed);
+    }
+    int64_t capacity;
+    std::unique_ptr<std::atomic<T>[]> data;
+  };
+  /*!
+   * \brief Double the capacity. The old arrays are kept until destruction,
+   *  since thieves may still read them.
+   */
+  Array* Grow(Array* a, int64_t t, int64_t b) {
+    arrays_.emplace_back(new Array(a->capacity * 2));
+    Array* bigger = arrays_.back().get();
+    for (int64_t i = t; i < b; ++i) bigger->Put(i, a->Get(i));
+    array_.store(bigger, std::memory_order_release);
+    return bigger;
+  }
+  /*! \brief index of the first element, advanced by thieves */
+  std::atomic<int64_t> top_{0};
+  /*! \brief one past the last element, written by the owner only */
+  std::atomic<int64_t> bottom_{0};
+  /*! \brief the current array */
+  std::atomic<Array*> array_;
+  /*! \brief all arrays allocated, written by the owner only */
+  std::vector<std::unique_ptr<Array> > arrays_;
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingDeque);
+};
+
+/*!
+ * \brief Thread pool running tasks from a deque per thread.
+ *
+ *  A task pushed by a thread of the pool goes to the deque of this thread,
+ *  without locking. A task pushed by any other thread goes to a shared
+ *  queue. An idle thread takes the last task of its own deque, then the
+ *  first of the shared queue, then steals the first of the deque of a
+ *  random other thread, and sleeps once none has work.
+ *
+ *  A task pushed by a thread of the pool while running a task, such as an
+ *  operation made ready by the completion of the running one, is run by the
+ *  same thread right after, without going through the deque. A task waiting
+ *  there before is moved to the deque, so that others can steal it.
+ *
+ * \tparam T trivially copyable type of the tasks.
+ */
+template<typename T>
+class WorkStealingPool {
+ public:
+  /*!
+   * \brief Constructor.
+   * \param size number of threads.
+   * \param run the function running a task.
+   */
+  WorkStealingPool(int size, std::function<void(T)> run)
+      : run_(run), workers_(std::max(size, 1)) {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      workers_[i].reset(new Worker());
+      workers_[i]->pool = this;
+    }
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      threads_.emplace_back([this, i]() { this->Run(i); });
+    }
+  }
+  /*!
+   * \brief Stop the threads once their running tasks are done. The tasks
+   *  not started are dropped.
+   */
+  ~WorkStealingPool() noexcept(false) {
+    {
+      std::lock_guard<std::mutex> lock{m_};
+      stop_.store(true);
+    }
+    cv_.notify_all();
+    for (auto& t : threads_) t.join();
+  }
+  /*!
+   * \brief Push a task. Threadsafe.
+   * \param task the task.
+   */
+  void Push(T task) {
+    Worker* self = Current();
+    if (self != nullptr && self->pool == this) {
+      if (self->has_next) {
+        self->deque.Push(self->next);
+        Notify();
+      }
+      self->next = task;
+      self->has_next = true;
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock{shared_m_};
+      shared_.push_back(task);
+    }
+    num_shared_.fetch_add(1);
+    Notify();
+  }
+
+ private:
+  /*! \brief state of a thread */
+  struct Worker {
+    WorkStealingDeque<T> deque;
+    /*! \brief the task run right after the running one */
+    T next;
+    bool has_next{false};
+    WorkStealingPool* pool{nullptr};
+  };
+  /*! \return the worker of the calling thread, null if it is not one */
+  static Worker*& Current() {
+    static MX_TREAD_LOCAL Worker* current = nullptr;
+    return current;
+  }
+  /*! \brief wake up a sleeping thread, if any, after a push */
+  void Notify() {
+    // pairs with the fence in Sleep, so that either the pushed task is seen
+    // there or the sleeper is seen here
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_sleeping_.load(std::memory_order_relaxed) > 0) {
+      { std::lock_guard<std::mutex> lock{m_}; }
+      cv_.notify_one();
+    }
+  }
+  /*!
+   * \brief Take a task for the i-th thread.
+   * \return false if none found.
+   */
+  bool Take(size_t i, std::mt19937* rng, T* task) {
+    Worker* self = workers_[i].get();
+    if (self->has_next) {
+      *task = self->next;
+      self->has_next = false;
+      return true;
+    }
+    if (self->deque.Pop(task)) return true;
+    if (num_shared_.load() > 0) {
+      std::lock_guard<std::mutex> lock{shared_m_};
+      if (!shared_.empty()) {
+        *task = shared_.front();
+        shared_.pop_front();
+        num_shared_.fetch_sub(1);
+        return true;
+      }
+    }
+    size_t n = workers_.size();
+    if (n == 1) return false;
+    // visit all others, from a random one
+    size_t start = (*rng)() % n;
+    for (size_t k = 0; k < n; ++k) {
+      size_t victim = (start + k) % n;
+      if (victim != i && workers_[victim]->deque.Steal(task)) return true;
+    }
+    return false;
+  }
+  /*! \return whether any thread may find a task */
+  bool HasWork() const {
+    if (num_shared_.load() > 0) return true;
+    for (const auto& w : workers_) {
+      if (!w->deque.Empty()) return true;
+    }
+    return false;
+  }
+  /*! \brief sleep until a push, unless there is work */
+  void Sleep() {
+    std::unique_lock<std::mutex> lock{m_};
+    num_sleeping_.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!HasWork() && !stop_.load()) cv_.wait(lock);
+    num_sleeping_.fetch_sub(1);
+  }
+  /*! \brief the loop of the i-th thread */
+  void Run(size_t i) {
+    Current() = workers_[i].get();
+    std::mt19937 rng(static_cast<unsigned>(i) * 7919 + 1);
+    T task;
+    while (!stop_.load(std::memory_order_relaxed)) {
+      bool found = false;
+      // spin a little before sleeping, a task is often pushed soon
+      for (int spin = 0; spin < kSpins && !found; ++spin) {
+        found = Take(i, &rng, &task);
+        if (!found) std::this_thread::yield();
+      }
+      if (found) {
+        run_(task);
+      } else {
+        Sleep();
+      }
+    }
+    Current() = nullptr;
+  }
+  /*! \brief number of attempts to find a task before sleeping */
+  static constexpr int kSpins = 64;
+  std::function<void(T)> run_;
+  std::vector<std::unique_ptr<Worker> > workers_;
+  std::vector<std::thread> threads_;
+  /*! \brief tasks pushed by other threads */
+  std::deque<T> shared_;
+  std::mutex shared_m_;
+  std::atomic<int> num_shared_{0};
+  /*! \brief guards sleeping */
+  std::mutex m_;
+  std::condition_variable cv_;
+  std::atomic<int> num_sleeping_{0};
+  std::atomic<bool> stop_{false};
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingPool);
+};
+
+}  // namespace engine
+}  // namespace mxnet
+#endif  // MXNET_ENGINE_WORK_STEALING_POOL_H_
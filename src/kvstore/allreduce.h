@@ -0,0 +1,437 @@
+/**
+ * Copyright (c) 2016 by Contributors
+ * @file   allreduce.h
+ * @brief  allreduce, broadcast and barrier among workers over TCP
+ */
+#ifndef MXNET_KVSTORE_ALLREDUCE_H_
+#define MXNET_KVSTORE_ALLREDUCE_H_
+#include <dmlc/logging.h>
+#include <mxnet/base.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "./reduce_sum.h"
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief collective operations among the workers of a job, over a TCP
+ * connection between every pair of workers.
+ *
+ * Workers meet at the root address, where rank 0 listens, and learn the
+ * addresses of each other there. Every worker must issue the same operations
+ * in the same order. The results are bitwise identical on all workers.
+ *
+ * Not threadsafe.
+ */
+class Allreduce {
+ public:
+  /**
+   * \brief connect the \a num_workers workers, blocked until all joined
+   */
+  Allreduce(int rank, int num_workers, const std::string& root_uri,
+            int root_port)
+      : rank_(rank), size_(num_workers), fds_(num_workers, -1) {
+    CHECK_GE(rank, 0);
+    CHECK_LT(rank, num_workers);
+    if (size_ > 1) Connect(root_uri, root_port);
+  }
+
+  ~Allreduce() {
+    for (int fd : fds_) {
+      if (fd >= 0) close(fd);
+    }
+  }
+
+  int rank() const { return rank_; }
+  int size() const { return size_; }
+
+  /**
+   * \brief replace \a data of \a n values by its sum over all workers.
+   *
+   * With \a ring, the data is split into one chunk per worker, which are
+   * summed and then gathered along a ring in 2 (size - 1) steps, so every
+   * worker sends about 2n values. Otherwise recursive halving and doubling
+   * is used, which needs only 2 log(size) steps and suits small data.
+   */
+  void Sum(real_t* data, size_t n, bool ring) {
+    if (size_ == 1 || n == 0) return;
+    if (ring) {
+      RingSum(data, n);
+    } else {
+      HalvingSum(data, n);
+    }
+  }
+
+  /**
+   * \brief copy \a data of \a n values of worker \a root to all workers, along
+   * a binomial tree
+   */
+  void Broadcast(real_t* data, size_t n, int root) {
+    const size_t bytes = n * sizeof(real_t);
+    int vrank = (rank_ - root + size_) % size_;
+    for (int mask = 1; mask < size_; mask <<= 1) {
+      if (vrank < mask) {
+        if (vrank + mask < size_) {
+          Send((vrank + mask + root) % size_, data, bytes);
+        }
+      } else if (vrank < 2 * mask) {
+        Recv((vrank - mask + root) % size_, data, bytes);
+      }
+    }
+  }
+
+  /**
+   * \brief block until all workers called it
+   */
+  void Barrier() {
+    real_t x = 0;
+    Sum(&x, 1, false);
+  }
+
+ private:
+  /// \brief the first value of the i-th of \a num chunks of \a n values
+  static size_t ChunkBegin(size_t n, int i, int num) {
+    return n * i / num;
+  }
+
+  void RingSum(real_t* data, size_t n) {
+    const int right = (rank_ + 1) % size_;
+    const int left = (rank_ - 1 + size_) % size_;
+    auto begin = [n, this](int c) { return ChunkBegin(n, c, size_); };
+    auto len = [n, this](int c) {
+      return ChunkBegin(n, c + 1, size_) - ChunkBegin(n, c, size_);
+    };
+    tmp_.resize(len(size_ - 1) + 1);
+    // reduce-scatter, after which chunk (rank + 1) is summed here
+    for (int s = 0; s < size_ - 1; ++s) {
+      int send_c = (rank_ - s + size_) % size_;
+      int recv_c = (rank_ - s - 1 + size_) % size_;
+      SendRecv(right, data + begin(send_c), len(send_c) * sizeof(real_t),
+               left, tmp_.data(), len(recv_c) * sizeof(real_t));
+      real_t* dst = data + begin(recv_c);
+      ReduceSum({dst, tmp_.data()}, dst, 0, len(recv_c), false);
+    }
+    // allgather the summed chunks
+    for (int s = 0; s < size_ - 1; ++s) {
+      int send_c = (rank_ + 1 - s + size_) % size_;
+      int recv_c = (rank_ - s + size_) % size_;
+      SendRecv(right, data + begin(send_c), len(send_c) * sizeof(real_t),
+               left, data + begin(recv_c), len(recv_c) * sizeof(real_t));
+    }
+  }
+
+  void HalvingSum(real_t* data, size_t n) {
+    const size_t bytes = n * sizeof(real_t);
+    // fold the workers into a power of two. the first 2 * rem workers pair
+    // up, the even one of each pair sends its data to the odd one and idles
+    int pow2 = 1;
+    while (pow2 * 2 <= size_) pow2 *= 2;
+    const int rem = size_ - pow2;
+    int vrank;
+    if (rank_ < 2 * rem) {
+      if (rank_ % 2 == 0) {
+        Send(rank_ + 1, data, bytes);
+        vrank = -1;
+      } else {
+        tmp_.resize(n);
+        Recv(rank_ - 1, tmp_.data(), bytes);
+        ReduceSum({data, tmp_.data()}, data, 0, n, false);
+        vrank = rank_ / 2;
+      }
+    } else {
+      vrank = rank_ - rem;
+    }
+    auto real_rank = [rem](int v) { return v < rem ? 2 * v + 1 : v + rem; };
+
+    if (vrank >= 0) {
+      // reduce-scatter by recursive halving. segs[i] is the part summed
+      // before step i
+      std::vector<std::pair<size_t, size_t>> segs;
+      size_t lo = 0, hi = n;
+      tmp_.resize(n / 2 + 1);
+      for (int mask = pow2 / 2; mask >= 1; mask /= 2) {
+        int partner = real_rank(vrank ^ mask);
+        size_t mid = lo + (hi - lo) / 2;
+        segs.emplace_back(lo, hi);
+        bool keep_low = vrank < (vrank ^ mask);
+        size_t send_lo = keep_low ? mid : lo, send_hi = keep_low ? hi : mid;
+        size_t keep_lo = keep_low ? lo : mid, keep_hi = keep_low ? mid : hi;
+        SendRecv(partner, data + send_lo, (send_hi - send_lo) * sizeof(real_t),
+                 partner, tmp_.data(), (keep_hi - keep_lo) * sizeof(real_t));
+        ReduceSum({data + keep_lo, tmp_.data()}, data + keep_lo,
+                  0, keep_hi - keep_lo, false);
+        lo = keep_lo;
+        hi = keep_hi;
+      }
+      // allgather by recursive doubling, in the reverse order
+      for (int mask = 1; mask < pow2; mask *= 2) {
+        int partner = real_rank(vrank ^ mask);
+        size_t seg_lo = segs.back().first, seg_hi = segs.back().second;
+        segs.pop_back();
+        // the partner holds the rest of [seg_lo, seg_hi)
+        size_t other_lo = lo == seg_lo ? hi : seg_lo;
+        size_t other_hi = lo == seg_lo ? seg_hi : lo;
+        SendRecv(partner, data + lo, (hi - lo) * sizeof(real_t),
+                 partner, data + other_lo, (other_hi - other_lo) * sizeof(real_t));
+        lo = seg_lo;
+        hi = seg_hi;
+      }
+    }
+
+    // unfold
+    if (rank_ < 2 * rem) {
+      if (rank_ % 2 == 1) {
+        Send(rank_ - 1, data, bytes);
+      } else {
+        Recv(rank_ + 1, data, bytes);
+      }
+    }
+  }
+
+  void Send(int peer, const void* buf, size_t len) {
+    SendRecv(peer, buf, len, peer, nullptr, 0);
+  }
+
+  void Recv(int peer, void* buf, size_t len) {
+    SendRecv(peer, nullptr, 0, peer, buf, len);
+  }
+
+  /**
+   * \brief send to \a to and receive from \a from at the same time, so that
+   * two workers exchanging data never wait for each other
+   */
+  void SendRecv(int to, const void* send_buf, size_t send_len,
+                int from, void* recv_buf, size_t recv_len) {
+    const char* sbuf = static_cast<const char*>(send_buf);
+    char* rbuf = static_cast<char*>(recv_buf);
+    size_t sent = 0, recved = 0;
+    while (sent < send_len || recved < recv_len) {
+      pollfd pfd[2];
+      int num = 0, si = -1, ri = -1;
+      if (sent < send_len) {
+        pfd[num] = {fds_[to], POLLOUT, 0};
+        si = num++;
+      }
+      if (recved < recv_len) {
+        pfd[num] = {fds_[from], POLLIN, 0};
+        ri = num++;
+      }
+      if (poll(pfd, num, -1) < 0) {
+        CHECK_EQ(errno, EINTR) << "poll failed: " << strerror(errno);
+        continue;
+      }
+      if (si >= 0 && pfd[si].revents) {
+        ssize_t k = send(fds_[to], sbuf + sent, send_len - sent,
+                         MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (k < 0) {
+          CHECK(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+              << "send to worker " << to << " failed: " << strerror(errno);
+        } else {
+          sent += k;
+        }
+      }
+      if (ri >= 0 && pfd[ri].revents) {
+        ssize_t k = recv(fds_[from], rbuf + recved, recv_len - recved,
+                         MSG_DONTWAIT);
+        CHECK_NE(k, 0) << "worker " << from << " closed the connection";
+        if (k < 0) {
+          CHECK(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+              << "recv from worker " << from << " failed: " << strerror(errno);
+        } else {
+          recved += k;
+        }
+      }
+    }
+  }
+
+  /// \brief send all of \a buf on \a fd
+  static void SendAll(int fd, const void* buf, size_t len) {
+    const char* p = static_cast<const char*>(buf);
+    while (len > 0) {
+      ssize_t k = send(fd, p, len, MSG_NOSIGNAL);
+      if (k < 0 && errno == EINTR) continue;
+      CHECK_GT(k, 0) << "send failed: " << strerror(errno);
+      p += k;
+      len -= k;
+    }
+  }
+
+  /// \brief receive \a len bytes into \a buf from \a fd
+  static void RecvAll(int fd, void* buf, size_t len) {
+    char* p = static_cast<char*>(buf);
+    while (len > 0) {
+      ssize_t k = recv(fd, p, len, 0);
+      if (k < 0 && errno == EINTR) continue;
+      CHECK_GT(k, 0) << "recv failed: " << (k == 0 ? "closed" : strerror(errno));
+      p += k;
+      len -= k;
+    }
+  }
+
+  /// \brief listen on \a port of all interfaces, 0 for any free port
+  static int Listen(int port, int backlog) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    CHECK_GE(fd, 0) << "socket failed: " << strerror(errno);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    CHECK_EQ(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0)
+        << "bind port " << port << " failed: " << strerror(errno);
+    CHECK_EQ(listen(fd, backlog), 0) << "listen failed: " << strerror(errno);
+    return fd;
+  }
+
+  /// \brief accept a connection on \a listen_fd, return the peer address
+  static int Accept(int listen_fd, std::string* host) {
+    sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int fd;
+    do {
+      fd = accept(listen_fd, reinterpret_cast<sockaddr*>(&addr), &addr_len);
+    } while (fd < 0 && errno == EINTR);
+    CHECK_GE(fd, 0) << "accept failed: " << strerror(errno);
+    if (host != nullptr) {
+      char buf[INET_ADDRSTRLEN];
+      *host = inet_ntop(AF_INET, &addr.sin_addr, buf, sizeof(buf));
+    }
+    SetNoDelay(fd);
+    return fd;
+  }
+
+  /// \brief connect to \a host:port, retrying until it listens
+  static int ConnectTo(const std::string& host, int port) {
+    addrinfo hints, *res = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    int err = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res);
+    CHECK_EQ(err, 0) << "cannot resolve " << host << ": " << gai_strerror(err);
+    const int kRetry = 600;
+    for (int i = 0; ; ++i) {
+      int fd = socket(AF_INET, SOCK_STREAM, 0);
+      CHECK_GE(fd, 0) << "socket failed: " << strerror(errno);
+      if (connect(fd, res->ai_addr, res->ai_addrlen) == 0) {
+        freeaddrinfo(res);
+        SetNoDelay(fd);
+        return fd;
+      }
+      close(fd);
+      CHECK_LT(i, kRetry) << "cannot connect to " << host << ":" << port
+                          << ": " << strerror(errno);
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+  }
+
+  static void SetNoDelay(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  static void SendString(int fd, const std::string& str) {
+    int32_t len = str.size();
+    SendAll(fd, &len, sizeof(len));
+    SendAll(fd, str.data(), len);
+  }
+
+  static std::string RecvString(int fd) {
+    int32_t len;
+    RecvAll(fd, &len, sizeof(len));
+    std::string str(len, '\0');
+    RecvAll(fd, &str[0], len);
+    return str;
+  }
+
+  /**
+   * \brief meet at the root and connect to every other worker
+   */
+  void Connect(const std::string& root_uri, int root_port) {
+    int listen_fd = Listen(0, size_);
+    sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    CHECK_EQ(getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &addr_len), 0);
+    int32_t my_port = ntohs(addr.sin_port);
+
+    // learn the address of every worker at the root
+    std::vector<std::string> hosts(size_);
+    std::vector<int32_t> ports(size_);
+    if (rank_ == 0) {
+      int root_fd = Listen(root_port, size_);
+      hosts[0] = root_uri;
+      ports[0] = my_port;
+      std::vector<int> fds(size_, -1);
+      for (int i = 1; i < size_; ++i) {
+        std::string host;
+        int fd = Accept(root_fd, &host);
+        int32_t msg[2];
+        RecvAll(fd, msg, sizeof(msg));
+        CHECK(msg[0] > 0 && msg[0] < size_ && fds[msg[0]] < 0)
+            << "invalid or duplicate worker rank " << msg[0];
+        fds[msg[0]] = fd;
+        hosts[msg[0]] = host;
+        ports[msg[0]] = msg[1];
+      }
+      for (int i = 1; i < size_; ++i) {
+        for (int j = 0; j < size_; ++j) {
+          SendString(fds[i], hosts[j]);
+          SendAll(fds[i], &ports[j], sizeof(ports[j]));
+        }
+        close(fds[i]);
+      }
+      close(root_fd);
+    } else {
+      int fd = ConnectTo(root_uri, root_port);
+      int32_t msg[2] = {rank_, my_port};
+      SendAll(fd, msg, sizeof(msg));
+      for (int j = 0; j < size_; ++j) {
+        hosts[j] = RecvString(fd);
+        RecvAll(fd, &ports[j], sizeof(ports[j]));
+      }
+      close(fd);
+    }
+
+    // connect to the lower ranks, and accept the higher ones
+    for (int j = 0; j < rank_; ++j) {
+      fds_[j] = ConnectTo(hosts[j], ports[j]);
+      int32_t me = rank_;
+      SendAll(fds_[j], &me, sizeof(me));
+    }
+    for (int j = rank_ + 1; j < size_; ++j) {
+      int fd = Accept(listen_fd, nullptr);
+      int32_t peer;
+      RecvAll(fd, &peer, sizeof(peer));
+      CHECK(peer > rank_ && peer < size_ && fds_[peer] < 0)
+          << "invalid or duplicate worker rank " << peer;
+      fds_[peer] = fd;
+    }
+    close(listen_fd);
+  }
+
+  int rank_;
+  int size_;
+  /// \brief the connection to each worker, -1 for itself
+  std::vector<int> fds_;
+  /// \brief the received data to be summed
+  std::vector<real_t> tmp_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_ALLREDUCE_H_
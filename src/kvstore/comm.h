@@ -10,6 +10,7 @@
 #include <limits>
 #include <vector>
 #include "mxnet/ndarray.h"
+#include "./reduce_sum.h"
 namespace mxnet {
 namespace kvstore {
 /**
@@ -54,7 +55,20 @@ class CommCPU : public Comm {
   virtual ~CommCPU() { }
 
   void Init(int key, const TShape &shape) override {
-    merge_buf_[key].merged = NDArray(shape, pinned_ctx_);
+    NDArray merged(shape, pinned_ctx_);
+    merge_buf_[key].merged = merged;
+    if (pinned_ctx_.dev_type == Context::kCPU &&
+        shape.Size() >= bigarray_bound_ && nthread_reduction_ > 1) {
+      // the pages of a buffer are placed on the NUMA node of the thread
+      // writing them first. let the reduction threads write them, in the
+      // same chunks they reduce later
+      Engine::Get()->PushSync([merged, this](RunContext rctx) {
+          real_t* dptr = merged.data().FlatTo2D<cpu, real_t>().dptr_;
+          ParallelFor(merged.shape().Size(), [dptr](size_t begin, size_t end) {
+              std::fill(dptr + begin, dptr + end, 0);
+            });
+        }, Context::CPU(), {}, {merged.var()}, FnProperty::kCPUPrioritized);
+    }
   }
 
   const NDArray& Reduce(int key, const std::vector<NDArray>& src,
@@ -64,28 +78,37 @@ class CommCPU : public Comm {
     if (src.size() == 1) {
       return src[0];
     }
-    std::vector<Engine::VarHandle> const_vars(src.size() - 1);
+    std::vector<Engine::VarHandle> const_vars;
     std::vector<NDArray> reduce(src.size());
     auto& buf = merge_buf_[key];
-    CopyFromTo(src[0], &buf.merged, priority);
-    reduce[0] = buf.merged;
-
-    if (buf.copy_buf.empty()) {
-      buf.copy_buf.resize(src.size()-1);
-      for (size_t j = 0; j < src.size() - 1; ++j) {
-        buf.copy_buf[j] = NDArray(src[0].shape(), pinned_ctx_);
+    size_t num_copy = 0;
+    for (size_t i = 0; i < src.size(); ++i) {
+      if (src[i].ctx().dev_mask() == cpu::kDevMask) {
+        // cpu arrays are read in place
+        reduce[i] = src[i];
+      } else if (i == 0) {
+        // summed into in place
+        CopyFromTo(src[0], &buf.merged, priority);
+        reduce[0] = buf.merged;
+        continue;
+      } else {
+        if (buf.copy_buf.size() == num_copy) {
+          buf.copy_buf.push_back(NDArray(src[0].shape(), pinned_ctx_));
+        }
+        CopyFromTo(src[i], &(buf.copy_buf[num_copy]), priority);
+        reduce[i] = buf.copy_buf[num_copy++];
       }
+      const_vars.push_back(reduce[i].var());
     }
-    for (size_t i = 1; i < src.size(); ++i) {
-      CopyFromTo(src[i], &(buf.copy_buf[i-1]), priority);
-      reduce[i] = buf.copy_buf[i-1];
-      const_vars[i-1] = reduce[i].var();
-    }
+    std::sort(const_vars.begin(), const_vars.end());
+    const_vars.erase(std::unique(const_vars.begin(), const_vars.end()),
+                     const_vars.end());
 
-    Engine::Get()->PushSync([reduce, this](RunContext rctx) {
-        ReduceSumCPU(reduce);
-      }, Context::CPU(), const_vars, {reduce[0].var()},
-      FnProperty::kCPUPrioritized, priority);
+    NDArray merged = buf.merged;
+    Engine::Get()->PushSync([reduce, merged, this](RunContext rctx) {
+        ReduceSumCPU(reduce, merged);
+      }, Context::CPU(), const_vars, {merged.var()},
+      FnProperty::kCPUPrioritized, priority, "KVStoreReduce");
 
     return buf.merged;
   }
@@ -104,55 +127,17 @@ class CommCPU : public Comm {
   }
 
  private:
-  inline static void ReduceSumCPU(
-      const std::vector<real_t*> &dptr, size_t offset, index_t size) {
-    using namespace mshadow;  // NOLINT(*)
-    Tensor<cpu, 1> in_0(dptr[0] + offset, Shape1(size));
-    for (size_t i = 1; i < dptr.size(); i+=4) {
-      switch (dptr.size() - i) {
-        case 1: {
-          Tensor<cpu, 1> in_1(dptr[i] + offset, Shape1(size));
-          in_0 += in_1;
-          break;
-        }
-        case 2: {
-          Tensor<cpu, 1> in_1(dptr[i] + offset, Shape1(size));
-          Tensor<cpu, 1> in_2(dptr[i+1] + offset, Shape1(size));
-          in_0 += in_1 + in_2;
-          break;
-        }
-        case 3: {
-          Tensor<cpu, 1> in_1(dptr[i] + offset, Shape1(size));
-          Tensor<cpu, 1> in_2(dptr[i+1] + offset, Shape1(size));
-          Tensor<cpu, 1> in_3(dptr[i+2] + offset, Shape1(size));
-          in_0 += in_1 + in_2 + in_3;
-          break;
-        }
-        default: {
-          Tensor<cpu, 1> in_1(dptr[i] + offset, Shape1(size));
-          Tensor<cpu, 1> in_2(dptr[i+1] + offset, Shape1(size));
-          Tensor<cpu, 1> in_3(dptr[i+2] + offset, Shape1(size));
-          Tensor<cpu, 1> in_4(dptr[i+3] + offset, Shape1(size));
-          in_0 += in_1 + in_2 + in_3 + in_4;
-          break;
-        }
-      }
-    }
-  }
-  // reduce sum into val[0]
-  inline void ReduceSumCPU(const std::vector<NDArray> &in_data) {
+  /**
+   * \brief call f(begin, end) on the chunks of [0, total), in parallel if
+   * total is at least bigarray_bound_. a chunk is always handled by the same
+   * thread of the OpenMP pool
+   */
+  template<typename F>
+  inline void ParallelFor(size_t total, const F& f) {
     const size_t step = std::min(bigarray_bound_, static_cast<size_t>(4 << 10));
-    // ge ptr out
-    std::vector<real_t*> dptr(in_data.size());
-    for (size_t i = 0; i < in_data.size(); ++i) {
-      TBlob data = in_data[i].data();
-      CHECK(data.CheckContiguous());
-      dptr[i] = data.FlatTo2D<cpu, real_t>().dptr_;
-    }
-    size_t total = in_data[0].shape().Size();
     long ntask = (total + step - 1) / step; // NOLINT(*)
     if (total < bigarray_bound_ || nthread_reduction_ <= 1) {
-      ReduceSumCPU(dptr, 0, total);
+      f(0, total);
     } else {
       #pragma omp parallel for schedule(static) num_threads(nthread_reduction_)
       for (long j = 0; j < ntask; ++j) { // NOLINT(*)
@@ -160,10 +145,28 @@ class CommCPU : public Comm {
         size_t begin = std::min(k * step, total);
         size_t end = std::min((k + 1) * step, total);
         if (j == ntask - 1) CHECK_EQ(end, total);
-        ReduceSumCPU(dptr, begin, static_cast<index_t>(end - begin));
+        f(begin, end);
       }
     }
   }
+  // reduce sum of in_data into out, out may be in_data[0]
+  inline void ReduceSumCPU(const std::vector<NDArray> &in_data,
+                           const NDArray &out) {
+    // ge ptr out
+    std::vector<const real_t*> dptr(in_data.size());
+    for (size_t i = 0; i < in_data.size(); ++i) {
+      TBlob data = in_data[i].data();
+      CHECK(data.CheckContiguous());
+      dptr[i] = data.FlatTo2D<cpu, real_t>().dptr_;
+    }
+    real_t* optr = out.data().FlatTo2D<cpu, real_t>().dptr_;
+    size_t total = out.shape().Size();
+    // a big sum does not fit into the cache, write it around the cache
+    bool stream = total >= bigarray_bound_;
+    ParallelFor(total, [&dptr, optr, stream](size_t begin, size_t end) {
+        ReduceSum(dptr, optr, begin, end, stream);
+      });
+  }
   /// \brief temperal space for pushing and pull
   struct BufferEntry {
     /// \brief the merged value
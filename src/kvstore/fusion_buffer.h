@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2016 by Contributors
+ * @file   fusion_buffer.h
+ * @brief  batch the pushes or pulls of small arrays into one ps message
+ */
+#ifndef MXNET_KVSTORE_FUSION_BUFFER_H_
+#define MXNET_KVSTORE_FUSION_BUFFER_H_
+#include <dmlc/logging.h>
+#include <mxnet/base.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ps/ps.h"
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief fuses the pushes (or pulls) of small arrays into one ZPush (or
+ * ZPull). ps-lite sends the keys of a ZPush living on the same server in a
+ * single message, so a flush costs one message per server instead of one per
+ * array.
+ *
+ * The buffer is flushed once it holds \a capacity values, or by a background
+ * thread every \a cycle_us microseconds.
+ */
+class FusionBuffer {
+ public:
+  typedef std::function<void()> Callback;
+
+  FusionBuffer(ps::KVWorker<real_t>* worker, bool push,
+               size_t capacity, int cycle_us)
+      : worker_(CHECK_NOTNULL(worker)), push_(push), capacity_(capacity),
+        cycle_(cycle_us) {
+    thread_ = std::thread([this]() { Run(); });
+  }
+
+  /**
+   * \brief flush the pending arrays and stop the background thread
+   */
+  ~FusionBuffer() {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      stop_ = true;
+    }
+    cond_.notify_one();
+    thread_.join();
+  }
+
+  /**
+   * \brief add an array of \a len values on the ps key \a key. for push, \a
+   * data is read at flush. for pull, the pulled values are written into \a
+   * data. \a data must be valid until \a cb is called. threadsafe
+   */
+  void Add(ps::Key key, real_t* data, int len, const Callback& cb) {
+    std::vector<Item> items;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      items_.push_back(Item{key, data, len, cb});
+      size_ += len;
+      if (size_ < capacity_) return;
+      items.swap(items_);
+      size_ = 0;
+    }
+    Send(std::move(items));
+  }
+
+ private:
+  struct Item {
+    ps::Key key;
+    real_t* data;
+    int len;
+    Callback cb;
+  };
+
+  void Run() {
+    std::unique_lock<std::mutex> lk(mu_);
+    while (true) {
+      bool stop = stop_;
+      if (!stop) cond_.wait_for(lk, cycle_);
+      if (!items_.empty()) {
+        std::vector<Item> items;
+        items.swap(items_);
+        size_ = 0;
+        lk.unlock();
+        Send(std::move(items));
+        lk.lock();
+      }
+      if (stop) break;
+    }
+  }
+
+  /**
+   * \brief issue one ZPush or ZPull for \a items
+   */
+  void Send(std::vector<Item>&& pending) {
+    // ps-lite requires keys in increasing order
+    auto items = std::make_shared<std::vector<Item>>(std::move(pending));
+    std::stable_sort(items->begin(), items->end(),
+                     [](const Item& a, const Item& b) { return a.key < b.key; });
+    ps::SArray<ps::Key> keys;
+    ps::SArray<int> lens;
+    size_t total = 0;
+    for (const auto& item : *items) {
+      keys.push_back(item.key);
+      lens.push_back(item.len);
+      total += item.len;
+    }
+    if (push_) {
+      ps::SArray<real_t> vals(total);
+      size_t offset = 0;
+      for (const auto& item : *items) {
+        std::memcpy(vals.data() + offset, item.data, item.len * sizeof(real_t));
+        offset += item.len;
+      }
+      worker_->ZPush(keys, vals, lens, 0, [items]() {
+          for (const auto& item : *items) item.cb();
+        });
+    } else {
+      auto vals = new ps::SArray<real_t>(total);
+      auto recv_lens = new ps::SArray<int>();
+      worker_->ZPull(keys, vals, recv_lens, 0, [items, vals, recv_lens]() {
+          size_t offset = 0;
+          for (size_t i = 0; i < items->size(); ++i) {
+            const Item& item = (*items)[i];
+            CHECK_EQ((*recv_lens)[i], item.len);
+            std::memcpy(item.data, vals->data() + offset,
+                        item.len * sizeof(real_t));
+            offset += item.len;
+          }
+          delete vals;
+          delete recv_lens;
+          for (const auto& item : *items) item.cb();
+        });
+    }
+  }
+
+  ps::KVWorker<real_t>* worker_;
+  bool push_;
+  size_t capacity_;
+  std::chrono::microseconds cycle_;
+  std::mutex mu_;
+  std::condition_variable cond_;
+  /// \brief pending arrays, guarded by mu_
+  std::vector<Item> items_;
+  /// \brief number of pending values, guarded by mu_
+  size_t size_ = 0;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_FUSION_BUFFER_H_
@@ -0,0 +1,432 @@
+/**
+ * Copyright (c) 2016 by Contributors
+ * @file   gradient_compression.h
+ * @brief  lossy compression of the gradients pushed to servers
+ */
+#ifndef MXNET_KVSTORE_GRADIENT_COMPRESSION_H_
+#define MXNET_KVSTORE_GRADIENT_COMPRESSION_H_
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/base.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(__CUDACC__)
+#define MXNET_KVSTORE_F16C 1
+#include <immintrin.h>
+#else
+#define MXNET_KVSTORE_F16C 0
+#endif
+
+namespace mxnet {
+namespace kvstore {
+
+namespace compression {
+enum CompressionType {kNone, kTwoBit, kTopK, kFP16, kBF16};
+
+/**
+ * \brief the nearest half precision value of \a f, ties to even
+ */
+inline uint16_t FloatToHalf(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  uint32_t sign = (x >> 16) & 0x8000;
+  uint32_t abs = x & 0x7fffffff;
+  if (abs >= 0x7f800000) {
+    // inf or nan, which stays a nan
+    return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+  }
+  if (abs >= 0x477ff000) return sign | 0x7c00;  // overflows to inf
+  if (abs < 0x38800000) {
+    // a subnormal half, or zero
+    if (abs < 0x33000000) return sign;
+    uint32_t exp = abs >> 23;
+    uint32_t mant = (abs & 0x7fffff) | 0x800000;
+    uint32_t shift = 126 - exp;
+    uint32_t h = mant >> shift;
+    uint32_t rest = mant & ((1u << shift) - 1);
+    uint32_t half = 1u << (shift - 1);
+    if (rest > half || (rest == half && (h & 1))) ++h;
+    return sign | h;
+  }
+  uint32_t h = (abs - 0x38000000) >> 13;
+  uint32_t rest = abs & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (h & 1))) ++h;
+  return sign | h;
+}
+
+/**
+ * \brief the float of the half precision value \a h
+ */
+inline float HalfToFloat(uint16_t h) {
+  uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+  uint32_t exp = (h >> 10) & 0x1f;
+  uint32_t mant = h & 0x3ff;
+  uint32_t x;
+  if (exp == 0x1f) {
+    x = sign | 0x7f800000 | (mant << 13);
+  } else if (exp != 0) {
+    x = sign | ((exp + 112) << 23) | (mant << 13);
+  } else if (mant == 0) {
+    x = sign;
+  } else {
+    // normalize a subnormal
+    exp = 113;
+    while ((mant & 0x400) == 0) {
+      mant <<= 1;
+      --exp;
+    }
+    x = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+  }
+  float f;
+  std::memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+/**
+ * \brief the nearest bfloat16 value of \a f, ties to even
+ */
+inline uint16_t FloatToBF16(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  if ((x & 0x7fffffff) > 0x7f800000) return (x >> 16) | 0x40;  // nan
+  return (x + 0x7fff + ((x >> 16) & 1)) >> 16;
+}
+
+inline float BF16ToFloat(uint16_t h) {
+  uint32_t x = static_cast<uint32_t>(h) << 16;
+  float f;
+  std::memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+#if MXNET_KVSTORE_F16C
+__attribute__((target("avx,f16c")))
+inline size_t FloatToHalfF16C(const float* in, size_t n, uint16_t* out) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), h);
+  }
+  return i;
+}
+
+__attribute__((target("avx,f16c")))
+inline size_t HalfToFloatF16C(const uint16_t* in, size_t n, float* out) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+  }
+  return i;
+}
+
+__attribute__((target("avx,f16c")))
+inline size_t RoundToHalfF16C(const float* grad, float* residual, size_t n,
+                              uint16_t* out) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 r = _mm256_add_ps(_mm256_loadu_ps(residual + i), _mm256_loadu_ps(grad + i));
+    __m128i h = _mm256_cvtps_ph(r, _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), h);
+    _mm256_storeu_ps(residual + i, _mm256_sub_ps(r, _mm256_cvtph_ps(h)));
+  }
+  return i;
+}
+
+inline bool HasF16C() {
+  static const bool has = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  return has;
+}
+#endif  // MXNET_KVSTORE_F16C
+
+/**
+ * \brief convert \a n floats into half precision, by the f16c instructions
+ * if the cpu supports them
+ */
+inline void ToHalf(const float* in, size_t n, uint16_t* out) {
+  size_t i = 0;
+#if MXNET_KVSTORE_F16C
+  if (HasF16C()) i = FloatToHalfF16C(in, n, out);
+#endif  // MXNET_KVSTORE_F16C
+  for (; i < n; ++i) out[i] = FloatToHalf(in[i]);
+}
+
+inline void FromHalf(const uint16_t* in, size_t n, float* out) {
+  size_t i = 0;
+#if MXNET_KVSTORE_F16C
+  if (HasF16C()) i = HalfToFloatF16C(in, n, out);
+#endif  // MXNET_KVSTORE_F16C
+  for (; i < n; ++i) out[i] = HalfToFloat(in[i]);
+}
+
+/**
+ * \brief add \a grad to \a residual, round the sums into half precision
+ * \a out and leave the rounding errors in \a residual, in a single pass
+ */
+inline void RoundToHalf(const float* grad, float* residual, size_t n, uint16_t* out) {
+  size_t i = 0;
+#if MXNET_KVSTORE_F16C
+  if (HasF16C()) i = RoundToHalfF16C(grad, residual, n, out);
+#endif  // MXNET_KVSTORE_F16C
+  for (; i < n; ++i) {
+    float r = residual[i] + grad[i];
+    out[i] = FloatToHalf(r);
+    residual[i] = r - HalfToFloat(out[i]);
+  }
+}
+
+/**
+ * \brief as \ref RoundToHalf, into bfloat16
+ */
+inline void RoundToBF16(const float* grad, float* residual, size_t n, uint16_t* out) {
+  for (size_t i = 0; i < n; ++i) {
+    float r = residual[i] + grad[i];
+    out[i] = FloatToBF16(r);
+    residual[i] = r - BF16ToFloat(out[i]);
+  }
+}
+}  // namespace compression
+
+struct GradientCompressionParam
+    : public dmlc::Parameter<GradientCompressionParam> {
+  int type;
+  float threshold;
+  float ratio;
+  DMLC_DECLARE_PARAMETER(GradientCompressionParam) {
+    DMLC_DECLARE_FIELD(type)
+    .add_enum("none", compression::kNone)
+    .add_enum("2bit", compression::kTwoBit)
+    .add_enum("topk", compression::kTopK)
+    .add_enum("fp16", compression::kFP16)
+    .add_enum("bf16", compression::kBF16)
+    .set_default(compression::kNone)
+    .describe("The compression applied to pushed gradients.");
+    DMLC_DECLARE_FIELD(threshold).set_default(0.5f)
+    .set_lower_bound(0.0f)
+    .describe("For 2bit, an element is sent as +threshold or -threshold once "
+              "its accumulated magnitude reaches threshold, otherwise as 0.");
+    DMLC_DECLARE_FIELD(ratio).set_default(0.01f)
+    .set_range(0.0f, 1.0f)
+    .describe("For topk, the fraction of elements with the largest "
+              "accumulated magnitudes sent each push.");
+  }
+};
+
+/**
+ * \brief compresses gradients with error feedback.
+ *
+ * The part of a gradient not sent is kept in a residual buffer and added to
+ * the next gradient of the same key, so no update is lost but only delayed.
+ * Compressed data is stored in real_t slots so that it can be sent by the
+ * same ps-lite channel as uncompressed values.
+ *
+ * - 2bit: 16 elements are packed into each slot, every element takes 2 bits
+ *   meaning 0, +threshold or -threshold.
+ * - topk: k = ceil(ratio * n) (index, value) pairs, the index is stored as
+ *   the bits of an uint32_t.
+ * - fp16, bf16: every element is rounded to 16 bits, 2 per slot. The pulled
+ *   weights are sent in 16 bits too, while servers keep them in 32 bits.
+ */
+class GradientCompression {
+ public:
+  GradientCompression() {
+    param_.Init(std::vector<std::pair<std::string, std::string>>());
+  }
+
+  /**
+   * \brief set the parameters from key-value pairs
+   */
+  void SetParams(const std::vector<std::pair<std::string, std::string>>& kwargs) {
+    param_.Init(kwargs);
+  }
+
+  /**
+   * \brief encode the parameters into a string, decoded by \ref DecodeParams
+   */
+  std::string EncodeParams() const {
+    std::ostringstream os;
+    os.precision(9);
+    os << param_.type << " " << param_.threshold << " " << param_.ratio;
+    return os.str();
+  }
+
+  /**
+   * \brief set the parameters from a string returned by \ref EncodeParams
+   */
+  void DecodeParams(const std::string& str) {
+    std::istringstream is(str);
+    CHECK(is >> param_.type >> param_.threshold >> param_.ratio)
+        << "invalid compression parameters: " << str;
+  }
+
+  /**
+   * \return whether gradients are compressed
+   */
+  bool enabled() const { return param_.type != compression::kNone; }
+
+  /**
+   * \return whether pulled weights are compressed too, by \ref CompressWeights
+   */
+  bool compresses_pull() const {
+    return param_.type == compression::kFP16 || param_.type == compression::kBF16;
+  }
+
+  /**
+   * \return the number of slots needed to compress \a n elements
+   */
+  size_t CompressedSize(size_t n) const {
+    switch (param_.type) {
+      case compression::kTwoBit:
+        return (n + kPerSlot - 1) / kPerSlot;
+      case compression::kTopK:
+        return 2 * TopK(n);
+      case compression::kFP16:
+      case compression::kBF16:
+        return (n + 1) / 2;
+      default:
+        return n;
+    }
+  }
+
+  /**
+   * \brief add \a grad to \a residual, and compress the result into \a out
+   * of CompressedSize(n) slots. what is not sent remains in \a residual
+   */
+  void Compress(const real_t* grad, real_t* residual, size_t n,
+                real_t* out) const {
+    if (n == 0) return;
+    if (compresses_pull()) {
+      // the rounding error stays in the residual
+      if (n % 2 != 0) out[n / 2] = 0;
+      uint16_t* half = reinterpret_cast<uint16_t*>(out);
+      if (param_.type == compression::kFP16) {
+        compression::RoundToHalf(grad, residual, n, half);
+      } else {
+        compression::RoundToBF16(grad, residual, n, half);
+      }
+      return;
+    }
+    for (size_t i = 0; i < n; ++i) residual[i] += grad[i];
+    switch (param_.type) {
+      case compression::kTwoBit: {
+        const real_t t = param_.threshold;
+        for (size_t s = 0; s * kPerSlot < n; ++s) {
+          uint32_t bits = 0;
+          size_t end = std::min(n, (s + 1) * kPerSlot);
+          for (size_t i = s * kPerSlot; i < end; ++i) {
+            uint32_t code = 0;
+            if (residual[i] >= t) {
+              code = kPositive; residual[i] -= t;
+            } else if (residual[i] <= -t) {
+              code = kNegative; residual[i] += t;
+            }
+            bits |= code << (2 * (i - s * kPerSlot));
+          }
+          std::memcpy(out + s, &bits, sizeof(bits));
+        }
+        break;
+      }
+      case compression::kTopK: {
+        size_t k = TopK(n);
+        std::vector<uint32_t> idx(n);
+        std::iota(idx.begin(), idx.end(), 0);
+        std::nth_element(idx.begin(), idx.begin() + (k - 1), idx.end(),
+                         [residual](uint32_t a, uint32_t b) {
+                           return std::fabs(residual[a]) > std::fabs(residual[b]);
+                         });
+        for (size_t j = 0; j < k; ++j) {
+          std::memcpy(out + 2 * j, &idx[j], sizeof(uint32_t));
+          out[2 * j + 1] = residual[idx[j]];
+          residual[idx[j]] = 0;
+        }
+        break;
+      }
+      default:
+        std::copy(residual, residual + n, out);
+        std::fill(residual, residual + n, 0);
+    }
+  }
+
+  /**
+   * \brief compress \a n weights \a in into \a out of CompressedSize(n)
+   * slots, without a residual. only if \ref compresses_pull
+   */
+  void CompressWeights(const real_t* in, size_t n, real_t* out) const {
+    CHECK(compresses_pull());
+    // the last slot is padded by a zero
+    if (n % 2 != 0) out[n / 2] = 0;
+    uint16_t* half = reinterpret_cast<uint16_t*>(out);
+    if (param_.type == compression::kFP16) {
+      compression::ToHalf(in, n, half);
+    } else {
+      for (size_t i = 0; i < n; ++i) half[i] = compression::FloatToBF16(in[i]);
+    }
+  }
+
+  /**
+   * \brief decompress \a in of CompressedSize(n) slots into \a out of \a n
+   * elements
+   */
+  void Decompress(const real_t* in, size_t n, real_t* out) const {
+    switch (param_.type) {
+      case compression::kTwoBit: {
+        const real_t t = param_.threshold;
+        for (size_t s = 0; s * kPerSlot < n; ++s) {
+          uint32_t bits;
+          std::memcpy(&bits, in + s, sizeof(bits));
+          size_t end = std::min(n, (s + 1) * kPerSlot);
+          for (size_t i = s * kPerSlot; i < end; ++i, bits >>= 2) {
+            uint32_t code = bits & 3;
+            out[i] = code == kPositive ? t : (code == kNegative ? -t : 0);
+          }
+        }
+        break;
+      }
+      case compression::kTopK: {
+        std::fill(out, out + n, 0);
+        size_t k = TopK(n);
+        for (size_t j = 0; j < k; ++j) {
+          uint32_t i;
+          std::memcpy(&i, in + 2 * j, sizeof(i));
+          CHECK_LT(i, n);
+          out[i] = in[2 * j + 1];
+        }
+        break;
+      }
+      case compression::kFP16:
+        compression::FromHalf(reinterpret_cast<const uint16_t*>(in), n, out);
+        break;
+      case compression::kBF16: {
+        const uint16_t* half = reinterpret_cast<const uint16_t*>(in);
+        for (size_t i = 0; i < n; ++i) out[i] = compression::BF16ToFloat(half[i]);
+        break;
+      }
+      default:
+        std::copy(in, in + n, out);
+    }
+  }
+
+ private:
+  static const size_t kPerSlot = sizeof(real_t) * 4;
+  static const uint32_t kPositive = 1;
+  static const uint32_t kNegative = 2;
+
+  size_t TopK(size_t n) const {
+    size_t k = static_cast<size_t>(std::ceil(param_.ratio * n));
+    return std::min(n, std::max(k, static_cast<size_t>(1)));
+  }
+
+  GradientCompressionParam param_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_GRADIENT_COMPRESSION_H_
@@ -0,0 +1,317 @@
+/**
+ * Copyright (c) 2016 by Contributors
+ * @file   host_aggregation.h
+ * @brief  sum the gradients of the workers on a host through shared memory
+ */
+#ifndef MXNET_KVSTORE_HOST_AGGREGATION_H_
+#define MXNET_KVSTORE_HOST_AGGREGATION_H_
+#include <dmlc/logging.h>
+#include <mxnet/base.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "./reduce_sum.h"
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief aggregates the gradients of the workers running on the same host.
+ *
+ * The worker of the smallest rank on a host is its leader. The others put
+ * their gradients into shared memory instead of pushing them. The leader sums
+ * them with its own, pushes the sum, and puts what it pulls back into shared
+ * memory, where the others pull from. So a host sends and receives one copy
+ * of each key, no matter how many workers it runs.
+ *
+ * Every push on a key has a version, which counts the pushes of this worker
+ * on the key. All workers push every key equally often, as in sync mode, and
+ * a pull returns the result of a push of at least the version last pushed.
+ *
+ * Shared memory segments are named after \a job and unlinked once all
+ * workers have mapped them, so nothing is left behind when the job exits.
+ */
+class HostAggregation {
+ public:
+  typedef std::function<void()> Callback;
+
+  /**
+   * \brief meet the other workers of this host. \a barrier must block until
+   * all workers of the job called it
+   */
+  HostAggregation(const std::string& job, int rank, const Callback& barrier)
+      : job_(job) {
+    std::string name = SegmentName("host");
+    auto table = static_cast<HostTable*>(Map(name, sizeof(HostTable)));
+    int slot = table->num.fetch_add(1);
+    CHECK_LT(slot, kMaxLocal) << "too many workers on this host";
+    table->ranks[slot] = rank;
+    barrier();
+    std::vector<int> ranks(table->ranks, table->ranks + table->num.load());
+    munmap(table, sizeof(HostTable));
+    std::sort(ranks.begin(), ranks.end());
+    num_local_ = ranks.size();
+    local_rank_ = std::find(ranks.begin(), ranks.end(), rank) - ranks.begin();
+    if (is_leader()) shm_unlink(name.c_str());
+    thread_ = std::thread([this]() { Run(); });
+  }
+
+  ~HostAggregation() {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      stop_ = true;
+    }
+    cond_.notify_one();
+    thread_.join();
+    for (auto& it : keys_) munmap(it.second->header, it.second->bytes);
+  }
+
+  /**
+   * \return whether this worker pushes and pulls for its host
+   */
+  bool is_leader() const { return local_rank_ == 0; }
+
+  /**
+   * \return the number of workers on this host
+   */
+  int num_local() const { return num_local_; }
+
+  /**
+   * \brief map the shared memory of \a key of \a size values. all workers of
+   * the host call it with the same size before \ref Unlink
+   */
+  void InitKey(int key, size_t size) {
+    std::unique_ptr<Segment> seg(new Segment());
+    seg->size = size;
+    seg->bytes = sizeof(KeyHeader) + num_local_ * size * sizeof(real_t);
+    std::string name = SegmentName(std::to_string(key));
+    seg->header = static_cast<KeyHeader*>(Map(name, seg->bytes));
+    seg->result = reinterpret_cast<real_t*>(seg->header + 1);
+    std::lock_guard<std::mutex> lk(mu_);
+    CHECK(keys_.find(key) == keys_.end()) << "duplicate init of key " << key;
+    keys_[key] = std::move(seg);
+    unlinked_.push_back(name);
+  }
+
+  /**
+   * \brief unlink the segments mapped so far, once all workers of the host
+   * mapped them
+   */
+  void Unlink() {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (is_leader()) {
+      for (const auto& name : unlinked_) shm_unlink(name.c_str());
+    }
+    unlinked_.clear();
+  }
+
+  /**
+   * \brief put the \a version-th gradient \a src of \a key for the leader, by
+   * a worker other than the leader. \a cb is called once \a src is read
+   */
+  void Publish(int key, const real_t* src, int64_t version, const Callback& cb) {
+    Segment* seg = Find(key);
+    auto& header = *seg->header;
+    const int i = local_rank_;
+    real_t* slot = seg->Slot(i);
+    Submit([=, &header]() {
+        // the previous version is still summed by the leader
+        if (header.consumed[i].load(std::memory_order_acquire) < version - 1) {
+          return false;
+        }
+        std::memcpy(slot, src, seg->size * sizeof(real_t));
+        header.pushed[i].store(version, std::memory_order_release);
+        cb();
+        return true;
+      });
+  }
+
+  /**
+   * \brief add the \a version-th gradients of the other workers on \a key to
+   * \a dst, by the leader. \a cb is called once they are added
+   */
+  void Gather(int key, real_t* dst, int64_t version, const Callback& cb) {
+    Segment* seg = Find(key);
+    auto& header = *seg->header;
+    const int num = num_local_;
+    Submit([=, &header]() {
+        for (int i = 1; i < num; ++i) {
+          if (header.pushed[i].load(std::memory_order_acquire) < version) {
+            return false;
+          }
+        }
+        std::vector<const real_t*> in = {dst};
+        for (int i = 1; i < num; ++i) in.push_back(seg->Slot(i));
+        ReduceSum(in, dst, 0, seg->size, false);
+        for (int i = 1; i < num; ++i) {
+          header.consumed[i].store(version, std::memory_order_release);
+        }
+        cb();
+        return true;
+      });
+  }
+
+  /**
+   * \brief put the value \a src of \a key pulled after the \a version-th push
+   * for the other workers, by the leader. \a cb is called once \a src is read
+   */
+  void Share(int key, const real_t* src, int64_t version, const Callback& cb) {
+    Segment* seg = Find(key);
+    auto& header = *seg->header;
+    Submit([=, &header]() {
+        // a seqlock, the sequence is odd while the result is written
+        header.result_seq.store(2 * version - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(seg->result, src, seg->size * sizeof(real_t));
+        header.result_seq.store(2 * version, std::memory_order_release);
+        cb();
+        return true;
+      });
+  }
+
+  /**
+   * \brief copy the value of \a key shared after a push of at least \a
+   * version into \a dst, by a worker other than the leader. \a cb is called
+   * once it is copied
+   */
+  void Fetch(int key, real_t* dst, int64_t version, const Callback& cb) {
+    Segment* seg = Find(key);
+    auto& header = *seg->header;
+    Submit([=, &header]() {
+        int64_t seq = header.result_seq.load(std::memory_order_acquire);
+        if (seq % 2 != 0 || seq < 2 * version) return false;
+        std::memcpy(dst, seg->result, seg->size * sizeof(real_t));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // overwritten by a newer version meanwhile, read that one
+        if (header.result_seq.load(std::memory_order_relaxed) != seq) return false;
+        cb();
+        return true;
+      });
+  }
+
+ private:
+  static const int kMaxLocal = 64;
+
+  struct HostTable {
+    std::atomic<int> num;
+    int ranks[kMaxLocal];
+  };
+
+  struct alignas(64) KeyHeader {
+    /// \brief twice the version of the result, odd while it is written
+    std::atomic<int64_t> result_seq;
+    /// \brief the version of the gradient in each slot
+    std::atomic<int64_t> pushed[kMaxLocal];
+    /// \brief the version of each slot summed by the leader
+    std::atomic<int64_t> consumed[kMaxLocal];
+  };
+
+  /**
+   * \brief the shared memory of a key, the header followed by the result and
+   * a slot for every worker other than the leader
+   */
+  struct Segment {
+    KeyHeader* header;
+    real_t* result;
+    size_t size;
+    size_t bytes;
+    real_t* Slot(int i) { return result + i * size; }
+  };
+
+  /**
+   * \brief a task is run repeatedly until it returns true
+   */
+  typedef std::function<bool()> Task;
+
+  std::string SegmentName(const std::string& suffix) const {
+    return "/mxnet_" + job_ + "_" + suffix;
+  }
+
+  /// \brief map the segment \a name of \a bytes, created zero filled if new
+  static void* Map(const std::string& name, size_t bytes) {
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+    CHECK_GE(fd, 0) << "shm_open " << name << " failed: " << strerror(errno);
+    CHECK_EQ(ftruncate(fd, bytes), 0)
+        << "ftruncate " << name << " failed: " << strerror(errno);
+    void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    CHECK(ptr != MAP_FAILED) << "mmap " << name << " failed: " << strerror(errno);
+    close(fd);
+    return ptr;
+  }
+
+  Segment* Find(int key) {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = keys_.find(key);
+    CHECK(it != keys_.end()) << "key " << key << " has not been inited";
+    return it->second.get();
+  }
+
+  void Submit(Task&& task) {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      tasks_.push_back(std::move(task));
+    }
+    cond_.notify_one();
+  }
+
+  /**
+   * \brief run the tasks waiting for other processes. the waits happen here
+   * instead of in engine threads, so that an engine thread never blocks on
+   * another process which in turn waits for an operator queued behind it
+   */
+  void Run() {
+    std::list<Task> pending;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lk(mu_);
+        if (pending.empty()) {
+          cond_.wait(lk, [this]() { return stop_ || !tasks_.empty(); });
+        }
+        if (stop_ && pending.empty() && tasks_.empty()) break;
+        pending.splice(pending.end(), tasks_);
+      }
+      bool progress = false;
+      for (auto it = pending.begin(); it != pending.end(); ) {
+        if ((*it)()) {
+          it = pending.erase(it);
+          progress = true;
+        } else {
+          ++it;
+        }
+      }
+      if (!progress) std::this_thread::sleep_for(std::chrono::microseconds(20));
+    }
+  }
+
+  std::string job_;
+  int num_local_;
+  int local_rank_;
+  std::mutex mu_;
+  std::condition_variable cond_;
+  /// \brief guarded by mu_
+  std::unordered_map<int, std::unique_ptr<Segment>> keys_;
+  /// \brief names of the segments not unlinked yet, guarded by mu_
+  std::vector<std::string> unlinked_;
+  /// \brief tasks submitted, guarded by mu_
+  std::list<Task> tasks_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_HOST_AGGREGATION_H_
@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2016 by Contributors
+ * @file   key_placement.h
+ * @brief  assign keys to servers balancing the number of values per server
+ */
+#ifndef MXNET_KVSTORE_KEY_PLACEMENT_H_
+#define MXNET_KVSTORE_KEY_PLACEMENT_H_
+#include <dmlc/logging.h>
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief places keys on servers so that every server holds about the same
+ * number of values.
+ *
+ * Keys are placed from the largest to the smallest, each on the least loaded
+ * server (longest processing time first). A key with at least \a
+ * bigarray_bound values is split evenly over all servers instead, but only if
+ * placing it whole would load a server beyond both the current maximal load
+ * and the ideal one, and splitting lowers the maximal load.
+ *
+ * The plan only depends on the placed keys and sizes and their order, so all
+ * workers compute the same one.
+ */
+class KeyPlacement {
+ public:
+  /**
+   * \brief a consecutive part of a key
+   */
+  struct Part {
+    int server;
+    size_t size;
+  };
+
+  KeyPlacement(int num_servers, size_t bigarray_bound)
+      : bigarray_bound_(bigarray_bound), loads_(num_servers, 0) {
+    CHECK_GT(num_servers, 0);
+  }
+
+  /**
+   * \brief place \a keys of \a sizes values, given the keys placed before
+   */
+  void Place(const std::vector<int>& keys, const std::vector<size_t>& sizes) {
+    CHECK_EQ(keys.size(), sizes.size());
+    std::vector<size_t> order(keys.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return sizes[a] != sizes[b] ? sizes[a] > sizes[b] : keys[a] < keys[b];
+      });
+    size_t total = 0;
+    for (size_t load : loads_) total += load;
+    for (size_t size : sizes) total += size;
+    const size_t num_servers = loads_.size();
+    const size_t ideal = (total + num_servers - 1) / num_servers;
+
+    for (size_t i : order) {
+      CHECK(parts_.find(keys[i]) == parts_.end())
+          << "key " << keys[i] << " is placed twice";
+      size_t size = sizes[i];
+      auto& parts = parts_[keys[i]];
+      size_t least = std::min_element(loads_.begin(), loads_.end()) - loads_.begin();
+      size_t max_load = *std::max_element(loads_.begin(), loads_.end());
+      size_t whole_max = std::max(max_load, loads_[least] + size);
+      bool split = false;
+      if (size >= bigarray_bound_ && num_servers > 1 &&
+          whole_max > std::max(max_load, ideal)) {
+        size_t split_max = 0;
+        for (size_t s = 0; s < num_servers; ++s) {
+          split_max = std::max(split_max, loads_[s] + PartSize(size, s));
+        }
+        split = split_max < whole_max;
+      }
+      if (split) {
+        for (size_t s = 0; s < num_servers; ++s) {
+          parts.push_back(Part{static_cast<int>(s), PartSize(size, s)});
+          loads_[s] += parts.back().size;
+        }
+      } else {
+        parts.push_back(Part{static_cast<int>(least), size});
+        loads_[least] += size;
+      }
+    }
+  }
+
+  /**
+   * \return the parts of \a key ordered by server, or null if not placed
+   */
+  const std::vector<Part>* Find(int key) const {
+    auto it = parts_.find(key);
+    return it == parts_.end() ? nullptr : &it->second;
+  }
+
+  /**
+   * \return the number of values placed on each server
+   */
+  const std::vector<size_t>& loads() const { return loads_; }
+
+ private:
+  /**
+   * \brief the size of the \a s-th part when splitting \a size values evenly
+   */
+  size_t PartSize(size_t size, size_t s) const {
+    const double n = static_cast<double>(loads_.size());
+    return static_cast<size_t>(static_cast<double>(size) / n * (s + 1)) -
+        static_cast<size_t>(static_cast<double>(size) / n * s);
+  }
+
+  size_t bigarray_bound_;
+  std::vector<size_t> loads_;
+  std::unordered_map<int, std::vector<Part>> parts_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_KEY_PLACEMENT_H_
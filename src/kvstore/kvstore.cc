@@ -7,12 +7,21 @@
 #include <stdlib.h>
 #include <dmlc/logging.h>
 #include "./kvstore_local.h"
+#include "./gradient_compression.h"
+#include "./server_optimizer.h"
 // #include "./kvstore_device.h"
+#ifndef _WIN32
+#include "./kvstore_dist_allreduce.h"
+#endif  // _WIN32
 #if MXNET_USE_DIST_KVSTORE
 #include "./kvstore_dist.h"
 #endif  // MXNET_USE_DIST_KVSTORE
 
 namespace mxnet {
+namespace kvstore {
+DMLC_REGISTER_PARAMETER(GradientCompressionParam);
+DMLC_REGISTER_PARAMETER(ServerOptimizerParam);
+}  // namespace kvstore
 
 KVStore* KVStore::Create(const char *type_name) {
   std::string tname = type_name;
@@ -26,7 +35,14 @@ KVStore* KVStore::Create(const char *type_name) {
     use_device_comm = true;
   }
 
-  if (has("dist")) {
+  if (has("allreduce")) {
+#ifndef _WIN32
+    kv = new kvstore::KVStoreDistAllreduce(use_device_comm);
+#else
+    LOG(FATAL) << tname << " is not supported on windows";
+    return nullptr;
+#endif  // _WIN32
+  } else if (has("dist")) {
 #if MXNET_USE_DIST_KVSTORE
     kv = new kvstore::KVStoreDist(use_device_comm);
     //yegeyan 2016.10.6
@@ -35,8 +51,12 @@ KVStore* KVStore::Create(const char *type_name) {
       if (has("_sync"))
         kv->SendCommandToServers(kvstore::kSyncMode, "");
       // configure the server to be the sync by group mode
-      if (has("_gsync"))
-    	kv->SendCommandToServers(kvstore::kSyncByGroupMode, "");
+      // with the initial number of groups
+      if (has("_gsync")) {
+        int num_groups = dmlc::GetEnv("MXNET_KVSTORE_NUM_GROUPS", 2);
+        kv->SendCommandToServers(kvstore::kSyncByGroupMode,
+                                 std::to_string(num_groups));
+      }
       // configure the server to be the sync by stale mode
       if (has("_ssync"))
     	kv->SendCommandToServers(kvstore::kSyncByStaleMode, "");
@@ -5,12 +5,26 @@
  */
 #ifndef MXNET_KVSTORE_KVSTORE_DIST_H_
 #define MXNET_KVSTORE_KVSTORE_DIST_H_
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 #include "./kvstore_local.h"
 #include "mxnet/engine.h"
 #include "ps/ps.h"
 #include "./kvstore_dist_server.h"
+#include "./gradient_compression.h"
+#include "./server_optimizer.h"
+#include "./fusion_buffer.h"
+#include "./key_placement.h"
+#include "./host_aggregation.h"
+#include "./shm_transport.h"
+#include "./priority_sender.h"
+#include "./row_sparse.h"
 #include <typeinfo> //yegeyan 2016.11.1
 #include "../engine/threaded_engine.h" //yegeyan 2016.11.9
 namespace mxnet {
@@ -32,6 +46,12 @@ class KVStoreDist : public KVStoreLocal {
       : KVStoreLocal(use_device_comm), ps_worker_(nullptr), server_(nullptr) {
     if (IsWorkerNode()) {
       ps_worker_ = new ps::KVWorker<real_t>(0);
+      static_cast<ps::SimpleApp*>(ps_worker_)->set_response_handle(
+          [this](const ps::SimpleData& recved, ps::SimpleApp* app) {
+            if (recved.head != kWorkerTimes) return;
+            std::lock_guard<std::mutex> lk(mu_);
+            worker_times_.push_back(recved.body);
+          });
       ps::StartAsync("mxnet\0");
       if (!ps::Postoffice::Get()->is_recovery()) {
         ps::Postoffice::Get()->Barrier(
@@ -39,10 +59,38 @@ class KVStoreDist : public KVStoreLocal {
       }
     }
     bigarray_bound_ = dmlc::GetEnv("MXNET_KVSTORE_BIGARRAY_BOUND", 1000 * 1000);
+    // larger arrays are sent in slices, each a message of its own sent by
+    // priority. 0 means no slicing
+    slice_size_ = dmlc::GetEnv("MXNET_KVSTORE_SLICE_SIZE", 0);
+    if (IsWorkerNode() && slice_size_ > 0) {
+      size_t window = dmlc::GetEnv("MXNET_KVSTORE_SLICE_WINDOW", 4 * slice_size_);
+      sender_.reset(new PrioritySender(window));
+    }
+    // arrays smaller than it are fused, they must live on a single server
+    // under a single key, so neither split nor sliced
+    fusion_threshold_ = std::min<size_t>(
+        dmlc::GetEnv("MXNET_KVSTORE_FUSION_THRESHOLD", 0), bigarray_bound_);
+    if (slice_size_ > 0) {
+      fusion_threshold_ = std::min(fusion_threshold_, slice_size_ + 1);
+    }
+    if (IsWorkerNode() && fusion_threshold_ > 0) {
+      size_t capacity = dmlc::GetEnv("MXNET_KVSTORE_FUSION_BUFFER", 1 << 20);
+      int cycle_us = dmlc::GetEnv("MXNET_KVSTORE_FUSION_CYCLE_US", 1000);
+      push_fusion_.reset(new FusionBuffer(ps_worker_, true, capacity, cycle_us));
+      pull_fusion_.reset(new FusionBuffer(ps_worker_, false, capacity, cycle_us));
+    }
+    if (IsWorkerNode() && dmlc::GetEnv("MXNET_KVSTORE_SHM_TRANSPORT", false)) {
+      StartShmTransport();
+    }
   }
 
   virtual ~KVStoreDist() {
     Engine::Get()->WaitForAll();
+    push_fusion_.reset();
+    pull_fusion_.reset();
+    sender_.reset();
+    host_.reset();
+    shm_.reset();
     if (IsWorkerNode()) {
       if (barrier_before_exit_) {
         Barrier();
@@ -59,8 +107,44 @@ class KVStoreDist : public KVStoreLocal {
   void Init(const std::vector<int>& keys,
             const std::vector<NDArray>& values) override {
     CheckUnique(keys);
+    // the servers count the pushes of a host as one per worker only in sync
+    // mode
+    if (!host_ && dmlc::GetEnv("MXNET_KVSTORE_HOST_AGGREGATION", false) &&
+        type_.find("_sync") != std::string::npos &&
+        !ps::Postoffice::Get()->is_recovery()) {
+      StartHostAggregation();
+    }
+    std::vector<size_t> sizes;
     for (size_t i = 0; i < keys.size(); ++i) {
       comm_->Init(keys[i], values[i].shape());
+      sizes.push_back(values[i].shape().Size());
+      if (host_) host_->InitKey(keys[i], sizes.back());
+    }
+    if (ps::Postoffice::Get()->num_parameter_partition() < 0) {
+      // with the partition strategy, ps-lite places the raw keys itself
+      std::lock_guard<std::mutex> lk(mu_);
+      if (!placement_) {
+        placement_.reset(new KeyPlacement(
+            ps::Postoffice::Get()->GetServerKeyRanges().size(), bigarray_bound_));
+      }
+      if (slice_size_ == 0) {
+        placement_->Place(keys, sizes);
+      } else {
+        // sliced arrays are spread evenly over all servers instead
+        std::vector<int> placed_keys;
+        std::vector<size_t> placed_sizes;
+        for (size_t i = 0; i < keys.size(); ++i) {
+          if (sizes[i] > slice_size_) continue;
+          placed_keys.push_back(keys[i]);
+          placed_sizes.push_back(sizes[i]);
+        }
+        placement_->Place(placed_keys, placed_sizes);
+      }
+      if (get_rank() == 0) {
+        std::ostringstream os;
+        for (size_t load : placement_->loads()) os << " " << load;
+        LOG(INFO) << "number of values on each server:" << os.str();
+      }
     }
     if (get_rank() == 0) {
       Push_(keys, values, 0, false);
@@ -74,6 +158,8 @@ class KVStoreDist : public KVStoreLocal {
     if (!ps::Postoffice::Get()->is_recovery()) {
       Barrier();
     }
+    // all workers of the host have mapped the keys
+    if (host_) host_->Unlink();
   }
 
   void Push(const std::vector<int>& keys,
@@ -101,11 +187,46 @@ class KVStoreDist : public KVStoreLocal {
       real_t* data = static_cast<real_t*>(recv_buf.data().dptr_);
       size_t size = recv_buf.shape().Size();
 
-      auto pull_from_servers = [this, key, data, size](
+      // with host aggregation, the leader pulls for the host
+      int64_t version = host_ ? host_version_[key] : 0;
+      if (version > 0 && !host_->is_leader()) {
+        auto fetch_from_host = [this, key, data, version](
+            RunContext rctx, Engine::CallbackOnComplete cb) {
+          host_->Fetch(key, data, version, [cb]() { cb(); });
+        };
+        CHECK_NOTNULL(Engine::Get())->PushAsync(
+            fetch_from_host, pinned_ctx_, {}, {recv_buf.var()},
+            FnProperty::kNormal, priority, "KVStoreFetchFromHost");
+        comm_->Broadcast(key, recv_buf, grouped_vals[i], priority);
+        continue;
+      }
+
+      auto pull_from_servers = [this, key, data, size, priority](
           RunContext rctx, Engine::CallbackOnComplete cb) {
         // convert to ps keys
         PSKV& pskv = EncodeKey(key, size);
 
+        if (size < fusion_threshold_) {
+          CHECK_EQ(pskv.keys.size(), 1U);
+          pull_fusion_->Add(pskv.keys[0], data, size, [cb]() { cb(); });
+          return;
+        }
+
+        if (compression_.compresses_pull()) {
+          PullCompressed(key, data, size, [cb]() { cb(); });
+          return;
+        }
+
+        if (shm_ && HasLocalPart(pskv)) {
+          PullParts(pskv, data, [cb]() { cb(); });
+          return;
+        }
+
+        if (sender_) {
+          SendParts(pskv, data, false, priority, [cb]() { cb(); });
+          return;
+        }
+
         // issue pull, false means no delete
         auto vals = new ps::SArray<real_t>(data, size, false);
         CHECK_NOTNULL(ps_worker_)->ZPull(
@@ -117,12 +238,198 @@ class KVStoreDist : public KVStoreLocal {
           pinned_ctx_,
           {},
           {recv_buf.var()},
-          FnProperty::kNormal, priority);
+          FnProperty::kNormal, priority, "KVStorePull");
+
+      if (version > 0) {
+        auto share_with_host = [this, key, data, version](
+            RunContext rctx, Engine::CallbackOnComplete cb) {
+          host_->Share(key, data, version, [cb]() { cb(); });
+        };
+        CHECK_NOTNULL(Engine::Get())->PushAsync(
+            share_with_host, pinned_ctx_, {recv_buf.var()}, {},
+            FnProperty::kNormal, priority, "KVStoreShareWithHost");
+      }
 
       comm_->Broadcast(key, recv_buf, grouped_vals[i], priority);
     }
   }
 
+  void PushRowSparse(const std::vector<int>& keys,
+                     const std::vector<NDArray>& values,
+                     const std::vector<NDArray>& row_ids,
+                     int priority) override {
+    CHECK(!host_) << "row sparse push does not work with MXNET_KVSTORE_HOST_AGGREGATION";
+    std::vector<int> uniq_keys;
+    std::vector<std::vector<RowSparse> > grouped_vals;
+    GroupKVPairs(keys, Zip(values, row_ids), &uniq_keys, &grouped_vals);
+
+    // small arrays are fused, so they are pushed whole
+    std::vector<int> dense_keys;
+    std::vector<NDArray> dense_vals, dense_ids;
+    for (size_t i = 0; i < uniq_keys.size(); ++i) {
+      int key = uniq_keys[i];
+      auto vals = grouped_vals[i];
+      size_t size = vals[0].value.shape().Size();
+      if (size < fusion_threshold_) {
+        for (const auto& v : vals) {
+          dense_keys.push_back(key);
+          dense_vals.push_back(v.value);
+          dense_ids.push_back(v.row_ids);
+        }
+        continue;
+      }
+      std::vector<Engine::VarHandle> const_vars;
+      for (auto& v : vals) {
+        CHECK_EQ(v.value.ctx().dev_mask(), cpu::kDevMask)
+            << "row sparse push of key " << key << " takes values on cpu";
+        if (v.row_ids.ctx().dev_mask() != cpu::kDevMask) {
+          v.row_ids = v.row_ids.Copy(pinned_ctx_);
+        }
+        const_vars.push_back(v.value.var());
+        const_vars.push_back(v.row_ids.var());
+      }
+      auto push_to_servers = [this, key, vals, size](
+          RunContext rctx, Engine::CallbackOnComplete cb) {
+        PSKV& pskv = EncodeKey(key, size);
+        size_t width = size / vals[0].value.shape()[0];
+        std::vector<std::vector<size_t> > own;
+        std::vector<size_t> rows = MeantRows(vals, &own);
+        // the values of the rows one after another, summed over the values
+        std::vector<real_t> summed(rows.size() * width, 0);
+        for (size_t i = 0; i < vals.size(); ++i) {
+          const real_t* src = static_cast<const real_t*>(vals[i].value.data().dptr_);
+          for (size_t r : own[i]) {
+            real_t* dst = summed.data() + RowIndex(rows, r) * width;
+            for (size_t k = 0; k < width; ++k) dst[k] += src[r * width + k];
+          }
+        }
+        // every part is sent, even without rows, since the servers count the
+        // pushes in sync mode
+        auto ranges = PartRanges(pskv, rows, width);
+        ps::SArray<int> lens(ranges.size());
+        size_t total = 0;
+        for (size_t i = 0; i < ranges.size(); ++i) {
+          lens[i] = RangesHeaderSize(ranges[i]) + RangesSize(ranges[i]);
+          total += lens[i];
+        }
+        ps::SArray<real_t> msg(total);
+        real_t* out = msg.data();
+        const real_t* in = summed.data();
+        for (const auto& part : ranges) {
+          EncodeRanges(part, out);
+          out += RangesHeaderSize(part);
+          size_t n = RangesSize(part);
+          std::memcpy(out, in, n * sizeof(real_t));
+          out += n;
+          in += n;
+        }
+        CHECK_NOTNULL(ps_worker_)->ZPush(
+            pskv.keys, msg, lens, kRowSparsePush, [cb]() { cb(); });
+      };
+      // the pushes and pulls of this key are serialized by its buffer, which
+      // is never allocated by them
+      auto& buf = comm_buf_[key];
+      if (buf.is_none()) buf = NDArray(vals[0].value.shape(), pinned_ctx_, true);
+      Engine::Get()->PushAsync(
+          push_to_servers, pinned_ctx_, const_vars, {buf.var()},
+          FnProperty::kNormal, priority, "KVStorePushRowSparse");
+    }
+    if (!dense_keys.empty()) {
+      KVStoreLocal::PushRowSparse(dense_keys, dense_vals, dense_ids, priority);
+    }
+  }
+
+  void PullRowSparse(const std::vector<int>& keys,
+                     const std::vector<NDArray*>& values,
+                     const std::vector<NDArray>& row_ids,
+                     int priority) override {
+    std::vector<NDArray> outs;
+    for (auto v : values) outs.push_back(*v);
+    std::vector<int> uniq_keys;
+    std::vector<std::vector<RowSparse> > grouped_vals;
+    GroupKVPairs(keys, Zip(outs, row_ids), &uniq_keys, &grouped_vals);
+
+    for (size_t i = 0; i < uniq_keys.size(); ++i) {
+      int key = uniq_keys[i];
+      auto vals = grouped_vals[i];
+      size_t size = vals[0].value.shape().Size();
+      if (size < fusion_threshold_) {
+        // small arrays are fused, so they are pulled whole
+        for (auto& v : vals) {
+          NDArray whole(v.value.shape(), pinned_ctx_);
+          Pull({key}, {&whole}, priority);
+          CopyRows(whole, v.row_ids, &v.value, false, priority);
+        }
+        continue;
+      }
+      std::vector<Engine::VarHandle> const_vars, mutable_vars;
+      for (auto& v : vals) {
+        CHECK_EQ(v.value.ctx().dev_mask(), cpu::kDevMask)
+            << "row sparse pull of key " << key << " takes values on cpu";
+        if (v.row_ids.ctx().dev_mask() != cpu::kDevMask) {
+          v.row_ids = v.row_ids.Copy(pinned_ctx_);
+        }
+        const_vars.push_back(v.row_ids.var());
+        mutable_vars.push_back(v.value.var());
+      }
+      auto pull_from_servers = [this, key, vals, size](
+          RunContext rctx, Engine::CallbackOnComplete cb) {
+        PSKV& pskv = EncodeKey(key, size);
+        size_t width = size / vals[0].value.shape()[0];
+        auto own = std::make_shared<std::vector<std::vector<size_t> > >();
+        auto rows = std::make_shared<std::vector<size_t> >(MeantRows(vals, own.get()));
+        // the servers are told the ranges of their parts first, and then
+        // answer the pull by their values. parts without rows are skipped
+        auto ranges = PartRanges(pskv, *rows, width);
+        ps::SArray<ps::Key> keys;
+        ps::SArray<int> lens;
+        size_t total = 0;
+        for (size_t i = 0; i < ranges.size(); ++i) {
+          if (ranges[i].empty()) continue;
+          keys.push_back(pskv.keys[i]);
+          lens.push_back(RangesHeaderSize(ranges[i]));
+          total += lens.back();
+        }
+        if (keys.empty()) {
+          cb();
+          return;
+        }
+        ps::SArray<real_t> header(total);
+        real_t* out = header.data();
+        for (const auto& part : ranges) {
+          if (part.empty()) continue;
+          EncodeRanges(part, out);
+          out += RangesHeaderSize(part);
+        }
+        CHECK_NOTNULL(ps_worker_)->ZPush(
+            keys, header, lens, kRowSparsePullRows,
+            [this, keys, vals, width, rows, own, cb]() {
+              auto recv = new ps::SArray<real_t>();
+              ps_worker_->ZPull(keys, recv, nullptr, kRowSparsePull,
+                                [recv, vals, width, rows, own, cb]() {
+                  CHECK_EQ(recv->size(), rows->size() * width);
+                  for (size_t i = 0; i < vals.size(); ++i) {
+                    real_t* dst = static_cast<real_t*>(vals[i].value.data().dptr_);
+                    for (size_t r : (*own)[i]) {
+                      std::memcpy(dst + r * width,
+                                  recv->data() + RowIndex(*rows, r) * width,
+                                  width * sizeof(real_t));
+                    }
+                  }
+                  delete recv;
+                  cb();
+                });
+            });
+      };
+      auto& buf = comm_buf_[key];
+      if (buf.is_none()) buf = NDArray(vals[0].value.shape(), pinned_ctx_, true);
+      mutable_vars.push_back(buf.var());
+      Engine::Get()->PushAsync(
+          pull_from_servers, pinned_ctx_, const_vars, mutable_vars,
+          FnProperty::kNormal, priority, "KVStorePullRowSparse");
+    }
+  }
+
   void set_updater(const Updater& updater) override {
     CHECK(updater) << "invalid updater";
     if (IsServerNode()) {
@@ -136,6 +443,53 @@ class KVStoreDist : public KVStoreLocal {
     ps::Postoffice::Get()->Barrier(ps::kWorkerGroup);
   }
 
+  void WaitForClock(int clock) override {
+    // every server replies once all workers reached the clock on its keys
+    // with the number of iterations this worker finished, one per call, from
+    // which a restored server recovers the clock of this worker
+    SendCommandToServers(kWaitForClock, std::to_string(clock) + " " +
+                         std::to_string(num_clock_waits_++));
+  }
+
+  void RegroupWorkers() override {
+    if (type_.find("_gsync") == std::string::npos) return;
+    // the plan is made here from the times measured by all servers, and sent
+    // to them all, so that they agree on the groups
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      worker_times_.clear();
+    }
+    SendCommandToServers(kWorkerTimes, "");
+    std::vector<std::string> times;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      times.swap(worker_times_);
+    }
+    std::string plan = WorkerGrouping::NextPlan(times);
+    if (!plan.empty()) SendCommandToServers(kRegroupWorkers, plan);
+  }
+
+  void SetGradientCompression(
+      const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    compression_.SetParams(kwargs);
+    if (get_rank() == 0) {
+      SendCommandToServers(kSetGradientCompression, compression_.EncodeParams());
+    }
+    // no worker pushes compressed data before the servers know how to
+    // decompress it
+    Barrier();
+  }
+
+  void SetServerOptimizer(
+      const std::string& name,
+      const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    if (get_rank() == 0) {
+      SendCommandToServers(kSetOptimizer, ServerOptimizer::Encode(name, kwargs));
+    }
+    // no gradient is pushed before the servers have the optimizer
+    Barrier();
+  }
+
 
   void SendCommandToServers(int cmd_id,
                             const std::string& cmd_body) override {
@@ -143,6 +497,32 @@ class KVStoreDist : public KVStoreLocal {
     ps_worker_->Wait(ps_worker_->Request(cmd_id, cmd_body, ps::kServerGroup));
   }
 
+  std::vector<std::pair<int, int> > GetKeyPlacement(int key) override {
+    std::vector<std::pair<int, int> > placement;
+    std::lock_guard<std::mutex> lk(mu_);
+    const auto* parts = placement_ ? placement_->Find(key) : nullptr;
+    if (parts != nullptr) {
+      for (const auto& part : *parts) {
+        placement.emplace_back(part.server, static_cast<int>(part.size));
+      }
+      return placement;
+    }
+    // not placed at init, but may be encoded by the heuristic already
+    auto it = ps_kv_.find(key);
+    if (it == ps_kv_.end() || it->second.keys.empty()) return placement;
+    auto krs = ps::Postoffice::Get()->GetServerKeyRanges();
+    const PSKV& pskv = it->second;
+    for (size_t i = 0; i < pskv.keys.size(); ++i) {
+      int server = 0;
+      while (server + 1 < static_cast<int>(krs.size()) &&
+             pskv.keys[i] >= krs[server].end()) {
+        ++server;
+      }
+      placement.emplace_back(server, pskv.lens[i]);
+    }
+    return placement;
+  }
+
   int get_group_size() const override { return ps::NumWorkers(); }
 
   int get_rank() const override { return ps::MyRank(); }
@@ -195,7 +575,15 @@ class KVStoreDist : public KVStoreLocal {
       NDArray merged = do_merge ? comm_->Reduce(key, vals, priority) : vals[0];
 
       auto& send_buf = comm_buf_[key];
-      if (merged.ctx().dev_mask() == cpu::kDevMask) {
+      size_t size = merged.shape().Size();
+      if (do_merge && host_) {
+        int64_t version = ++host_version_[key];
+        if (!host_->is_leader()) {
+          PublishToHost(key, merged, version, priority);
+          continue;
+        }
+        send_buf = GatherOnHost(key, merged, version, priority);
+      } else if (merged.ctx().dev_mask() == cpu::kDevMask) {
         send_buf = merged;  // avoid memory copy
       } else {
         if (send_buf.is_none()) {
@@ -204,14 +592,38 @@ class KVStoreDist : public KVStoreLocal {
         CopyFromTo(merged, &send_buf);
       }
 
+      // initialization is never compressed, and small arrays are fused
+      // instead
+      if (do_merge && compression_.enabled() && size >= fusion_threshold_) {
+        PushCompressed(key, send_buf, priority);
+        continue;
+      }
+
       // push to servers
-      size_t size = send_buf.shape().Size();
       real_t* data = static_cast<real_t*>(send_buf.data().dptr_);
       auto push_to_servers =
-          [this, key, data, size](RunContext rctx, Engine::CallbackOnComplete cb) {
+          [this, key, data, size, do_merge, priority](
+              RunContext rctx, Engine::CallbackOnComplete cb) {
          // convert to ps keys
         PSKV& pskv = EncodeKey(key, size);
 
+        // init is waited for right away, fusing it only adds the flush delay
+        if (do_merge && size < fusion_threshold_) {
+          CHECK_EQ(pskv.keys.size(), 1U);
+          push_fusion_->Add(pskv.keys[0], data, size, [cb]() { cb(); });
+          return;
+        }
+
+        if (shm_ && HasLocalPart(pskv)) {
+          PushParts(pskv, data, [cb]() { cb(); });
+          return;
+        }
+
+        if (sender_) {
+          SendParts(pskv, data, true, priority, [cb]() { cb(); });
+          return;
+        }
+
         // do push. false means no delete
         ps::SArray<real_t> vals(data, size, false);
         CHECK_NOTNULL(ps_worker_)->ZPush(
@@ -226,8 +638,158 @@ class KVStoreDist : public KVStoreLocal {
           pinned_ctx_,
           {send_buf.var()},
           {},
-          FnProperty::kNormal, priority);
+          FnProperty::kNormal, priority, "KVStorePush");
+    }
+  }
+
+  /**
+   * \brief compress \a send_buf and push it to servers. the part for each
+   * server is compressed separately so that a server decompresses its part
+   * alone
+   */
+  void PushCompressed(int key, const NDArray& send_buf, int priority) {
+    size_t size = send_buf.shape().Size();
+    auto& residual = residual_buf_[key];
+    auto& compr_buf = compr_buf_[key];
+    if (residual.is_none()) {
+      residual = NDArray(send_buf.shape(), pinned_ctx_);
+      residual = 0;
+      size_t compr_size = EncodeCompressedKey(key, size).size;
+      compr_buf = NDArray(TShape(&compr_size, &compr_size + 1), pinned_ctx_);
     }
+    real_t* grad = static_cast<real_t*>(send_buf.data().dptr_);
+    real_t* res = static_cast<real_t*>(residual.data().dptr_);
+    real_t* data = static_cast<real_t*>(compr_buf.data().dptr_);
+    auto push_to_servers =
+        [this, key, grad, res, data, size](RunContext rctx,
+                                           Engine::CallbackOnComplete cb) {
+      PSKV& pskv = EncodeKey(key, size);
+      PSKV& compr_pskv = EncodeCompressedKey(key, size);
+      size_t offset = 0, compr_offset = 0;
+      for (size_t i = 0; i < pskv.lens.size(); ++i) {
+        compression_.Compress(grad + offset, res + offset, pskv.lens[i],
+                              data + compr_offset);
+        offset += pskv.lens[i];
+        compr_offset += compr_pskv.lens[i];
+      }
+      ps::SArray<real_t> vals(data, compr_pskv.size, false);
+      CHECK_NOTNULL(ps_worker_)->ZPush(
+          compr_pskv.keys, vals, compr_pskv.lens, kCompressedPush,
+          [cb]() { cb(); });
+    };
+    // the residual and the compressed buffer are written, which also
+    // serializes the pushes on this key
+    Engine::Get()->PushAsync(
+        push_to_servers,
+        pinned_ctx_,
+        {send_buf.var()},
+        {residual.var(), compr_buf.var()},
+        FnProperty::kNormal, priority, "KVStoreCompressedPush");
+  }
+
+  /**
+   * \brief meet the other workers of this host. the leader tells the servers
+   * how many workers its pushes stand for
+   */
+  void StartHostAggregation() {
+    host_.reset(new HostAggregation(ShmJobName(), get_rank(),
+                                    [this]() { Barrier(); }));
+    if (host_->is_leader()) {
+      SendCommandToServers(kSetHostWorkers, std::to_string(host_->num_local()));
+      LOG(INFO) << "worker " << get_rank() << " pushes for "
+                << host_->num_local() << " workers on its host";
+    }
+    Barrier();
+  }
+
+  /**
+   * \brief find the servers on this host by a handshake
+   */
+  void StartShmTransport() {
+    shm_.reset(new ShmTransport(ShmJobName()));
+    uint64_t nonce = shm_->CreateMarker(get_rank());
+    SendCommandToServers(kShmHello,
+                         std::to_string(get_rank()) + " " + std::to_string(nonce));
+    local_servers_ = shm_->RemoveMarker(
+        ps::Postoffice::Get()->GetServerKeyRanges().size());
+    if (std::find(local_servers_.begin(), local_servers_.end(), true) ==
+        local_servers_.end()) {
+      shm_.reset();
+    }
+  }
+
+  /**
+   * \brief push \a data to or pull it from the servers by \a pskv, a message
+   * per part, queued with \a priority. \a cb is called once all are done
+   */
+  void SendParts(const PSKV& pskv, real_t* data, bool push, int priority,
+                 const std::function<void()>& cb) {
+    auto remaining = std::make_shared<std::atomic<int>>(pskv.keys.size());
+    size_t offset = 0;
+    for (size_t i = 0; i < pskv.keys.size(); ++i) {
+      ps::SArray<ps::Key> keys = {pskv.keys[i]};
+      int len = pskv.lens[i];
+      real_t* part = data + offset;
+      offset += len;
+      sender_->Add(priority, len, [this, keys, len, part, push, remaining, cb](
+          const PrioritySender::Callback& sent) {
+          auto done = [sent, remaining, cb]() {
+            sent();
+            if (--*remaining == 0) cb();
+          };
+          if (push) {
+            ps::SArray<real_t> vals(part, len, false);
+            ps_worker_->ZPush(keys, vals, ps::SArray<int>({len}), 0, done);
+          } else {
+            auto vals = new ps::SArray<real_t>(part, len, false);
+            ps_worker_->ZPull(keys, vals, nullptr, 0, [vals, done]() {
+                delete vals;
+                done();
+              });
+          }
+        });
+    }
+  }
+
+  /**
+   * \brief put the gradient \a merged of \a key for the leader of the host,
+   * instead of pushing it
+   */
+  void PublishToHost(int key, const NDArray& merged, int64_t version,
+                     int priority) {
+    NDArray src = merged;
+    if (merged.ctx().dev_mask() != cpu::kDevMask) {
+      auto& buf = host_buf_[key];
+      if (buf.is_none()) buf = NDArray(merged.shape(), pinned_ctx_);
+      CopyFromTo(merged, &buf);
+      src = buf;
+    }
+    auto publish = [this, key, src, version](RunContext rctx,
+                                              Engine::CallbackOnComplete cb) {
+      host_->Publish(key, static_cast<const real_t*>(src.data().dptr_),
+                     version, [cb]() { cb(); });
+    };
+    Engine::Get()->PushAsync(publish, pinned_ctx_, {src.var()}, {},
+                             FnProperty::kNormal, priority, "KVStorePublishToHost");
+  }
+
+  /**
+   * \brief return the sum of the gradient \a merged of \a key and those of
+   * the other workers on the host, by the leader
+   */
+  NDArray GatherOnHost(int key, const NDArray& merged, int64_t version,
+                       int priority) {
+    auto& buf = host_buf_[key];
+    if (buf.is_none()) buf = NDArray(merged.shape(), pinned_ctx_);
+    CopyFromTo(merged, &buf);
+    auto gather = [this, key, buf, version](RunContext rctx,
+                                            Engine::CallbackOnComplete cb) {
+      host_->Gather(key, static_cast<real_t*>(buf.data().dptr_),
+                    version, [cb]() { cb(); });
+    };
+    Engine::Get()->PushAsync(gather, pinned_ctx_, {}, {buf.var()},
+                             FnProperty::kNormal, priority, "KVStoreGatherOnHost");
+    return buf;
   }
 
   /**
@@ -249,6 +811,66 @@ class KVStoreDist : public KVStoreLocal {
     int size;
   };
 
+  /**
+   * \brief a value of a row sparse push or pull, and the ids of its rows
+   */
+  struct RowSparse {
+    NDArray value;
+    NDArray row_ids;
+  };
+
+  static std::vector<RowSparse> Zip(const std::vector<NDArray>& values,
+                                    const std::vector<NDArray>& row_ids) {
+    CHECK_EQ(values.size(), row_ids.size());
+    std::vector<RowSparse> zipped(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+      zipped[i].value = values[i];
+      zipped[i].row_ids = row_ids[i];
+    }
+    return zipped;
+  }
+
+  /**
+   * \brief the sorted distinct rows meant by any of \a vals, and in \a own
+   * those meant by each of them
+   */
+  static std::vector<size_t> MeantRows(const std::vector<RowSparse>& vals,
+                                       std::vector<std::vector<size_t> >* own) {
+    std::vector<size_t> rows;
+    own->resize(vals.size());
+    for (size_t i = 0; i < vals.size(); ++i) {
+      const NDArray& ids = vals[i].row_ids;
+      (*own)[i] = UniqueRows(static_cast<const real_t*>(ids.data().dptr_),
+                             ids.shape().Size(), vals[i].value.shape()[0]);
+      rows.insert(rows.end(), (*own)[i].begin(), (*own)[i].end());
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    return rows;
+  }
+
+  /**
+   * \brief the position of \a row in the sorted \a rows
+   */
+  static size_t RowIndex(const std::vector<size_t>& rows, size_t row) {
+    return std::lower_bound(rows.begin(), rows.end(), row) - rows.begin();
+  }
+
+  /**
+   * \brief the ranges of \a rows of \a width values in each part of \a pskv,
+   * from the start of the part
+   */
+  static std::vector<std::vector<Range> > PartRanges(
+      const PSKV& pskv, const std::vector<size_t>& rows, size_t width) {
+    std::vector<std::vector<Range> > ranges;
+    size_t begin = 0;
+    for (int len : pskv.lens) {
+      ranges.push_back(RowRanges(rows, width, begin, begin + len));
+      begin += len;
+    }
+    return ranges;
+  }
+
   /**
    * \brief cache all key partitions
    */
@@ -263,8 +885,12 @@ class KVStoreDist : public KVStoreLocal {
    * \brief convert to keys in ps
    */
   inline PSKV& EncodeKey(int key, size_t size) {
+    std::vector<KeyPlacement::Part> parts;
     mu_.lock();
     PSKV& pskv = ps_kv_[key];
+    if (pskv.keys.empty() && placement_ && placement_->Find(key)) {
+      parts = *placement_->Find(key);
+    }
     mu_.unlock();
 
     int parameter_partition_num = ps::Postoffice::Get()->num_parameter_partition(); //yegeyan 2016.12.9
@@ -282,6 +908,36 @@ class KVStoreDist : public KVStoreLocal {
           pskv.lens.push_back(size);
           pskv.size = size;
       }
+      else if (slice_size_ > 0 && size > slice_size_) {
+          // slices of about slice_size_ values, spread evenly over all
+          // servers. the ps keys increase with the offsets, as ps-lite
+          // requires for a message with several keys
+          size_t num_slices = std::min<size_t>(
+              (size + slice_size_ - 1) / slice_size_, kMaxSlices);
+          pskv.size = 0;
+          for (size_t i = 0; i < num_slices; ++i) {
+            int server = i * num_servers / num_slices;
+            size_t len = size * (i + 1) / num_slices - size * i / num_slices;
+            ps::Key ps_key = krs[server].begin() + SliceKey(key, i);
+            CHECK_LT(ps_key, krs[server].end());
+            pskv.keys.push_back(ps_key);
+            pskv.lens.push_back(len);
+            pskv.size += len;
+          }
+          CHECK_EQ(static_cast<size_t>(pskv.size), size);
+      }
+      else if (!parts.empty()) {
+          // placed at init
+          pskv.size = 0;
+          for (const auto& part : parts) {
+            ps::Key ps_key = krs[part.server].begin() + key;
+            CHECK_LT(ps_key, krs[part.server].end());
+            pskv.keys.push_back(ps_key);
+            pskv.lens.push_back(part.size);
+            pskv.size += part.size;
+          }
+          CHECK_EQ(static_cast<size_t>(pskv.size), size);
+      }
       else {
           // a simple heuristic for load balance
           if (size < bigarray_bound_) {
@@ -312,6 +968,187 @@ class KVStoreDist : public KVStoreLocal {
     return pskv;
   }
 
+  /**
+   * \brief pull \a key into \a data of \a size values compressed by the
+   * servers, and call \a cb once decompressed. the part of each server is
+   * compressed separately, as for \ref PushCompressed
+   */
+  void PullCompressed(int key, real_t* data, size_t size,
+                      const std::function<void()>& cb) {
+    PSKV& pskv = EncodeKey(key, size);
+    PSKV& compr_pskv = EncodeCompressedKey(key, size);
+    auto vals = new ps::SArray<real_t>(compr_pskv.size);
+    CHECK_NOTNULL(ps_worker_)->ZPull(
+        compr_pskv.keys, vals, &compr_pskv.lens, kCompressedPull,
+        [this, &pskv, &compr_pskv, vals, data, cb]() {
+          size_t offset = 0, compr_offset = 0;
+          for (size_t i = 0; i < pskv.lens.size(); ++i) {
+            compression_.Decompress(vals->data() + compr_offset, pskv.lens[i],
+                                    data + offset);
+            offset += pskv.lens[i];
+            compr_offset += compr_pskv.lens[i];
+          }
+          delete vals;
+          cb();
+        });
+  }
+
+  /**
+   * \brief the ps keys of \a key with the lengths of the compressed parts
+   */
+  inline PSKV& EncodeCompressedKey(int key, size_t size) {
+    PSKV& pskv = EncodeKey(key, size);
+    std::lock_guard<std::mutex> lk(mu_);
+    PSKV& compr_pskv = compr_ps_kv_[key];
+    if (compr_pskv.keys.empty()) {
+      compr_pskv.size = 0;
+      for (int len : pskv.lens) {
+        int compr_len = compression_.CompressedSize(len);
+        compr_pskv.lens.push_back(compr_len);
+        compr_pskv.size += compr_len;
+      }
+      compr_pskv.keys = pskv.keys;
+    }
+    return compr_pskv;
+  }
+
+  /**
+   * \brief the rank of the server holding ps key \a key
+   */
+  int ServerOf(ps::Key key) const {
+    const auto& krs = ps::Postoffice::Get()->GetServerKeyRanges();
+    int server = 0;
+    while (server + 1 < static_cast<int>(krs.size()) &&
+           key >= krs[server].end()) {
+      ++server;
+    }
+    return server;
+  }
+
+  /**
+   * \brief whether a part of \a pskv is on a server of this host
+   */
+  bool HasLocalPart(const PSKV& pskv) const {
+    for (ps::Key key : pskv.keys) {
+      if (local_servers_[ServerOf(key)]) return true;
+    }
+    return false;
+  }
+
+  /**
+   * \brief the parts of a ps key list, split into those sent over the
+   * network and those through shared memory
+   */
+  struct SplitPSKV {
+    ps::SArray<ps::Key> net_keys, shm_keys;
+    ps::SArray<int> net_lens, shm_lens;
+    /// \brief the offset and length of each part in the values
+    std::vector<std::pair<size_t, int>> net_parts, shm_parts;
+    size_t net_size = 0;
+  };
+
+  SplitPSKV Split(const PSKV& pskv) const {
+    SplitPSKV split;
+    size_t offset = 0;
+    for (size_t i = 0; i < pskv.keys.size(); ++i) {
+      int len = pskv.lens[i];
+      if (local_servers_[ServerOf(pskv.keys[i])]) {
+        split.shm_keys.push_back(pskv.keys[i]);
+        // a placeholder value per key
+        split.shm_lens.push_back(1);
+        split.shm_parts.emplace_back(offset, len);
+      } else {
+        split.net_keys.push_back(pskv.keys[i]);
+        split.net_lens.push_back(len);
+        split.net_parts.emplace_back(offset, len);
+        split.net_size += len;
+      }
+      offset += len;
+    }
+    return split;
+  }
+
+  /**
+   * \brief push \a data of \a pskv, the parts on servers of this host through
+   * shared memory. \a cb is called once all parts are pushed
+   */
+  void PushParts(const PSKV& pskv, const real_t* data,
+                 const std::function<void()>& cb) {
+    auto split = std::make_shared<SplitPSKV>(Split(pskv));
+    auto remaining = std::make_shared<std::atomic<int>>(
+        !split->net_keys.empty() + !split->shm_keys.empty());
+    auto done = [remaining, cb]() {
+      if (--*remaining == 0) cb();
+    };
+    if (!split->net_keys.empty()) {
+      ps::SArray<real_t> vals(split->net_size);
+      size_t offset = 0;
+      for (const auto& part : split->net_parts) {
+        std::memcpy(vals.data() + offset, data + part.first,
+                    part.second * sizeof(real_t));
+        offset += part.second;
+      }
+      ps_worker_->ZPush(split->net_keys, vals, split->net_lens, 0, done);
+    }
+    if (!split->shm_keys.empty()) {
+      for (size_t i = 0; i < split->shm_keys.size(); ++i) {
+        const auto& part = split->shm_parts[i];
+        std::memcpy(shm_->WorkerBuffer(split->shm_keys[i], part.second),
+                    data + part.first, part.second * sizeof(real_t));
+      }
+      ps::SArray<real_t> vals(split->shm_keys.size(), 0);
+      ps_worker_->ZPush(split->shm_keys, vals, split->shm_lens, kShmPush,
+                        [this, split, done]() {
+          // the servers have mapped the buffers
+          for (ps::Key key : split->shm_keys) shm_->Unlink(key);
+          done();
+        });
+    }
+  }
+
+  /**
+   * \brief pull \a pskv into \a data, the parts on servers of this host
+   * through shared memory. \a cb is called once all parts are pulled
+   */
+  void PullParts(const PSKV& pskv, real_t* data,
+                 const std::function<void()>& cb) {
+    auto split = std::make_shared<SplitPSKV>(Split(pskv));
+    auto remaining = std::make_shared<std::atomic<int>>(
+        !split->net_keys.empty() + !split->shm_keys.empty());
+    auto done = [remaining, cb]() {
+      if (--*remaining == 0) cb();
+    };
+    if (!split->net_keys.empty()) {
+      auto vals = new ps::SArray<real_t>(split->net_size);
+      ps_worker_->ZPull(split->net_keys, vals, nullptr, 0,
+                        [split, vals, data, done]() {
+          size_t offset = 0;
+          for (const auto& part : split->net_parts) {
+            std::memcpy(data + part.first, vals->data() + offset,
+                        part.second * sizeof(real_t));
+            offset += part.second;
+          }
+          delete vals;
+          done();
+        });
+    }
+    if (!split->shm_keys.empty()) {
+      auto vals = new ps::SArray<real_t>(split->shm_keys.size());
+      ps_worker_->ZPull(split->shm_keys, vals, nullptr, kShmPull,
+                        [this, split, vals, data, done]() {
+          for (size_t i = 0; i < split->shm_keys.size(); ++i) {
+            const auto& part = split->shm_parts[i];
+            real_t* buf = shm_->WorkerBuffer(split->shm_keys[i], part.second);
+            std::memcpy(data + part.first, buf + part.second,
+                        part.second * sizeof(real_t));
+            shm_->Unlink(split->shm_keys[i]);
+          }
+          delete vals;
+          done();
+        });
+    }
+  }
+
   /**
    * \brief for worker to push and pull data
    */
@@ -326,6 +1163,39 @@ class KVStoreDist : public KVStoreLocal {
   size_t bigarray_bound_;
   /// \brief send & recver buffer
   std::unordered_map<int, NDArray> comm_buf_;
+  /// \brief the replies of servers to kWorkerTimes, guarded by mu_
+  std::vector<std::string> worker_times_;
+  /// \brief placement of the keys initialized, guarded by mu_
+  std::unique_ptr<KeyPlacement> placement_;
+  /// \brief arrays with less values are fused, 0 means no fusion
+  size_t fusion_threshold_;
+  /// \brief fuses pushes and pulls of small arrays
+  std::unique_ptr<FusionBuffer> push_fusion_;
+  std::unique_ptr<FusionBuffer> pull_fusion_;
+  /// \brief compression of pushed gradients
+  GradientCompression compression_;
+  /// \brief ps keys with the compressed lengths, guarded by mu_
+  std::unordered_map<int, PSKV> compr_ps_kv_;
+  /// \brief what has not been sent yet of each key
+  std::unordered_map<int, NDArray> residual_buf_;
+  /// \brief compressed send buffer of each key
+  std::unordered_map<int, NDArray> compr_buf_;
+  /// \brief arrays with more values are sliced, 0 means no slicing
+  size_t slice_size_;
+  /// \brief sends the messages by priority, if slicing
+  std::unique_ptr<PrioritySender> sender_;
+  /// \brief memory shared with the servers on this host, null if none
+  std::unique_ptr<ShmTransport> shm_;
+  /// \brief whether each server is on this host
+  std::vector<bool> local_servers_;
+  /// \brief aggregation with the workers on this host, null if disabled
+  std::unique_ptr<HostAggregation> host_;
+  /// \brief number of pushes of each key, with host aggregation
+  std::unordered_map<int, int64_t> host_version_;
+  /// \brief gradient shared with the host of each key
+  std::unordered_map<int, NDArray> host_buf_;
+  /// \brief number of calls to WaitForClock, namely the iteration
+  int64_t num_clock_waits_ = 0;
 };
 
 }  // namespace kvstore
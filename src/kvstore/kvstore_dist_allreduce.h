@@ -0,0 +1,192 @@
+/**
+ * Copyright (c) 2016 by Contributors
+ * @file   kvstore_dist_allreduce.h
+ * @brief  distributed implementation by allreduce among workers
+ */
+#ifndef MXNET_KVSTORE_KVSTORE_DIST_ALLREDUCE_H_
+#define MXNET_KVSTORE_KVSTORE_DIST_ALLREDUCE_H_
+#include <dmlc/parameter.h>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "./kvstore_local.h"
+#include "./allreduce.h"
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief distributed kvstore without servers.
+ *
+ * Every worker keeps the whole model. A push sums the gradients over the
+ * local devices and then over all workers by allreduce, and every worker
+ * applies the same update to its copy, so the copies stay identical. A pull
+ * is local.
+ *
+ * The allreduces run on a communication thread in the order the pushes were
+ * issued, which is the same on all workers, no matter in which order the
+ * engine finishes computing the gradients.
+ */
+class KVStoreDistAllreduce : public KVStoreLocal {
+ public:
+  explicit KVStoreDistAllreduce(bool use_device_comm)
+      : KVStoreLocal(use_device_comm) {
+    int num_workers = dmlc::GetEnv("DMLC_NUM_WORKER", 1);
+    int rank = dmlc::GetEnv("DMLC_WORKER_ID", dmlc::GetEnv("DMLC_TASK_ID", 0));
+    std::string root_uri = dmlc::GetEnv("DMLC_PS_ROOT_URI", std::string("127.0.0.1"));
+    int root_port = dmlc::GetEnv("DMLC_PS_ROOT_PORT", 9091);
+    ring_bound_ = dmlc::GetEnv("MXNET_KVSTORE_ALLREDUCE_RING_BOUND", 1 << 16);
+    allreduce_.reset(new Allreduce(rank, num_workers, root_uri, root_port));
+    thread_ = std::thread([this]() { Run(); });
+  }
+
+  virtual ~KVStoreDistAllreduce() {
+    Engine::Get()->WaitForAll();
+    Barrier();
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      stop_ = true;
+    }
+    cond_.notify_one();
+    thread_.join();
+  }
+
+  void Init(const std::vector<int>& keys,
+            const std::vector<NDArray>& values) override {
+    KVStoreLocal::Init(keys, values);
+    // start from the values of rank 0
+    for (int key : keys) {
+      NDArray local = local_[key];
+      int64_t seq = NextSeq();
+      auto bcast = [this, local, seq](RunContext rctx,
+                                      Engine::CallbackOnComplete cb) {
+        Submit(seq, [this, local, cb]() {
+            allreduce_->Broadcast(static_cast<real_t*>(local.data().dptr_),
+                                  local.shape().Size(), 0);
+            cb();
+          });
+      };
+      Engine::Get()->PushAsync(bcast, pinned_ctx_, {}, {local.var()},
+                               FnProperty::kNormal, 0);
+    }
+    for (int key : keys) local_[key].WaitToRead();
+  }
+
+  void Push(const std::vector<int>& keys,
+            const std::vector<NDArray>& values,
+            int priority) override {
+    std::vector<int> uniq_keys;
+    std::vector<std::vector<NDArray> > grouped_vals;
+    GroupKVPairs(keys, values, &uniq_keys, &grouped_vals);
+
+    for (size_t i = 0; i < uniq_keys.size(); ++i) {
+      int key = uniq_keys[i];
+      const NDArray& merged = comm_->Reduce(key, grouped_vals[i], priority);
+      NDArray& local = local_[key];
+      CHECK(!local.is_none()) << "key " << key << " has not been inited";
+
+      // sum over workers in place on a buffer, which is never shared with
+      // the caller
+      NDArray& buf = comm_buf_[key];
+      if (buf.is_none()) buf = NDArray(merged.shape(), pinned_ctx_);
+      CopyFromTo(merged, &buf);
+      bool ring = merged.shape().Size() >= ring_bound_;
+      int64_t seq = NextSeq();
+      auto sum = [this, buf, ring, seq](RunContext rctx,
+                                        Engine::CallbackOnComplete cb) {
+        Submit(seq, [this, buf, ring, cb]() {
+            allreduce_->Sum(static_cast<real_t*>(buf.data().dptr_),
+                            buf.shape().Size(), ring);
+            cb();
+          });
+      };
+      Engine::Get()->PushAsync(sum, pinned_ctx_, {}, {buf.var()},
+                               FnProperty::kNormal, priority, "KVStoreAllreduce");
+
+      if (updater_ != nullptr) {
+        updater_(key, buf, &local, get_group_size());
+      } else {
+        CopyFromTo(buf, &local);
+      }
+    }
+  }
+
+  void Barrier() override {
+    std::promise<void> done;
+    Submit(NextSeq(), [this, &done]() {
+        allreduce_->Barrier();
+        done.set_value();
+      });
+    done.get_future().wait();
+  }
+
+  int get_rank() const override {
+    return allreduce_->rank();
+  }
+
+  int get_group_size() const override {
+    return allreduce_->size();
+  }
+
+ private:
+  /**
+   * \brief the position of the next collective operation
+   */
+  int64_t NextSeq() {
+    std::lock_guard<std::mutex> lk(mu_);
+    return next_seq_++;
+  }
+
+  /**
+   * \brief run \a task at position \a seq, once the ones before finished
+   */
+  void Submit(int64_t seq, const std::function<void()>& task) {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      tasks_[seq] = task;
+    }
+    cond_.notify_one();
+  }
+
+  void Run() {
+    int64_t next = 0;
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lk(mu_);
+        cond_.wait(lk, [this, next]() {
+            return stop_ || tasks_.count(next) != 0;
+          });
+        auto it = tasks_.find(next);
+        if (it == tasks_.end()) break;
+        task = std::move(it->second);
+        tasks_.erase(it);
+      }
+      task();
+      ++next;
+    }
+  }
+
+  std::unique_ptr<Allreduce> allreduce_;
+  /// \brief arrays of at least this size are summed along the ring
+  size_t ring_bound_;
+  /// \brief the buffers summed over workers
+  std::unordered_map<int, NDArray> comm_buf_;
+  std::mutex mu_;
+  std::condition_variable cond_;
+  /// \brief the submitted operations by position, guarded by mu_
+  std::unordered_map<int64_t, std::function<void()>> tasks_;
+  /// \brief guarded by mu_
+  int64_t next_seq_ = 0;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_KVSTORE_DIST_ALLREDUCE_H_
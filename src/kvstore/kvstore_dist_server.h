@@ -1,4 +1,3 @@
-
 /*!
  * Copyright (c) 2015 by Contributors
  * \file mxnet_node.h
@@ -6,6 +5,9 @@
  */
 #ifndef MXNET_KVSTORE_KVSTORE_DIST_SERVER_H_
 #define MXNET_KVSTORE_KVSTORE_DIST_SERVER_H_
+#include <dmlc/parameter.h>
+#include <dmlc/memory_io.h>
+#include <algorithm>
 #include <queue>
 #include <string>
 #include <mutex>
@@ -13,6 +15,7 @@
 #include <memory>
 #include <functional>
 #include <future>
+#include <thread>
 #include <vector>
 #include <fstream>
 #include <sstream>
@@ -20,6 +23,13 @@
 #include <unistd.h>
 #include "ps/ps.h"
 #include "mxnet/kvstore.h"
+#include "./vector_clock.h"
+#include "./worker_grouping.h"
+#include "./gradient_compression.h"
+#include "./server_optimizer.h"
+#include "./server_checkpoint.h"
+#include "./shm_transport.h"
+#include "./row_sparse.h"
 #include <sys/time.h>
 
 namespace mxnet {
@@ -29,72 +39,253 @@ static const int kStopServer = -1;
 static const int kSyncMode = -2; // BSP
 static const int kSyncByGroupMode = -3; // GSP
 static const int kSyncByStaleMode = -4; // SSP
+static const int kWaitForClock = -5;
+static const int kRegroupWorkers = -6;
+static const int kSetGradientCompression = -7;
+static const int kSetOptimizer = -8;
+static const int kSetHostWorkers = -9;
+static const int kShmHello = -10;
+static const int kWorkerTimes = -11;
+
+/// \brief the ps-lite command of a push with compressed values
+static const int kCompressedPush = 1;
+/// \brief the ps-lite commands of a push or pull whose values are passed in
+/// shared memory
+static const int kShmPush = 2;
+static const int kShmPull = 3;
+/// \brief the ps-lite command of a pull answered by compressed values
+static const int kCompressedPull = 4;
+/// \brief the ps-lite command of a push of some rows only, each value
+/// starting with the ranges of the rows in it
+static const int kRowSparsePush = 5;
+/// \brief the ps-lite commands of a pull of some rows only: a push of the
+/// ranges of the rows, and then the pull of their values
+static const int kRowSparsePullRows = 6;
+static const int kRowSparsePull = 7;
+
+/// \brief the server keys of slices start here, above the keys of arrays.
+/// python/mxnet/optimizer.py maps them back to arrays in the same way
+static const int kSliceKeyBase = 1 << 30;
+/// \brief the maximal number of slices of an array
+static const int kMaxSlices = 1024;
+
+/**
+ * \brief the server key of the \a i-th slice of array \a key
+ */
+inline int SliceKey(int key, int i) {
+  CHECK_LT(key, (kSliceKeyBase / kMaxSlices)) << "key " << key << " is too large to slice";
+  CHECK_LT(i, kMaxSlices);
+  return kSliceKeyBase + key * kMaxSlices + i;
+}
+
+/**
+ * \brief the array key of server key \a key, which is a slice or an array
+ */
+inline int ArrayKey(int key) {
+  return key >= kSliceKeyBase ? (key - kSliceKeyBase) / kMaxSlices : key;
+}
 
 /**
- * \brief executor runs a function using the thread called \ref Start
+ * \brief executor runs functions using the thread called \ref Start, in the
+ * order they are posted. the blocks queuing them are recycled, so that
+ * posting does not allocate once the executor is warmed up
  */
 class Executor {
  public:
   /**
-   * \brief start the executor
+   * \brief function
    */
-  void Start() {
-    std::unique_lock<std::mutex> lk(mu_);
-    while (true) {
-      cond_.wait(lk, [this]{return !queue_.empty();});
-      Block blk = std::move(queue_.front());
-      queue_.pop();
-      lk.unlock();
+  typedef std::function<void()> Func;
 
-      if (blk.f) {
-        blk.f(); blk.p->set_value();
-      } else {
-        blk.p->set_value(); break;
-      }
-      lk.lock();
+  ~Executor() {
+    while (free_ != nullptr) {
+      Block* blk = free_;
+      free_ = blk->next;
+      delete blk;
     }
   }
 
   /**
-   * \brief function
+   * \brief start the executor, returns once stopped
    */
-  typedef std::function<void()> Func;
+  void Start() {
+    while (true) {
+      Block* blk;
+      {
+        std::unique_lock<std::mutex> lk(mu_);
+        cond_.wait(lk, [this]{ return head_ != nullptr; });
+        blk = head_;
+        head_ = blk->next;
+        if (head_ == nullptr) tail_ = nullptr;
+      }
+      blk->f();
+      blk->f = nullptr;
+      {
+        std::lock_guard<std::mutex> lk(mu_);
+        blk->next = free_;
+        free_ = blk;
+        if (stop_) break;
+      }
+    }
+  }
 
   /**
-   * \brief let the thread called \ref Start to exec a function. threadsafe
+   * \brief let the thread called \ref Start to exec a function, and return
+   * without waiting for it. threadsafe
    */
-  void Exec(const Func& func) {
-    Block blk(func);
-    auto fut = blk.p->get_future();
+  void Post(Func&& func) {
     {
       std::lock_guard<std::mutex> lk(mu_);
-      queue_.push(std::move(blk));
-      cond_.notify_one();
+      Block* blk = free_;
+      if (blk != nullptr) {
+        free_ = blk->next;
+      } else {
+        blk = new Block();
+      }
+      blk->f = std::move(func);
+      blk->next = nullptr;
+      if (tail_ != nullptr) {
+        tail_->next = blk;
+      } else {
+        head_ = blk;
+      }
+      tail_ = blk;
     }
-    fut.wait();
+    cond_.notify_one();
   }
 
   /**
-   * \brief stop the thread, threadsafe
+   * \brief let the thread called \ref Start to exec a function, and wait
+   * for it. threadsafe
+   */
+  void Exec(const Func& func) {
+    std::mutex mu;
+    std::condition_variable cond;
+    bool done = false;
+    Post([&]() {
+        func();
+        std::lock_guard<std::mutex> lk(mu);
+        done = true;
+        cond.notify_one();
+      });
+    std::unique_lock<std::mutex> lk(mu);
+    cond.wait(lk, [&done]{ return done; });
+  }
+
+  /**
+   * \brief stop the thread once the functions posted before are done,
+   * threadsafe
    */
   void Stop() {
-    Exec(Func());
+    Exec([this]() {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+      });
   }
 
  private:
   struct Block {
-  explicit Block(const Func& func) : f(func), p(std::make_shared<std::promise<void>>()) { }
     Func f;
-    std::shared_ptr<std::promise<void>> p;
+    Block* next = nullptr;
   };
-  std::queue<Block> queue_;
   std::mutex mu_;
   std::condition_variable cond_;
+  /// \brief the functions posted, guarded by mu_
+  Block* head_ = nullptr;
+  Block* tail_ = nullptr;
+  /// \brief the blocks to reuse, guarded by mu_
+  Block* free_ = nullptr;
+  bool stop_ = false;
+};
+
+/**
+ * \brief runs functions on a pool of threads. all functions posted with the
+ * same key are executed by the same thread in the posting order, so per key
+ * states can be accessed without locking.
+ *
+ * if the pool has no thread, the function is executed by the caller.
+ */
+class KeyShardExecutor {
+ public:
+  typedef std::function<void()> Func;
+
+  ~KeyShardExecutor() {
+    Stop();
+  }
+
+  /**
+   * \brief start \a nthreads shard threads. non-blocking
+   */
+  void Start(int nthreads) {
+    CHECK(threads_.empty()) << "already started";
+    shards_.resize(std::max(nthreads, 0));
+    for (auto& shard : shards_) {
+      shard.reset(new Shard());
+      Shard* ptr = shard.get();
+      threads_.emplace_back([ptr]() { ptr->Run(); });
+    }
+  }
+
+  /**
+   * \return the number of shard threads
+   */
+  int size() const { return static_cast<int>(shards_.size()); }
+
+  /**
+   * \brief post \a func to the thread owning \a key. returns immediately
+   * unless there is no shard thread. threadsafe
+   */
+  void Exec(int key, const Func& func) {
+    if (shards_.empty()) {
+      func(); return;
+    }
+    size_t i = static_cast<size_t>(key) % shards_.size();
+    shards_[i]->Push(func);
+  }
+
+  /**
+   * \brief finish all posted functions and join the threads
+   */
+  void Stop() {
+    for (auto& shard : shards_) shard->Push(Func());
+    for (auto& t : threads_) t.join();
+    threads_.clear();
+    shards_.clear();
+  }
+
+ private:
+  struct Shard {
+    void Push(const Func& func) {
+      {
+        std::lock_guard<std::mutex> lk(mu);
+        queue.push(func);
+      }
+      cond.notify_one();
+    }
+    void Run() {
+      while (true) {
+        Func f;
+        {
+          std::unique_lock<std::mutex> lk(mu);
+          cond.wait(lk, [this]{ return !queue.empty(); });
+          f = std::move(queue.front());
+          queue.pop();
+        }
+        if (!f) break;
+        f();
+      }
+    }
+    std::queue<Func> queue;
+    std::mutex mu;
+    std::condition_variable cond;
+  };
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::vector<std::thread> threads_;
 };
 
 class KVStoreDistServer {
  public:
-  KVStoreDistServer() {
+  KVStoreDistServer() : clock_(ps::NumWorkers()) {
     using namespace std::placeholders;
     ps_server_ = new ps::KVServer<float>(0);
     static_cast<ps::SimpleApp*>(ps_server_)->set_request_handle(
@@ -102,10 +293,20 @@ class KVStoreDistServer {
     ps_server_->set_request_handle(
         std::bind(&KVStoreDistServer::DataHandle, this, _1, _2, _3));
     sync_mode_ = 0;
+    // a push more than max_delay_ iterations ahead of the slowest worker is
+    // held back in stale sync and async modes. 0 means no bound
+    max_delay_ = dmlc::GetEnv("MXNET_KVSTORE_MAX_DELAY", 0);
+    // the ps-lite receive thread only hands the messages over, so that
+    // receiving, merging and updating overlap. the python updater hands the
+    // keys back to their owner threads, so there is at least one
+    shards_.Start(std::max(dmlc::GetEnv("MXNET_KVSTORE_SERVER_NTHREADS", 1), 1));
+    if (dmlc::GetEnv("MXNET_KVSTORE_SHM_TRANSPORT", false)) {
+      shm_.reset(new ShmTransport(ShmJobName()));
+    }
   }
 
   ~KVStoreDistServer() {
-	file.close();
+    shards_.Stop();
     delete ps_server_;
   }
 
@@ -127,8 +328,116 @@ class KVStoreDistServer {
   }
 
  private:
+  /**
+   * \brief a fused request with several keys
+   */
+  class FusedRequest {
+   public:
+    explicit FusedRequest(size_t num_keys)
+        : remaining_(num_keys), responses_(num_keys) { }
+
+    /**
+     * \brief add the response of the \a i-th key. threadsafe
+     * \return true if all keys are responded
+     */
+    bool Add(size_t i, const ps::KVPairs<real_t>& res) {
+      std::lock_guard<std::mutex> lk(mu_);
+      responses_[i] = res;
+      return --remaining_ == 0;
+    }
+
+    /**
+     * \brief concatenate the responses of all keys
+     */
+    ps::KVPairs<real_t> Merge() {
+      std::lock_guard<std::mutex> lk(mu_);
+      ps::KVPairs<real_t> res;
+      for (const auto& r : responses_) {
+        res.keys.append(r.keys);
+        res.vals.append(r.vals);
+        res.lens.append(r.lens);
+      }
+      return res;
+    }
+
+   private:
+    std::mutex mu_;
+    size_t remaining_;
+    std::vector<ps::KVPairs<real_t>> responses_;
+  };
+
+  /**
+   * \brief the part of a request on one key
+   */
+  struct Request {
+    ps::KVMeta meta;
+    /// \brief the key, and the pushed values
+    ps::KVPairs<real_t> data;
+    /// \brief the fused request it belongs to, or null
+    std::shared_ptr<FusedRequest> fused;
+    /// \brief the position in \a fused
+    size_t index = 0;
+  };
+
+  struct MergeBuf {
+    std::vector<Request> request;
+    NDArray array;
+    /// \brief number of workers whose gradients are merged
+    int num_workers = 0;
+    /// \brief the ranges merged by row sparse pushes, outside of which \a
+    /// array is zero unless \a dense
+    std::vector<Range> ranges;
+    /// \brief whether a dense push was merged since \a array was zeroed
+    bool dense = true;
+  };
+
+  /**
+   * \brief all states of a key on this server. a key is always handled by
+   * the same shard thread, so the entry itself needs no locking
+   */
+  struct KeyEntry {
+    /// \brief the stored value
+    NDArray stored;
+    /// \brief merge buffer for sync mode
+    MergeBuf merge_buf;
+    /// \brief the decompressed push, if gradients are compressed
+    std::vector<real_t> decompressed;
+    /// \brief the group plan \a store_group and \a merge_buf_of_group follow
+    std::shared_ptr<const GroupPlan> plan;
+    /// \brief \a stored as a version. it is immutable while referenced by a
+    /// group or by a pull response not yet sent
+    std::shared_ptr<const NDArray> latest;
+    /// \brief the version seen by each group, shared among groups
+    std::vector<std::shared_ptr<const NDArray>> store_group;
+    /// \brief merge buffer of each group, for group sync mode
+    std::vector<MergeBuf> merge_buf_of_group;
+    /// \brief number of updates applied to \a stored
+    long long int update_count_total = 0;  // NOLINT(*)
+    /// \brief update_count_total when a worker pulled last time
+    std::unordered_map<int, long long int> update_count_worker;  // NOLINT(*)
+    /// \brief update_count_total when a group updated last time
+    std::vector<long long int> update_count_group;  // NOLINT(*)
+    /// \brief the plan before \a plan, with the merge buffers and update
+    /// counts of its groups, kept until its groups with a partial merge
+    /// finished their round
+    std::shared_ptr<const GroupPlan> old_plan;
+    std::vector<MergeBuf> old_merge_buf_of_group;
+    std::vector<long long int> old_update_count_group;  // NOLINT(*)
+    /// \brief the round of the checkpoint this key was saved in last time
+    int64_t checkpoint_round = 0;
+    /// \brief whether updater_ is updating \a stored on the main thread
+    bool updating = false;
+    /// \brief the requests received while \a updating, in order
+    std::queue<Request> waiting;
+    /// \brief the ranges of the next row sparse pull of each sender
+    std::unordered_map<int, std::vector<Range>> pull_ranges;
+  };
+
   void CommandHandle(const ps::SimpleData& recved, ps::SimpleApp* app) {
+    std::call_once(checkpoint_once_, [this]() { StartCheckpoint(); });
     if (recved.head == kStopServer) {
+      // finish the pending pushes and pulls first, they may need exec_
+      shards_.Stop();
       exec_.Stop();
     } else if (recved.head == kSyncMode) {
       sync_mode_ = kSyncMode;
@@ -139,77 +448,66 @@ class KVStoreDistServer {
 	  merge_flag = 0;
 	  update_flag = 0;
 	} else if (recved.head == kSyncByGroupMode) {
-	  sync_mode_ = kSyncByGroupMode;
-	  group_filename = std::string("/home/") + std::string(getlogin()) + "/mxnet/example/image-classification/groups";
-	  group_file.open(group_filename, std::ios::in);
-	  std::string s;
-	  std::vector<int> group_nums;
-	  std::multimap<std::string, int> ip_to_id;
-	  std::string ip;
-
-	  struct Node {
-		std::string ip;
-		int id;
-		bool is_visited;
-		Node(std::string ipc, int idc = 0, bool is_visitedc = false): ip(ipc) {}
-	  };
-
-	  std::vector<Node> nodes;
-	  while (getline(group_file, s)) {
-		std::istringstream f(s);
-		while (getline(f, ip, ' ')) {
-			nodes.push_back(Node(ip));
-		}
-	  }
-	  std::sort(nodes.begin(), nodes.end(), [](const Node& a, const Node& b) {
-		return a.ip < b.ip;
-	  });
-	  int count = nodes.size() - 1;
-	  for (unsigned int i = 0; i < nodes.size(); ++i) {
-		nodes[i].id = count * 2 + 9;
-		--count;
-		std::cout << "key = " << nodes[i].ip << "  value = " << nodes[i].id << std::endl;
-	  }
-
-	  group_file.close();
-	  group_file.open(group_filename, std::ios::in);
-	  while (getline(group_file, s)) {
-		group_nums.clear();
-		std::istringstream f(s);
-		while (getline(f, ip, ' ')) {
-	      for (auto& node : nodes) {
-			if (node.ip == ip && node.is_visited == false) {
-			  group_nums.push_back(node.id);
-			  node.is_visited = true;
-			}
-		  }
-		}
-		groups.push_back(group_nums);
-	  }
-	  groups_count = groups.size();
-	  store_group.resize(groups_count);
-	  merge_buf_of_group.resize(groups_count);
-	  for (auto group : groups) {
-		for (auto num : group) {
-		  std::cout << num << " ";
-		}
-		std::cout << std::endl;
-	  }
-	  staleness = 0;
+      sync_mode_ = kSyncByGroupMode;
+      // the body is the number of groups
+      num_groups_ = recved.body.empty() ? 1 : std::stoi(recved.body);
+      grouping_.reset(new WorkerGrouping(ps::NumWorkers(), num_groups_));
 	} else if (recved.head == kSyncByStaleMode) {
 	  sync_mode_ = kSyncByStaleMode;
-	  miniters_filename = std::string("/home/") + std::string(getlogin()) + "/mxnet/example/image-classification/ssp/miniters.log";
-	  file.open(miniters_filename, std::ios::out);
-	  is_first_push = true;
-	  straggler = (ps::NumWorkers() - 1) * 2 + 9;
-	  staleness = 0;
+	} else if (recved.head == kWaitForClock) {
+      // reply once all workers have reached the clock. it does not block the
+      // receive thread, the reply is sent by the thread ticking the clock
+      // the body is the clock and the iteration of the worker
+      int64_t clock, iteration;
+      std::istringstream is(recved.body);
+      CHECK(is >> clock >> iteration) << "invalid wait: " << recved.body;
+      int rank = ps::Postoffice::IDtoRank(recved.sender);
+      if (!unlifted_.empty() && unlifted_[rank]) {
+        // a restored server learns where the worker is from its first
+        // wait. a push of the last iteration still in flight may tick once
+        // more, which only loosens the bound on this worker by one
+        unlifted_[rank] = false;
+        clock_.Lift(rank, iteration);
+      }
+      clock_.WaitFor(clock, [recved, app]() {
+          app->Response(recved);
+        });
+      return;
+    } else if (recved.head == kWorkerTimes) {
+      // the worker regrouping the others gathers the times of all servers
+      app->Response(recved, grouping_ ? grouping_->EncodeTimes() : "");
+      return;
+    } else if (recved.head == kRegroupWorkers) {
+      // the body is the plan made by that worker, the same for all servers
+      if (grouping_) grouping_->Adopt(recved.body);
+    } else if (recved.head == kSetGradientCompression) {
+      compression_.DecodeParams(recved.body);
+    } else if (recved.head == kSetOptimizer) {
+      optimizer_config_ = recved.body;
+      optimizer_.reset(new ServerOptimizer(recved.body));
+    } else if (recved.head == kShmHello) {
+      // the body is the rank and the nonce of the worker
+      int rank;
+      uint64_t nonce;
+      std::istringstream is(recved.body);
+      CHECK(is >> rank >> nonce) << "invalid handshake: " << recved.body;
+      if (shm_ && shm_->Accept(rank, nonce, ps::MyRank())) {
+        LOG(INFO) << "worker " << rank << " is on the host of server "
+                  << ps::MyRank() << ", using shared memory";
+      }
+    } else if (recved.head == kSetHostWorkers) {
+      std::lock_guard<std::mutex> lk(mu_);
+      host_workers_[recved.sender] = std::stoi(recved.body);
 	} else {
+      commands_.emplace_back(recved.head, recved.body);
       // let the main thread to execute ctrl, which is necessary for python
       exec_.Exec([this, recved]() {
         CHECK(controller_);
         controller_(recved.head, recved.body);
       });
-      staleness = 0;
+    }
+    if (checkpoint_ && recved.head != kStopServer) {
+      checkpoint_->SaveConfig(EncodeConfig());
     }
     app->Response(recved);
   }
@@ -217,53 +515,143 @@ class KVStoreDistServer {
   void DataHandle(const ps::KVMeta& req_meta,
                   const ps::KVPairs<real_t>& req_data,
                   ps::KVServer<real_t>* server) {
+    std::call_once(checkpoint_once_, [this]() { StartCheckpoint(); });
     // do some check
-    CHECK_EQ(req_data.keys.size(), (size_t)1);
+    size_t num_keys = req_data.keys.size();
+    CHECK_GT(num_keys, (size_t)0);
     if (req_meta.push) {
-      CHECK_EQ(req_data.lens.size(), (size_t)1);
-      CHECK_EQ(req_data.vals.size(), (size_t)req_data.lens[0]);
+      CHECK_EQ(req_data.lens.size(), num_keys);
     }
 
     int parameter_partition_num = ps::Postoffice::Get()->num_parameter_partition(); //yegeyan 2016.12.9
 
-    int key;
-    if (parameter_partition_num >= 0) {
-      key = req_data.keys[0];
+    // a request with several keys is a fused one, each key is handled by its
+    // owner thread and the request is responded once all keys are done
+    std::shared_ptr<FusedRequest> fused;
+    if (num_keys > 1) fused = std::make_shared<FusedRequest>(num_keys);
+    size_t offset = 0;
+    for (size_t i = 0; i < num_keys; ++i) {
+      int key;
+      if (parameter_partition_num >= 0) {
+        key = req_data.keys[i];
+      }
+      else {
+        key = DecodeKey(req_data.keys[i]);
+      }
+
+      // the SArrays are reference counted, so the segments captured here
+      // keep the received memory alive until the shard thread is done with it
+      Request req;
+      req.meta = req_meta;
+      req.fused = fused;
+      req.index = i;
+      req.data.keys = req_data.keys.segment(i, i + 1);
+      if (req_meta.push) {
+        req.data.lens = req_data.lens.segment(i, i + 1);
+        req.data.vals = req_data.vals.segment(offset, offset + req_data.lens[i]);
+        offset += req_data.lens[i];
+      }
+      shards_.Exec(key, [this, key, req, server]() {
+          DataHandleKey(key, req, server);
+        });
+    }
+    if (req_meta.push) {
+      CHECK_EQ(req_data.vals.size(), offset);
+    }
+  }
+
+  /**
+   * \brief respond to \a req. a fused request is responded once all of its
+   * keys are responded, with the pulled values concatenated in order
+   */
+  void Respond(const Request& req, ps::KVServer<real_t>* server,
+               const ps::KVPairs<real_t>& res = ps::KVPairs<real_t>()) {
+    if (!req.fused) {
+      server->Response(req.meta, res);
+    } else if (req.fused->Add(req.index, res)) {
+      server->Response(req.meta, req.fused->Merge());
     }
-    else {
-      key = DecodeKey(req_data.keys[0]);
+  }
+
+  /**
+   * \brief handle a push or pull on \a key. it is always called by the thread
+   * owning \a key
+   */
+  void DataHandleKey(int key, const Request& req,
+                     ps::KVServer<real_t>* server) {
+    const ps::KVMeta& req_meta = req.meta;
+    const ps::KVPairs<real_t>& req_data = req.data;
+    auto& entry = GetKeyEntry(key);
+    auto& stored = entry.stored;
+    if (entry.updating) {
+      entry.waiting.push(req);
+      return;
     }
 
-    auto& stored = store_[key];
+    if (req_meta.cmd == kRowSparsePullRows) {
+      // the ranges of the pull following
+      CHECK(!stored.is_none()) << "init " << key << " first";
+      DecodeRanges(req_data.vals.data(), req_data.lens[0], stored.shape()[0],
+                   &entry.pull_ranges[req_meta.sender]);
+      Respond(req, server);
+      return;
+    }
+
+    if (req_meta.push && !stored.is_none() && max_delay_ > 0 &&
+        (sync_mode_ == kSyncByStaleMode || sync_mode_ == 0)) {
+      int rank = ps::Postoffice::IDtoRank(req_meta.sender);
+      int64_t clock = clock_.clock(rank, key) - max_delay_;
+      if (clock > clock_.clock()) {
+        // the sender is too far ahead of the slowest worker. hold this push
+        // back, it is handled again by the owner thread once the slowest
+        // worker catches up
+        clock_.WaitFor(clock, [this, key, req, server]() {
+            shards_.Exec(key, [this, key, req, server]() {
+                DataHandleKey(key, req, server);
+              });
+          });
+        return;
+      }
+    }
 
     // there used several WaitToRead, this is because \a recved's memory
     // could be deallocated when this function returns. so we need to make sure
     // the operators with \a NDArray are actually finished
-    if (req_meta.push) {
-      size_t ds[] = {(size_t)req_data.lens[0]};
+    if (req_meta.push && req_meta.cmd == kRowSparsePush) {
+      CHECK(!stored.is_none()) << "init " << key << " first";
+      RowSparsePush(key, &entry, req);
+    } else if (req_meta.push) {
+      real_t* data = (real_t*)req_data.vals.data();  // NOLINT(*)
+      size_t len = req_data.lens[0];
+      if (req_meta.cmd == kShmPush) {
+        data = CHECK_NOTNULL(shm_)->ServerBuffer(
+            ps::Postoffice::IDtoRank(req_meta.sender), req_data.keys[0], &len);
+      } else if (req_meta.cmd == kCompressedPush) {
+        CHECK(!stored.is_none()) << "init " << key << " first";
+        // the buffer is reused by the next push on this key, which is safe
+        // since every branch below waits for the operators reading recved
+        len = stored.shape()[0];
+        CHECK_EQ(static_cast<size_t>(req_data.lens[0]),
+                 compression_.CompressedSize(len));
+        entry.decompressed.resize(len);
+        compression_.Decompress(data, len, entry.decompressed.data());
+        data = entry.decompressed.data();
+      }
+      size_t ds[] = {len};
       TShape dshape(ds, ds + 1);
-      TBlob recv_blob((real_t*)req_data.vals.data(), // NOLINT(*)
-                      dshape, cpu::kDevMask);
+      TBlob recv_blob(data, dshape, cpu::kDevMask);
       NDArray recved = NDArray(recv_blob, 0);
+      KeyEntry* e = &entry;
 
       if (stored.is_none()) {
         // initialization
         stored = NDArray(dshape, Context());
         CopyFromTo(recved, &stored, 0);
-        server->Response(req_meta);
-        stored.WaitToRead();
-
-		if (sync_mode_ == kSyncByGroupMode) {
-		  for (unsigned int i = 0; i < groups_count; ++i) {
-			store_group[i][key] = NDArray(dshape, Context());
-			CopyFromTo(recved, &store_group[i][key], 0);
-			server->Response(req_meta);
-			store_group[i][key].WaitToRead();
-		  }
-		}
+        InitEntry(key, &entry);
+        FinishPush(key, &entry, req, false, {req}, stored);
       } else if (sync_mode_ == kSyncMode) {
         // synced push
-        auto& merged = merge_buf_[key];
+        auto& merged = entry.merge_buf;
         if (merged.array.is_none()) {
           merged.array = NDArray(dshape, Context());
         }
@@ -272,166 +660,493 @@ class KVStoreDistServer {
           CopyFromTo(recved, &merged.array, 0);
         } else {
           merged.array += recved;
-          /*
-		  int total_num = 1000;
-		  clock_t start_time = clock();
-		  for (int i = 0; i < total_num; ++i) {
-			merged.array += recved;
-		  }
-		  clock_t end_time = clock();
-		  std::cout << "--------Merge cost time: " << (end_time - start_time) * 1.0 / (CLOCKS_PER_SEC * total_num)
-				  << std::endl;
-		  */
         }
+        merged.dense = true;
 
-        merged.request.push_back(req_meta);
+        merged.request.push_back(req);
+        merged.num_workers += HostWorkers(req_meta.sender);
 
-        if (merged.request.size() == (size_t)ps::NumWorkers()) {
-          // let the main thread to execute updater_, which is necessary for
-          // python
-          if (updater_) {
-        	worker_num = ps::NumWorkers();
-            exec_.Exec([this, key, &merged, &stored](){
-              CHECK(updater_);
-              updater_(key, merged.array, &stored, worker_num);
-            });
-          } else {
-            // if no updater, just copy
-            CopyFromTo(merged.array, &stored);
-          }
+        if (merged.num_workers == ps::NumWorkers()) {
+          std::vector<Request> replies;
+          replies.swap(merged.request);
+          merged.num_workers = 0;
+          Apply(key, &entry, merged.array, ps::NumWorkers(),
+                [this, key, e, req, replies]() {
+                  FinishPush(key, e, req, true, replies, e->stored);
+                });
+        } else {
+          FinishPush(key, &entry, req, true, {}, merged.array);
+        }
+      } else if (sync_mode_ == kSyncByGroupMode) {
+        int rank = ps::Postoffice::IDtoRank(req_meta.sender);
+        grouping_->OnPush(rank, key);
+        AdoptGroupPlan(&entry);
+        // a worker whose group of the old plan started a round finishes it
+        // there, the others merge by the new plan
+        bool old = entry.old_plan &&
+            !entry.old_merge_buf_of_group[entry.old_plan->group_of_rank[rank]]
+            .request.empty();
+        const auto& plan = old ? entry.old_plan : entry.plan;
+        auto& merge_buf_of_group =
+            old ? entry.old_merge_buf_of_group : entry.merge_buf_of_group;
+        auto& update_count_group =
+            old ? entry.old_update_count_group : entry.update_count_group;
+        int i = plan->group_of_rank[rank];
+        size_t group_size = plan->members[i].size();
+        auto& merged = merge_buf_of_group[i];
+        if (merged.array.is_none()) {
+          merged.array = NDArray(dshape, Context());
+        }
 
-          for (const auto& req : merged.request) {
-            server->Response(req);
-          }
-          merged.request.clear();
-          stored.WaitToRead();
+        if (merged.request.size() == 0) {
+          CopyFromTo(recved, &merged.array, 0);
         } else {
-          merged.array.WaitToRead();
+          merged.array += recved;
         }
-      } else if (sync_mode_ == kSyncByGroupMode){
-          for (unsigned int i = 0; i < groups_count; ++i) {
-        	for (unsigned int j = 0; j < groups[i].size(); ++j) {
-        	  if (req_meta.sender == groups[i][j]) {
-        	    auto& merged = merge_buf_of_group[i][key];
-        		if (merged.array.is_none()) {
-        		  merged.array = NDArray(dshape, Context());
-        		}
-
-        		if (merged.request.size() == 0) {
-        		  CopyFromTo(recved, &merged.array, 0);
-        		} else {
-        		  merged.array += recved;
-        		}
-
-        	    merged.request.push_back(req_meta);
-
-        		if (merged.request.size() == groups[i].size()) {
-        		  // let the main thread to execute updater_, which is necessary for
-        		  // python
-        	      if (updater_) { //
-        	    	worker_num = groups[i].size();
-        			staleness = update_count_total[key] - update_count_group[i][key] + 1;
-        			if (staleness <= 0) staleness = 1;
-        			//staleness = 1;
-        			exec_.Exec([this, key, &merged, &stored](){
-        			  CHECK(updater_);
-        			  updater_(key, merged.array, &stored, worker_num * staleness);
-        			});
-        			++update_count_total[key];
-        			update_count_group[i][key] = update_count_total[key];
-        		  } else {
-        			// if no updater, just copy
-        			CopyFromTo(merged.array, &stored);
-        		  }
-        		  for (const auto& req : merged.request) {
-        			server->Response(req);
-        		  }
-        		  merged.request.clear();
-        		  store_group[i][key] = stored;
-        		  store_group[i][key].WaitToRead();
-        		} else {
-        		  merged.array.WaitToRead();
-        		}
-        		return;
-        	  }
-            }
-          }
-      } else if (sync_mode_ == kSyncByStaleMode) {
-          if (updater_) {
-        	// staleness = update_count_total[key] - update_count_worker[req_meta.sender][key] + 1;
-        	// if (staleness <= 0) staleness = 1;
-        	staleness = 1;
-        	exec_.Exec([this, key, &recved, &stored](){
-        	  CHECK(updater_);
-        	  updater_(key, recved, &stored, staleness);
-        	});
-        	++update_count_total[key];
-          } else {
-        	// if no updater, just copy
-        	CopyFromTo(recved, &stored);
+
+        merged.request.push_back(req);
+
+        if (merged.request.size() == group_size) {
+          int num = 1;
+          if (updater_ || optimizer_) {
+            int worker_num = group_size;
+            long long staleness =  // NOLINT(*)
+                entry.update_count_total - update_count_group[i] + 1;
+            if (staleness <= 0) staleness = 1;
+            num = worker_num * staleness;
+            ++entry.update_count_total;
+            update_count_group[i] = entry.update_count_total;
           }
-		  server->Response(req_meta);
-		  stored.WaitToRead();
-
-		  if(is_first_push) {
-			total_key_num = store_.size();
-			is_first_push = false;
-		  }
-
-		  if(req_meta.sender == straggler) {
-			++min_key_num;
-			if(min_key_num % total_key_num == 0) {
-			  min_iter_num = min_key_num / total_key_num;
-		      file.seekg(0, std::ios::beg);
-			  file << min_iter_num;
-			}
-		  }
-      } else {
-		// async push
-		if (updater_) { //
-		  // worker_num = ps::NumWorkers() - 1;
-		  // staleness = update_count_total[key] - update_count_worker[req_meta.sender][key] + 1;
-		  // if (staleness <= 0) staleness = 1;
-		  staleness = 1;
-		  exec_.Exec([this, key, &recved, &stored](){
-		  	CHECK(updater_);
-		  	updater_(key, recved, &stored, staleness);
-		  });
-		  // ++update_count_total[key];
-		  } else {
-		   	// if no updater, just copy
-		   	CopyFromTo(recved, &stored);
-		  }
-		  server->Response(req_meta);
-		  stored.WaitToRead();
+          std::vector<Request> replies;
+          replies.swap(merged.request);
+          Apply(key, &entry, merged.array, num,
+                [this, key, e, req, replies]() {
+                  for (const auto& r : replies) {
+                    grouping_->OnReply(ps::Postoffice::IDtoRank(r.meta.sender), key);
+                  }
+                  FinishPush(key, e, req, true, replies, e->stored);
+                  // the group of each sender by the current plan reads the
+                  // update. the version it saw before is freed here if no
+                  // other group still reads it
+                  for (const auto& r : replies) {
+                    int rank = ps::Postoffice::IDtoRank(r.meta.sender);
+                    e->store_group[e->plan->group_of_rank[rank]] = e->latest;
+                  }
+                });
+        } else {
+          FinishPush(key, &entry, req, true, {}, merged.array);
         }
       } else {
-		if (sync_mode_ == kSyncByGroupMode) {
-          for (unsigned int i = 0; i < groups_count; ++i) {
-        	for (unsigned int j = 0; j < groups[i].size(); ++j) {
-        	  if (req_meta.sender == groups[i][j]) {
-        	    ps::KVPairs<real_t> response;
-        		CHECK(!store_group[i][key].is_none()) << "init " << key << " first";
-        		int len = store_group[i][key].shape()[0];
-        		response.keys = req_data.keys;
-        		response.lens = {len};
-        		response.vals.CopyFrom(static_cast<const float*>(store_group[i][key].data().dptr_), len);
-        		server->Response(req_meta, response);
-        		return;
-        	  }
-        	}
+        // stale synced or async push, applied immediately. the gradient is
+        // damped by its staleness, namely the number of updates on this key
+        // since the sender pulled it
+        Apply(key, &entry, recved, Staleness(entry, req_meta.sender),
+              [this, key, e, req]() {
+                ++e->update_count_total;
+                FinishPush(key, e, req, true, {req}, e->stored);
+              });
+      }
+    } else {
+      // pull
+      CHECK(!stored.is_none()) << "init " << key << " first";
+      std::shared_ptr<const NDArray> src = entry.latest;
+      if (sync_mode_ == kSyncByGroupMode) {
+        int i = entry.plan->group_of_rank[
+            ps::Postoffice::IDtoRank(req_meta.sender)];
+        src = entry.store_group[i];
+      }
+      ps::KVPairs<real_t> response;
+      int len = src->shape()[0];
+      response.keys = req_data.keys;
+      if (req_meta.cmd == kRowSparsePull) {
+        const auto& ranges = entry.pull_ranges[req_meta.sender];
+        int n = static_cast<int>(RangesSize(ranges));
+        response.lens = {n};
+        response.vals.resize(n);
+        GatherRanges(static_cast<const real_t*>(src->data().dptr_), ranges,
+                     response.vals.data());
+        Respond(req, server, response);
+        entry.update_count_worker[req_meta.sender] = entry.update_count_total;
+        return;
+      }
+      if (req_meta.cmd == kShmPull) {
+        // the values follow the pushed ones in the memory shared with the
+        // sender, the message carries a placeholder only
+        size_t buf_len;
+        real_t* buf = CHECK_NOTNULL(shm_)->ServerBuffer(
+            ps::Postoffice::IDtoRank(req_meta.sender), req_data.keys[0], &buf_len);
+        CHECK_EQ(buf_len, static_cast<size_t>(len));
+        std::memcpy(buf + len, src->data().dptr_, len * sizeof(real_t));
+        response.lens = {1};
+        response.vals = {0};
+        Respond(req, server, response);
+        entry.update_count_worker[req_meta.sender] = entry.update_count_total;
+        return;
+      }
+      if (req_meta.cmd == kCompressedPull) {
+        // the stored weights stay in full precision, only the copy sent is
+        // rounded
+        CHECK(compression_.compresses_pull());
+        int clen = compression_.CompressedSize(len);
+        response.lens = {clen};
+        response.vals.resize(clen);
+        compression_.CompressWeights(static_cast<const real_t*>(src->data().dptr_),
+                                     len, response.vals.data());
+        Respond(req, server, response);
+        entry.update_count_worker[req_meta.sender] = entry.update_count_total;
+        return;
+      }
+      response.lens = {len};
+      // send the version without copying. the response holds a reference
+      // until ps-lite has sent it, so the next update copies on write
+      // instead of overwriting it
+      response.vals.reset(static_cast<real_t*>(src->data().dptr_), len,
+                          [src](real_t*) { });
+      Respond(req, server, response);
+      entry.update_count_worker[req_meta.sender] = entry.update_count_total;
+    }
+  }
+
+  /**
+   * \brief set up the states of \a key derived from \a stored, once it is
+   * initialized
+   */
+  void InitEntry(int key, KeyEntry* entry) {
+    clock_.AddKey(key);
+    entry->latest = std::make_shared<NDArray>(entry->stored);
+    if (sync_mode_ == kSyncByGroupMode) {
+      // all groups start with the same version
+      entry->plan = grouping_->plan();
+      size_t num_groups = entry->plan->members.size();
+      entry->store_group.assign(num_groups, entry->latest);
+      entry->merge_buf_of_group.resize(num_groups);
+      entry->update_count_group.assign(num_groups, entry->update_count_total);
+    }
+  }
+
+  /**
+   * \brief restore the keys saved if this server replaces a failed one, and
+   * start saving them. called once ps-lite knows the rank of this server
+   */
+  void StartCheckpoint() {
+    std::string dir = dmlc::GetEnv("MXNET_KVSTORE_CHECKPOINT_DIR", std::string());
+    if (dir.empty()) return;
+    int interval = dmlc::GetEnv("MXNET_KVSTORE_CHECKPOINT_INTERVAL", 600);
+    checkpoint_.reset(new ServerCheckpoint(dir, ps::MyRank(), interval));
+    if (ps::Postoffice::Get()->is_recovery()) Restore();
+    checkpoint_->Start();
+  }
+
+  /**
+   * \brief queue a snapshot of \a entry of \a key, once per round of the
+   * checkpoint. called by the thread owning \a key, after a push on it
+   */
+  void Snapshot(int key, KeyEntry* entry) {
+    int64_t round = checkpoint_->round();
+    if (entry->checkpoint_round == round) return;
+    entry->checkpoint_round = round;
+    KeySnapshot snap;
+    // the next update copies the value on write while it is referenced here
+    snap.value = entry->latest;
+    snap.update_count = entry->update_count_total;
+    for (const auto& it : entry->update_count_worker) {
+      snap.senders.push_back(it.first);
+      snap.sender_update_counts.push_back(it.second);
+    }
+    if (optimizer_) optimizer_->GetState(key, &snap.states, &snap.counters);
+    checkpoint_->Save(key, std::move(snap));
+  }
+
+  /**
+   * \brief load the configuration and the keys saved by the failed server
+   * this one replaces. the pushes merged partially when it failed are lost.
+   *
+   * the clocks of the workers restart from 0 on the keys restored, and each
+   * worker's clock is lifted to its iteration by the first \ref kWaitForClock
+   * it sends. the staleness of pushes is kept, by the update counts pulled
+   * by each worker which are saved with the keys
+   */
+  void Restore() {
+    std::string config;
+    if (!checkpoint_->LoadConfig(&config)) {
+      LOG(WARNING) << "server " << ps::MyRank() << " has no checkpoint to restore";
+      return;
+    }
+    DecodeConfig(config);
+    std::vector<int> keys = checkpoint_->SavedKeys();
+    for (int key : keys) {
+      KeySnapshot snap;
+      checkpoint_->Load(key, &snap);
+      auto& entry = GetKeyEntry(key);
+      entry.stored = *snap.value;
+      entry.update_count_total = snap.update_count;
+      for (size_t i = 0; i < snap.senders.size(); ++i) {
+        entry.update_count_worker[snap.senders[i]] = snap.sender_update_counts[i];
+      }
+      InitEntry(key, &entry);
+      if (optimizer_) {
+        optimizer_->SetState(key, entry.stored, snap.states, snap.counters);
+      }
+    }
+    unlifted_.assign(ps::NumWorkers(), true);
+    LOG(INFO) << "server " << ps::MyRank() << " restored " << keys.size() << " keys";
+  }
+
+  /**
+   * \brief encode the configuration set by the commands of the workers,
+   * decoded by \ref DecodeConfig
+   */
+  std::string EncodeConfig() {
+    std::string str;
+    dmlc::MemoryStringStream strm(&str);
+    strm.Write(sync_mode_);
+    strm.Write(num_groups_);
+    strm.Write(grouping_ ? grouping_->EncodePlan() : std::string());
+    strm.Write(compression_.EncodeParams());
+    strm.Write(optimizer_config_);
+    std::vector<int> senders, counts;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      for (const auto& it : host_workers_) {
+        senders.push_back(it.first);
+        counts.push_back(it.second);
+      }
+    }
+    strm.Write(senders);
+    strm.Write(counts);
+    uint64_t num_commands = commands_.size();
+    strm.Write(num_commands);
+    for (const auto& cmd : commands_) {
+      strm.Write(cmd.first);
+      strm.Write(cmd.second);
+    }
+    return str;
+  }
+
+  /**
+   * \brief apply the configuration \a str, and run the controller commands
+   * in it again
+   */
+  void DecodeConfig(std::string str) {
+    dmlc::MemoryStringStream strm(&str);
+    std::string group_plan, compression;
+    std::vector<int> senders, counts;
+    uint64_t num_commands;
+    CHECK(strm.Read(&sync_mode_) && strm.Read(&num_groups_) &&
+          strm.Read(&group_plan) && strm.Read(&compression) &&
+          strm.Read(&optimizer_config_) && strm.Read(&senders) &&
+          strm.Read(&counts) && strm.Read(&num_commands) &&
+          senders.size() == counts.size())
+        << "invalid server configuration";
+    if (sync_mode_ == kSyncByGroupMode) {
+      grouping_.reset(new WorkerGrouping(ps::NumWorkers(), num_groups_));
+      // the servers not restored go on with this plan
+      if (!group_plan.empty()) grouping_->Adopt(group_plan);
+    }
+    compression_.DecodeParams(compression);
+    if (!optimizer_config_.empty()) {
+      optimizer_.reset(new ServerOptimizer(optimizer_config_));
+    }
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      for (size_t i = 0; i < senders.size(); ++i) host_workers_[senders[i]] = counts[i];
+    }
+    for (uint64_t i = 0; i < num_commands; ++i) {
+      std::pair<int, std::string> cmd;
+      CHECK(strm.Read(&cmd.first) && strm.Read(&cmd.second))
+          << "invalid server configuration";
+      commands_.push_back(cmd);
+      exec_.Exec([this, cmd]() {
+        CHECK(controller_);
+        controller_(cmd.first, cmd.second);
+      });
+    }
+  }
+
+  /**
+   * \brief update the stored value of \a entry of \a key by \a grad, the
+   * sum of \a num gradients or a gradient damped by \a num, or overwrite it
+   * by \a grad if there is no updater. \a then is called by the thread
+   * owning \a key once the update is pushed to the engine.
+   *
+   * the C++ optimizer runs on the calling thread, so keys owned by different
+   * threads are updated in parallel. updater_ runs on the main thread, which
+   * is necessary for python, while the owner thread goes on with other keys.
+   * it is given the slice key, so that each slice keeps its own states, and
+   * the python optimizer looks up the multipliers of the array of the slice.
+   * the requests on \a key received meanwhile wait in \a entry until \a then
+   * is called
+   */
+  void Apply(int key, KeyEntry* entry, const NDArray& grad, int num,
+             std::function<void()>&& then) {
+    CopyOnWrite(entry);
+    if (optimizer_) {
+      optimizer_->Update(key, ArrayKey(key), grad, &entry->stored, num);
+    } else if (updater_) {
+      entry->updating = true;
+      exec_.Post([this, key, entry, grad, num, then]() {
+          updater_(key, grad, &entry->stored, num);
+          shards_.Exec(key, [this, key, entry, then]() {
+              entry->updating = false;
+              then();
+              // the requests received during the update, until one of them
+              // updates again
+              while (!entry->updating && !entry->waiting.empty()) {
+                Request req = std::move(entry->waiting.front());
+                entry->waiting.pop();
+                DataHandleKey(key, req, ps_server_);
+              }
+            });
+        });
+      return;
+    } else {
+      CopyFromTo(grad, &entry->stored);
+    }
+    then();
+  }
+
+  /**
+   * \brief merge row sparse push \a req on \a key into the merge buffer of
+   * \a entry, which only costs the rows pushed. in sync mode the rows merged
+   * from all workers are updated at once, otherwise the rows pushed are
+   * updated right away
+   */
+  void RowSparsePush(int key, KeyEntry* entry, const Request& req) {
+    CHECK_NE(sync_mode_, kSyncByGroupMode)
+        << "row sparse push does not support group sync mode";
+    const auto& vals = req.data.vals;
+    std::vector<Range> ranges;
+    size_t header = DecodeRanges(vals.data(), req.data.lens[0],
+                                 entry->stored.shape()[0], &ranges);
+    CHECK_EQ(header + RangesSize(ranges), static_cast<size_t>(req.data.lens[0]))
+        << "invalid row sparse push";
+    auto& merged = entry->merge_buf;
+    if (merged.array.is_none()) {
+      merged.array = NDArray(entry->stored.shape(), Context());
+    }
+    if (merged.request.empty()) {
+      // clear what the last merge left
+      NDArray array = merged.array;
+      if (merged.dense) {
+        array = 0.0f;
+      } else {
+        std::vector<Range> last = merged.ranges;
+        Engine::Get()->PushSync([array, last](RunContext ctx) {
+            real_t* dptr = static_cast<real_t*>(array.data().dptr_);
+            for (const auto& r : last) std::fill(dptr + r.first, dptr + r.first + r.second, 0);
+          }, array.ctx(), {}, {array.var()}, FnProperty::kNormal);
+      }
+      merged.dense = false;
+      merged.ranges.clear();
+    }
+    // the values stay in the received message, referenced until added
+    NDArray array = merged.array;
+    ps::SArray<real_t> values = vals.segment(header, vals.size());
+    Engine::Get()->PushSync([array, values, ranges](RunContext ctx) {
+        AddRanges(values.data(), ranges, static_cast<real_t*>(array.data().dptr_));
+      }, array.ctx(), {}, {array.var()}, FnProperty::kNormal);
+    merged.ranges = UnionRanges(merged.ranges, ranges);
+
+    KeyEntry* e = entry;
+    if (sync_mode_ == kSyncMode) {
+      merged.request.push_back(req);
+      merged.num_workers += HostWorkers(req.meta.sender);
+      if (merged.num_workers < ps::NumWorkers()) {
+        FinishPush(key, entry, req, true, {}, merged.array);
+        return;
+      }
+      std::vector<Request> replies;
+      replies.swap(merged.request);
+      merged.num_workers = 0;
+      ApplyMerged(key, entry, ps::NumWorkers(), [this, key, e, req, replies]() {
+          FinishPush(key, e, req, true, replies, e->stored);
+        });
+    } else {
+      ApplyMerged(key, entry, Staleness(*entry, req.meta.sender),
+                  [this, key, e, req]() {
+                    ++e->update_count_total;
+                    FinishPush(key, e, req, true, {req}, e->stored);
+                  });
+    }
+  }
+
+  /**
+   * \brief apply the merge buffer of \a entry as \ref Apply does. if only
+   * row sparse pushes were merged, the C++ optimizer updates only their
+   * rows, leaving the states of the others as they are, and without updater
+   * only these rows are overwritten. updater_ is given the whole buffer
+   */
+  void ApplyMerged(int key, KeyEntry* entry, int num, std::function<void()>&& then) {
+    auto& merged = entry->merge_buf;
+    if (merged.dense || (updater_ && !optimizer_)) {
+      Apply(key, entry, merged.array, num, std::move(then));
+      return;
+    }
+    CopyOnWrite(entry);
+    if (optimizer_) {
+      optimizer_->UpdateRanges(key, ArrayKey(key), merged.array, merged.ranges,
+                               &entry->stored, num);
+    } else {
+      NDArray from = merged.array, to = entry->stored;
+      std::vector<Range> ranges = merged.ranges;
+      Engine::Get()->PushSync([from, to, ranges](RunContext ctx) {
+          const real_t* src = static_cast<const real_t*>(from.data().dptr_);
+          real_t* dst = static_cast<real_t*>(to.data().dptr_);
+          for (const auto& r : ranges) {
+            std::copy(src + r.first, src + r.first + r.second, dst + r.first);
           }
-		} else {
-		  ps::KVPairs<real_t> response;
-		  CHECK(!stored.is_none()) << "init " << key << " first";
-		  int len = stored.shape()[0];
-		  response.keys = req_data.keys;
-		  response.lens = {len};
-		  response.vals.CopyFrom(static_cast<const float*>(stored.data().dptr_), len);
-		  server->Response(req_meta, response);
-		  update_count_worker[req_meta.sender][key] = update_count_total[key];
-		}
+        }, to.ctx(), {from.var()}, {to.var()}, FnProperty::kNormal);
+    }
+    then();
+  }
+
+  /**
+   * \brief finish push \a req on \a key after the value it merges into or
+   * updates is pushed to the engine: respond to \a replies, wait for \a
+   * wait, and tick the clock unless \a req is the initialization.
+   *
+   * the values of an in-place push are read from the memory shared with the
+   * sender, which may overwrite them once responded. so it is responded only
+   * after \a wait, which depends on all operators reading them
+   */
+  void FinishPush(int key, KeyEntry* entry, const Request& req, bool tick,
+                  const std::vector<Request>& replies, const NDArray& wait) {
+    const bool in_place = req.meta.cmd == kShmPush;
+    bool deferred = false;
+    for (const auto& r : replies) {
+      if (in_place && r.meta.sender == req.meta.sender &&
+          r.meta.timestamp == req.meta.timestamp && r.index == req.index) {
+        deferred = true;
+      } else {
+        Respond(r, ps_server_);
+      }
     }
+    wait.WaitToRead();
+    if (tick) clock_.Tick(ps::Postoffice::IDtoRank(req.meta.sender), key);
+    if (deferred) Respond(req, ps_server_);
+    if (checkpoint_) Snapshot(key, entry);
+  }
+
+  /**
+   * \brief the staleness of a push from \a sender, one plus the number of
+   * updates applied since \a sender pulled this key
+   */
+  static int Staleness(const KeyEntry& entry, int sender) {
+    auto it = entry.update_count_worker.find(sender);
+    long long int seen = it == entry.update_count_worker.end() ? 0 : it->second;  // NOLINT(*)
+    long long int staleness = entry.update_count_total - seen + 1;  // NOLINT(*)
+    return staleness <= 0 ? 1 : static_cast<int>(staleness);
+  }
+
+  /**
+   * \brief the number of workers the pushes of \a sender stand for. a worker
+   * pushing for its host tells it by \a kSetHostWorkers, others push for
+   * themselves only
+   */
+  int HostWorkers(int sender) {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = host_workers_.find(sender);
+    return it == host_workers_.end() ? 1 : it->second;
   }
 
   int DecodeKey(ps::Key key) {
@@ -439,42 +1154,97 @@ class KVStoreDistServer {
     return key - kr.begin();
   }
 
+  /**
+   * \brief switch \a entry to the latest group plan, at the first push after
+   * it is made. the groups of the old plan with a partial merge finish their
+   * round by the old plan, so no push is merged across plans, and a key
+   * switches again once they all did. each new group starts from the stored
+   * value.
+   */
+  void AdoptGroupPlan(KeyEntry* entry) {
+    if (entry->old_plan) {
+      for (const auto& merged : entry->old_merge_buf_of_group) {
+        if (!merged.request.empty()) return;
+      }
+      entry->old_plan.reset();
+      entry->old_merge_buf_of_group.clear();
+      entry->old_update_count_group.clear();
+    }
+    auto plan = grouping_->plan();
+    if (entry->plan == plan) return;
+    size_t num_groups = plan->members.size();
+    entry->old_plan = entry->plan;
+    entry->old_merge_buf_of_group.swap(entry->merge_buf_of_group);
+    entry->old_update_count_group.swap(entry->update_count_group);
+    entry->plan = plan;
+    entry->merge_buf_of_group.resize(num_groups);
+    entry->update_count_group.assign(num_groups, entry->update_count_total);
+    entry->store_group.assign(num_groups, entry->latest);
+  }
+
+  /**
+   * \brief make \a stored writable without changing the versions being read.
+   * \a stored is copied into a new version only if some group or pending pull
+   * response still reads the latest one, otherwise it is updated in place.
+   */
+  void CopyOnWrite(KeyEntry* entry) {
+    if (entry->latest.unique()) return;
+    NDArray copy(entry->stored.shape(), Context());
+    CopyFromTo(entry->stored, &copy, 0);
+    entry->stored = copy;
+    entry->latest = std::make_shared<NDArray>(copy);
+  }
+
+  /**
+   * \brief return the entry of \a key, create it if not exists. threadsafe.
+   * the returned reference is stable since entries are never erased.
+   */
+  KeyEntry& GetKeyEntry(int key) {
+    std::lock_guard<std::mutex> lk(mu_);
+    return entries_[key];
+  }
+
   /**
    * \brief user defined
    */
   int sync_mode_; //yegeyan 2016.10.6
+  int max_delay_;
   KVStore::Controller controller_;
   KVStore::Updater updater_;
 
-  std::unordered_map<int, NDArray> store_;
+  /// \brief states of all keys, guarded by mu_
+  std::unordered_map<int, KeyEntry> entries_;
+  /// \brief workers pushing for their hosts by node id, guarded by mu_
+  std::unordered_map<int, int> host_workers_;
+  std::mutex mu_;
+
+  /// \brief decompresses pushed gradients
+  GradientCompression compression_;
+  /// \brief memory shared with the workers on this host, null if disabled
+  std::unique_ptr<ShmTransport> shm_;
+  /// \brief the C++ optimizer replacing updater_, set before any push
+  std::unique_ptr<ServerOptimizer> optimizer_;
+  /// \brief groups of workers, for group sync mode
+  std::unique_ptr<WorkerGrouping> grouping_;
+  /// \brief the number of groups of group sync mode
+  int num_groups_ = 1;
+  /// \brief the configuration of optimizer_, empty if none
+  std::string optimizer_config_;
+  /// \brief the controller commands received, in order
+  std::vector<std::pair<int, std::string>> commands_;
+  /// \brief snapshots of the keys, null if disabled
+  std::unique_ptr<ServerCheckpoint> checkpoint_;
+  /// \brief the workers whose clocks a restored server has not lifted yet,
+  /// empty if not restored
+  std::vector<bool> unlifted_;
+  std::once_flag checkpoint_once_;
+
+  /// \brief iteration clocks of workers, for stale sync mode
+  VectorClock clock_;
 
-  std::vector<std::unordered_map<int, NDArray>> store_group;
-  struct MergeBuf {
-    std::vector<ps::KVMeta> request;
-    NDArray array;
-  };
-  std::unordered_map<int, MergeBuf> merge_buf_;
-  std::vector<std::unordered_map<int, MergeBuf>> merge_buf_of_group;
-  std::string group_filename;
-  std::ifstream group_file;
-  std::vector<std::vector<int>> groups;
-  unsigned int groups_count;
-  int worker_num;
-
-  std::string miniters_filename;
-  std::fstream file;
-  static long long int min_key_num;
-  static long long int min_iter_num;
-  static int total_key_num;
-  bool is_first_push;
-  std::set<int> keys;
-  int straggler;
-
-  std::unordered_map<int, long long int> update_count_total;
-  std::unordered_map<int, std::unordered_map<int, long long int>> update_count_worker;
-  std::unordered_map<int, std::unordered_map<int, long long int>> update_count_group;
-  long long int staleness;
   Executor exec_;
+  /// \brief threads merging and updating keys in parallel
+  KeyShardExecutor shards_;
 
   ps::KVServer<float>* ps_server_;
 
@@ -485,11 +1255,7 @@ class KVStoreDistServer {
   long long int update_flag;
 };
 
-long long int KVStoreDistServer::min_key_num = 0;
-long long int KVStoreDistServer::min_iter_num = 0;
-int KVStoreDistServer::total_key_num = 0;
-
 }  // namespace kvstore
 }  // namespace mxnet
 
-#endif  // MXNET_KVSTORE_KVSTORE_DIST_SERVER_H_
\ No newline at end of file
+#endif  // MXNET_KVSTORE_KVSTORE_DIST_SERVER_H_
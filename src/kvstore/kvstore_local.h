@@ -13,6 +13,7 @@
 #include <utility>
 #include <algorithm>
 #include "./comm.h"
+#include "./row_sparse.h"
 
 namespace mxnet {
 namespace kvstore {
@@ -87,7 +88,65 @@ class KVStoreLocal : public KVStore {
     }
   }
 
+  void PushRowSparse(const std::vector<int>& keys,
+                     const std::vector<NDArray>& values,
+                     const std::vector<NDArray>& row_ids,
+                     int priority) override {
+    // the whole values are pushed, with the rows not meant zeroed
+    CHECK_EQ(values.size(), row_ids.size());
+    std::vector<NDArray> masked(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+      masked[i] = NDArray(values[i].shape(), pinned_ctx_);
+      CopyRows(values[i], row_ids[i], &masked[i], true, priority);
+      if (values[i].ctx() != pinned_ctx_) {
+        masked[i] = masked[i].Copy(values[i].ctx());
+      }
+    }
+    Push(keys, masked, priority);
+  }
+
+  void PullRowSparse(const std::vector<int>& keys,
+                     const std::vector<NDArray*>& values,
+                     const std::vector<NDArray>& row_ids,
+                     int priority) override {
+    CHECK_EQ(keys.size(), values.size());
+    CHECK_EQ(values.size(), row_ids.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      const NDArray& local = local_[keys[i]];
+      CHECK(!local.is_none()) << "key " << keys[i] << " has not been inited";
+      CopyRows(local, row_ids[i], values[i], false, priority);
+    }
+  }
+
  protected:
+  /**
+   * \brief copy the rows \a row_ids of \a src into \a dst of the same shape,
+   * and zero the other rows of \a dst if \a zero. the rows are copied on cpu
+   */
+  void CopyRows(const NDArray& src, const NDArray& row_ids, NDArray* dst,
+                bool zero, int priority) {
+    CHECK_EQ(src.shape(), dst->shape());
+    auto on_cpu = [this](const NDArray& arr) {
+      return arr.ctx().dev_mask() == cpu::kDevMask ? arr : arr.Copy(pinned_ctx_);
+    };
+    NDArray from = on_cpu(src), ids = on_cpu(row_ids), to = on_cpu(*dst);
+    auto copy = [from, ids, to, zero](RunContext rctx) {
+      size_t num_rows = from.shape()[0];
+      size_t width = from.shape().Size() / num_rows;
+      auto rows = UniqueRows(static_cast<const real_t*>(ids.data().dptr_),
+                             ids.shape().Size(), num_rows);
+      const real_t* src = static_cast<const real_t*>(from.data().dptr_);
+      real_t* dst = static_cast<real_t*>(to.data().dptr_);
+      if (zero) std::fill(dst, dst + from.shape().Size(), 0);
+      for (size_t r : rows) {
+        std::copy(src + r * width, src + (r + 1) * width, dst + r * width);
+      }
+    };
+    Engine::Get()->PushSync(copy, to.ctx(), {from.var(), ids.var()}, {to.var()},
+                            FnProperty::kNormal, priority);
+    if (dst->ctx().dev_mask() != cpu::kDevMask) CopyFromTo(to, dst, priority);
+  }
+
   /**
    * \brief group values on keys
    */
@@ -0,0 +1,115 @@
+/**
+ * Copyright (c) 2016 by Contributors
+ * @file   priority_sender.h
+ * @brief  send messages by priority, keeping a bounded amount in flight
+ */
+#ifndef MXNET_KVSTORE_PRIORITY_SENDER_H_
+#define MXNET_KVSTORE_PRIORITY_SENDER_H_
+#include <dmlc/logging.h>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief a send queue ordered by priority.
+ *
+ * Messages queued are sent from the most urgent one, and in the order queued
+ * among equal priorities. At most \a window values are in flight, so that a
+ * message queued later with a higher priority overtakes the ones waiting
+ * instead of queuing behind them on the network. A message larger than the
+ * window is sent alone.
+ */
+class PrioritySender {
+ public:
+  typedef std::function<void()> Callback;
+  /**
+   * \brief issue a message, and call the argument once it is done
+   */
+  typedef std::function<void(const Callback&)> Send;
+
+  explicit PrioritySender(size_t window) : window_(window) {
+    thread_ = std::thread([this]() { Run(); });
+  }
+
+  /**
+   * \brief send the queued messages and stop
+   */
+  ~PrioritySender() {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      stop_ = true;
+    }
+    cond_.notify_one();
+    thread_.join();
+  }
+
+  /**
+   * \brief queue \a send of \a size values with \a priority, a larger one is
+   * more urgent. threadsafe
+   */
+  void Add(int priority, size_t size, const Send& send) {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      queue_.push(Item{priority, seq_++, size, send});
+    }
+    cond_.notify_one();
+  }
+
+ private:
+  struct Item {
+    int priority;
+    uint64_t seq;
+    size_t size;
+    Send send;
+    bool operator<(const Item& other) const {
+      return priority != other.priority ? priority < other.priority
+                                        : seq > other.seq;
+    }
+  };
+
+  void Run() {
+    std::unique_lock<std::mutex> lk(mu_);
+    while (true) {
+      cond_.wait(lk, [this]() {
+          return (stop_ && queue_.empty()) ||
+              (!queue_.empty() &&
+               (inflight_ == 0 || inflight_ + queue_.top().size <= window_));
+        });
+      if (queue_.empty()) break;
+      Item item = queue_.top();
+      queue_.pop();
+      inflight_ += item.size;
+      lk.unlock();
+      size_t size = item.size;
+      item.send([this, size]() {
+          {
+            std::lock_guard<std::mutex> lk(mu_);
+            inflight_ -= size;
+          }
+          cond_.notify_one();
+        });
+      lk.lock();
+    }
+  }
+
+  size_t window_;
+  std::mutex mu_;
+  std::condition_variable cond_;
+  /// \brief guarded by mu_
+  std::priority_queue<Item> queue_;
+  uint64_t seq_ = 0;
+  /// \brief values sent but not done, guarded by mu_
+  size_t inflight_ = 0;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_PRIORITY_SENDER_H_
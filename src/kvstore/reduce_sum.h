@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) 2016 by Contributors
+ * @file   reduce_sum.h
+ * @brief  sum several cpu arrays in one pass
+ */
+#ifndef MXNET_KVSTORE_REDUCE_SUM_H_
+#define MXNET_KVSTORE_REDUCE_SUM_H_
+#include <mxnet/base.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(__CUDACC__)
+#define MXNET_KVSTORE_REDUCE_SIMD 1
+#include <immintrin.h>
+#else
+#define MXNET_KVSTORE_REDUCE_SIMD 0
+#endif
+
+namespace mxnet {
+namespace kvstore {
+namespace reduce {
+
+/**
+ * \brief out[i] = in[0][i] + in[1][i] + ... for i in [begin, end)
+ */
+inline void SumScalar(const std::vector<const real_t*>& in, real_t* out,
+                      size_t begin, size_t end) {
+  // add the inputs one by one on blocks fitting into L1, so every input is
+  // still read once from memory
+  const size_t kBlock = 2048;
+  for (size_t b = begin; b < end; b += kBlock) {
+    size_t e = std::min(end, b + kBlock);
+    const real_t* in_0 = in[0];
+    if (in_0 != out) std::copy(in_0 + b, in_0 + e, out + b);
+    for (size_t k = 1; k < in.size(); ++k) {
+      const real_t* in_k = in[k];
+      for (size_t i = b; i < e; ++i) out[i] += in_k[i];
+    }
+  }
+}
+
+#if MXNET_KVSTORE_REDUCE_SIMD
+/**
+ * \brief the scalar sum of element i, in the same order as the vector ones
+ */
+inline real_t SumAt(const std::vector<const real_t*>& in, size_t i) {
+  real_t s = in[0][i];
+  for (size_t k = 1; k < in.size(); ++k) s += in[k][i];
+  return s;
+}
+
+__attribute__((target("avx2")))
+inline void SumAVX2(const std::vector<const real_t*>& in, real_t* out,
+                    size_t begin, size_t end, bool stream) {
+  size_t i = begin;
+  if (stream) {
+    // streaming stores need aligned addresses
+    for (; i < end && (reinterpret_cast<uintptr_t>(out + i) & 31); ++i) {
+      out[i] = SumAt(in, i);
+    }
+  }
+  const size_t n = in.size();
+  const real_t* const* ptr = in.data();
+  for (; i + 8 <= end; i += 8) {
+    __m256 s = _mm256_loadu_ps(ptr[0] + i);
+    for (size_t k = 1; k < n; ++k) {
+      s = _mm256_add_ps(s, _mm256_loadu_ps(ptr[k] + i));
+    }
+    if (stream) {
+      _mm256_stream_ps(out + i, s);
+    } else {
+      _mm256_storeu_ps(out + i, s);
+    }
+  }
+  for (; i < end; ++i) out[i] = SumAt(in, i);
+  if (stream) _mm_sfence();
+}
+
+__attribute__((target("avx512f")))
+inline void SumAVX512(const std::vector<const real_t*>& in, real_t* out,
+                      size_t begin, size_t end, bool stream) {
+  size_t i = begin;
+  if (stream) {
+    for (; i < end && (reinterpret_cast<uintptr_t>(out + i) & 63); ++i) {
+      out[i] = SumAt(in, i);
+    }
+  }
+  const size_t n = in.size();
+  const real_t* const* ptr = in.data();
+  for (; i + 16 <= end; i += 16) {
+    __m512 s = _mm512_loadu_ps(ptr[0] + i);
+    for (size_t k = 1; k < n; ++k) {
+      s = _mm512_add_ps(s, _mm512_loadu_ps(ptr[k] + i));
+    }
+    if (stream) {
+      _mm512_stream_ps(out + i, s);
+    } else {
+      _mm512_storeu_ps(out + i, s);
+    }
+  }
+  for (; i < end; ++i) out[i] = SumAt(in, i);
+  if (stream) _mm_sfence();
+}
+
+/**
+ * \brief 2 if the cpu supports avx512f, 1 if avx2, 0 otherwise
+ */
+inline int SimdLevel() {
+  static const int level = __builtin_cpu_supports("avx512f") ? 2 :
+      (__builtin_cpu_supports("avx2") ? 1 : 0);
+  return level;
+}
+#endif  // MXNET_KVSTORE_REDUCE_SIMD
+
+}  // namespace reduce
+
+/**
+ * \brief out[i] = in[0][i] + in[1][i] + ... for i in [begin, end), reading
+ * every input once. \a out may be in[0].
+ *
+ * The widest vector instructions the cpu supports are picked at runtime.
+ * With \a stream, \a out is written by non-temporal stores bypassing the
+ * cache, which saves memory bandwidth for arrays larger than the cache.
+ */
+inline void ReduceSum(const std::vector<const real_t*>& in, real_t* out,
+                      size_t begin, size_t end, bool stream) {
+  if (in.empty() || begin >= end) return;
+#if MXNET_KVSTORE_REDUCE_SIMD
+  if (sizeof(real_t) == sizeof(float)) {
+    switch (reduce::SimdLevel()) {
+      case 2:
+        reduce::SumAVX512(in, out, begin, end, stream);
+        return;
+      case 1:
+        reduce::SumAVX2(in, out, begin, end, stream);
+        return;
+      default:
+        break;
+    }
+  }
+#endif  // MXNET_KVSTORE_REDUCE_SIMD
+  reduce::SumScalar(in, out, begin, end);
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_REDUCE_SUM_H_
@@ -0,0 +1,177 @@
+/**
+ * Copyright (c) 2016 by Contributors
+ * @file   row_sparse.h
+ * @brief  the rows of a matrix pushed and pulled alone, such as the rows of an
+ * embedding seen in a batch
+ */
+#ifndef MXNET_KVSTORE_ROW_SPARSE_H_
+#define MXNET_KVSTORE_ROW_SPARSE_H_
+#include <dmlc/logging.h>
+#include <mxnet/base.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief a range of elements of a flattened array, the offset of its first
+ * element and its length
+ */
+typedef std::pair<size_t, size_t> Range;
+
+/**
+ * \brief the sorted distinct rows among the \a n row ids \a ids, stored as
+ * real_t as the data of Embedding is. ids out of [0, \a num_rows) are dropped
+ */
+inline std::vector<size_t> UniqueRows(const real_t* ids, size_t n, size_t num_rows) {
+  std::vector<size_t> rows;
+  rows.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    if (ids[i] >= 0 && ids[i] < num_rows) rows.push_back(static_cast<size_t>(ids[i]));
+  }
+  std::sort(rows.begin(), rows.end());
+  rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+  return rows;
+}
+
+/**
+ * \brief the ranges of the sorted \a rows of \a width elements each, within
+ * the part [\a begin, \a end) of the flattened matrix. the offsets are from
+ * \a begin, and adjacent rows form a single range
+ */
+inline std::vector<Range> RowRanges(const std::vector<size_t>& rows, size_t width,
+                                    size_t begin, size_t end) {
+  std::vector<Range> ranges;
+  auto it = std::lower_bound(rows.begin(), rows.end(), begin / width);
+  for (; it != rows.end() && *it * width < end; ++it) {
+    size_t lo = std::max(*it * width, begin) - begin;
+    size_t hi = std::min((*it + 1) * width, end) - begin;
+    if (!ranges.empty() && ranges.back().first + ranges.back().second == lo) {
+      ranges.back().second += hi - lo;
+    } else {
+      ranges.emplace_back(lo, hi - lo);
+    }
+  }
+  return ranges;
+}
+
+/**
+ * \return the number of elements in \a ranges
+ */
+inline size_t RangesSize(const std::vector<Range>& ranges) {
+  size_t size = 0;
+  for (const auto& r : ranges) size += r.second;
+  return size;
+}
+
+/**
+ * \brief the union of the sorted disjoint \a a and \a b, sorted and disjoint
+ */
+inline std::vector<Range> UnionRanges(const std::vector<Range>& a,
+                                      const std::vector<Range>& b) {
+  std::vector<Range> all(a.size() + b.size()), ranges;
+  std::merge(a.begin(), a.end(), b.begin(), b.end(), all.begin());
+  for (const auto& r : all) {
+    if (!ranges.empty() && ranges.back().first + ranges.back().second >= r.first) {
+      size_t end = std::max(ranges.back().first + ranges.back().second, r.first + r.second);
+      ranges.back().second = end - ranges.back().first;
+    } else {
+      ranges.push_back(r);
+    }
+  }
+  return ranges;
+}
+
+/**
+ * \return the number of slots \ref EncodeRanges writes
+ */
+inline size_t RangesHeaderSize(const std::vector<Range>& ranges) {
+  return 1 + 2 * ranges.size();
+}
+
+/**
+ * \brief write \a ranges into \a out, each number as the bits of an uint32_t
+ * in a slot, so that they are sent ahead of the values
+ */
+inline void EncodeRanges(const std::vector<Range>& ranges, real_t* out) {
+  auto put = [&out](size_t x) {
+    CHECK_LE(x, std::numeric_limits<uint32_t>::max()) << "too many values on a server";
+    uint32_t u = static_cast<uint32_t>(x);
+    std::memcpy(out++, &u, sizeof(u));
+  };
+  put(ranges.size());
+  for (const auto& r : ranges) {
+    put(r.first);
+    put(r.second);
+  }
+}
+
+/**
+ * \brief read the ranges written by \ref EncodeRanges at the head of the \a
+ * n slots \a in, which must lie within [0, \a limit)
+ * \return the number of slots read
+ */
+inline size_t DecodeRanges(const real_t* in, size_t n, size_t limit,
+                           std::vector<Range>* ranges) {
+  auto get = [&in]() {
+    uint32_t u;
+    std::memcpy(&u, in++, sizeof(u));
+    return static_cast<size_t>(u);
+  };
+  CHECK_GE(n, 1U) << "no row sparse header";
+  size_t num = get();
+  CHECK_LE(1 + 2 * num, n) << "invalid row sparse header";
+  ranges->resize(num);
+  size_t end = 0;
+  for (auto& r : *ranges) {
+    r.first = get();
+    r.second = get();
+    CHECK(r.first >= end && r.first + r.second <= limit) << "invalid row sparse range";
+    end = r.first + r.second;
+  }
+  return 1 + 2 * num;
+}
+
+/**
+ * \brief copy \a ranges of \a src one after another into \a dst
+ */
+inline void GatherRanges(const real_t* src, const std::vector<Range>& ranges,
+                         real_t* dst) {
+  for (const auto& r : ranges) {
+    std::memcpy(dst, src + r.first, r.second * sizeof(real_t));
+    dst += r.second;
+  }
+}
+
+/**
+ * \brief copy \a src, the values of \a ranges one after another, into them in
+ * \a dst
+ */
+inline void ScatterRanges(const real_t* src, const std::vector<Range>& ranges,
+                          real_t* dst) {
+  for (const auto& r : ranges) {
+    std::memcpy(dst + r.first, src, r.second * sizeof(real_t));
+    src += r.second;
+  }
+}
+
+/**
+ * \brief add \a src, the values of \a ranges one after another, into them in
+ * \a dst
+ */
+inline void AddRanges(const real_t* src, const std::vector<Range>& ranges,
+                      real_t* dst) {
+  for (const auto& r : ranges) {
+    real_t* d = dst + r.first;
+    for (size_t i = 0; i < r.second; ++i) d[i] += src[i];
+    src += r.second;
+  }
+}
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_ROW_SPARSE_H_
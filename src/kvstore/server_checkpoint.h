@@ -0,0 +1,266 @@
+/**
+ * Copyright (c) 2016 by Contributors
+ * @file   server_checkpoint.h
+ * @brief  save the keys of a server to local disk while it keeps serving
+ */
+#ifndef MXNET_KVSTORE_SERVER_CHECKPOINT_H_
+#define MXNET_KVSTORE_SERVER_CHECKPOINT_H_
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#include <mxnet/ndarray.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief the state of a key at some point, as saved to disk
+ */
+struct KeySnapshot {
+  /// \brief the stored value, not written by the server while referenced
+  std::shared_ptr<const NDArray> value;
+  /// \brief the number of updates applied to the value
+  int64_t update_count = 0;
+  /// \brief the senders which pulled the key, and the number of updates
+  /// applied to the value each of them pulled last
+  std::vector<int> senders;
+  std::vector<int64_t> sender_update_counts;
+  /// \brief copies of the optimizer states of the key
+  std::vector<NDArray> states;
+  /// \brief the integer optimizer states of the key
+  std::vector<int> counters;
+};
+
+/**
+ * \brief periodic snapshots of the keys of a server, kept in a directory of
+ * its own with a file per key.
+ *
+ * Every interval starts a new round. A key is captured by the thread owning
+ * it, the next time it is pushed in a round, so that capturing needs no
+ * locking and never pauses the other keys. Capturing only takes a reference
+ * to the stored version, which the server copies on its next write instead
+ * of overwriting, and queues copies of the optimizer states. A thread of the
+ * checkpoint waits for them and writes the files, replacing the previous
+ * file of the key at once by a rename. Keys not pushed during a round keep
+ * the file of an earlier round, which is still their latest state.
+ *
+ * The configuration of the server, set by the commands of the workers, is
+ * saved beside the keys, since a restarted server does not receive them
+ * again.
+ */
+class ServerCheckpoint {
+ public:
+  /**
+   * \brief save into \a dir, under a directory of server \a rank, every \a
+   * interval seconds
+   */
+  ServerCheckpoint(const std::string& dir, int rank, int interval)
+      : interval_(interval) {
+    mkdir(dir.c_str(), 0755);
+    dir_ = dir + "/server-" + std::to_string(rank);
+    mkdir(dir_.c_str(), 0755);
+    struct stat st;
+    CHECK(stat(dir_.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+        << "cannot create the checkpoint directory " << dir_;
+    CHECK_GT(interval_, 0);
+  }
+
+  ~ServerCheckpoint() { Stop(); }
+
+  /**
+   * \brief start the rounds of snapshots
+   */
+  void Start() {
+    CHECK(!thread_.joinable()) << "already started";
+    thread_ = std::thread([this]() { Run(); });
+  }
+
+  /**
+   * \brief write the snapshots queued and stop
+   */
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      stop_ = true;
+    }
+    cond_.notify_one();
+    if (thread_.joinable()) thread_.join();
+  }
+
+  /**
+   * \return the current round, which starts at 0 with no snapshot due
+   */
+  int64_t round() const { return round_.load(std::memory_order_relaxed); }
+
+  /**
+   * \brief queue the snapshot \a snap of \a key to be written. threadsafe
+   */
+  void Save(int key, KeySnapshot&& snap) {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      queue_.emplace(key, std::move(snap));
+    }
+    cond_.notify_one();
+  }
+
+  /**
+   * \brief save the configuration \a config of the server right away.
+   * threadsafe
+   */
+  void SaveConfig(const std::string& config) {
+    std::lock_guard<std::mutex> lk(file_mu_);
+    std::string path = dir_ + "/config";
+    {
+      std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create((path + ".tmp").c_str(), "w"));
+      uint64_t magic = kMagic;
+      fo->Write(magic);
+      fo->Write(config);
+    }
+    Commit(path);
+  }
+
+  /**
+   * \brief load the configuration saved
+   * \return false if nothing was saved
+   */
+  bool LoadConfig(std::string* config) const {
+    std::string path = dir_ + "/config";
+    std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(path.c_str(), "r", true));
+    if (!fi) return false;
+    uint64_t magic;
+    CHECK(fi->Read(&magic) && magic == kMagic && fi->Read(config))
+        << "invalid checkpoint " << path;
+    return true;
+  }
+
+  /**
+   * \return the keys saved
+   */
+  std::vector<int> SavedKeys() const {
+    std::vector<int> keys;
+    DIR* dir = opendir(dir_.c_str());
+    if (dir == nullptr) return keys;
+    while (struct dirent* ent = readdir(dir)) {
+      std::string name = ent->d_name;
+      const std::string suffix = ".params";
+      if (name.size() > suffix.size() &&
+          name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+        keys.push_back(std::stoi(name));
+      }
+    }
+    closedir(dir);
+    return keys;
+  }
+
+  /**
+   * \brief load the snapshot of \a key into \a snap
+   */
+  void Load(int key, KeySnapshot* snap) const {
+    std::string path = KeyPath(key);
+    std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(path.c_str(), "r"));
+    uint64_t magic, num_states;
+    int saved_key;
+    std::shared_ptr<NDArray> value = std::make_shared<NDArray>();
+    CHECK(fi->Read(&magic) && magic == kMagic && fi->Read(&saved_key) &&
+          saved_key == key && fi->Read(&snap->update_count) && fi->Read(&snap->senders) &&
+          fi->Read(&snap->sender_update_counts) &&
+          snap->senders.size() == snap->sender_update_counts.size() &&
+          value->Load(fi.get()) && fi->Read(&num_states))
+        << "invalid checkpoint " << path;
+    snap->value = value;
+    snap->states.resize(num_states);
+    for (auto& s : snap->states) {
+      CHECK(s.Load(fi.get())) << "invalid checkpoint " << path;
+    }
+    CHECK(fi->Read(&snap->counters)) << "invalid checkpoint " << path;
+  }
+
+ private:
+  static const uint64_t kMagic = 0x4d584b5643503033;  // MXKVCP03
+
+  std::string KeyPath(int key) const {
+    return dir_ + "/" + std::to_string(key) + ".params";
+  }
+
+  /// \brief replace \a path by the file written to its ".tmp"
+  void Commit(const std::string& path) {
+    std::string tmp = path + ".tmp";
+    CHECK_EQ(std::rename(tmp.c_str(), path.c_str()), 0)
+        << "rename " << tmp << " failed: " << strerror(errno);
+  }
+
+  void Write(int key, const KeySnapshot& snap) {
+    // the copies of the states are queued by the engine
+    for (const auto& s : snap.states) s.WaitToRead();
+    std::lock_guard<std::mutex> lk(file_mu_);
+    std::string path = KeyPath(key);
+    {
+      std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create((path + ".tmp").c_str(), "w"));
+      uint64_t magic = kMagic;
+      fo->Write(magic);
+      fo->Write(key);
+      fo->Write(snap.update_count);
+      fo->Write(snap.senders);
+      fo->Write(snap.sender_update_counts);
+      snap.value->Save(fo.get());
+      uint64_t num_states = snap.states.size();
+      fo->Write(num_states);
+      for (const auto& s : snap.states) s.Save(fo.get());
+      fo->Write(snap.counters);
+    }
+    Commit(path);
+  }
+
+  void Run() {
+    auto next = std::chrono::steady_clock::now() + std::chrono::seconds(interval_);
+    std::unique_lock<std::mutex> lk(mu_);
+    while (true) {
+      cond_.wait_until(lk, next, [this]() { return stop_ || !queue_.empty(); });
+      if (!queue_.empty()) {
+        auto item = std::move(queue_.front());
+        queue_.pop();
+        lk.unlock();
+        // the stored version is released once written, so that the server
+        // writes it in place again
+        Write(item.first, item.second);
+        item.second = KeySnapshot();
+        lk.lock();
+      } else if (stop_) {
+        break;
+      }
+      auto now = std::chrono::steady_clock::now();
+      if (now >= next) {
+        round_.fetch_add(1, std::memory_order_relaxed);
+        next = now + std::chrono::seconds(interval_);
+      }
+    }
+  }
+
+  std::string dir_;
+  int interval_;
+  std::atomic<int64_t> round_{0};
+  std::mutex mu_;
+  std::condition_variable cond_;
+  /// \brief snapshots to write, guarded by mu_
+  std::queue<std::pair<int, KeySnapshot>> queue_;
+  bool stop_ = false;
+  /// \brief serializes the writes of files
+  std::mutex file_mu_;
+  std::thread thread_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_SERVER_CHECKPOINT_H_
@@ -0,0 +1,234 @@
+/**
+ * Copyright (c) 2016 by Contributors
+ * @file   server_optimizer.h
+ * @brief  update the stored values with a C++ optimizer on the servers
+ */
+#ifndef MXNET_KVSTORE_SERVER_OPTIMIZER_H_
+#define MXNET_KVSTORE_SERVER_OPTIMIZER_H_
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/engine.h>
+#include <mxnet/ndarray.h>
+#include <mxnet/optimizer.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+namespace mxnet {
+namespace kvstore {
+
+struct ServerOptimizerParam : public dmlc::Parameter<ServerOptimizerParam> {
+  float lr;
+  float wd;
+  int lr_step;
+  float lr_factor;
+  float lr_stop;
+  int lr_count;
+  int begin_num_update;
+  DMLC_DECLARE_PARAMETER(ServerOptimizerParam) {
+    DMLC_DECLARE_FIELD(lr).set_default(0.01f)
+    .describe("The learning rate.");
+    DMLC_DECLARE_FIELD(wd).set_default(0.0f)
+    .describe("The weight decay.");
+    DMLC_DECLARE_FIELD(lr_step).set_default(0).set_lower_bound(0)
+    .describe("If positive, lr is multiplied by lr_factor every lr_step "
+              "updates, as the FactorScheduler in python does.");
+    DMLC_DECLARE_FIELD(lr_factor).set_default(1.0f)
+    .describe("See lr_step.");
+    DMLC_DECLARE_FIELD(lr_stop).set_default(1e-8f)
+    .describe("lr is not decayed below lr_stop.");
+    DMLC_DECLARE_FIELD(lr_count).set_default(0).set_lower_bound(0)
+    .describe("The number of updates lr was last decayed at.");
+    DMLC_DECLARE_FIELD(begin_num_update).set_default(0).set_lower_bound(0)
+    .describe("The number of updates done before.");
+  }
+};
+
+/**
+ * \brief updates the values stored on a server with an optimizer registered
+ * by MXNET_REGISTER_OPTIMIZER, instead of calling the python updater on the
+ * main thread.
+ *
+ * Besides the parameters of the optimizer, the configuration holds a
+ * ServerOptimizerParam and per key multipliers of lr and wd, as "lr_mult.<key>"
+ * and "wd_mult.<key>". The learning rate is scheduled by the number of
+ * updates like the python optimizers do: the maximal number of updates over
+ * all keys.
+ *
+ * \ref Update is threadsafe for different keys.
+ */
+class ServerOptimizer {
+ public:
+  /**
+   * \brief encode the optimizer \a name and its parameters into a string,
+   * decoded by the constructor
+   */
+  static std::string Encode(
+      const std::string& name,
+      const std::vector<std::pair<std::string, std::string>>& kwargs) {
+    std::ostringstream os;
+    os << name << "\n";
+    for (const auto& kv : kwargs) {
+      CHECK(kv.first.find_first_of("=\n") == std::string::npos &&
+            kv.second.find('\n') == std::string::npos)
+          << "invalid optimizer parameter " << kv.first << "=" << kv.second;
+      os << kv.first << "=" << kv.second << "\n";
+    }
+    return os.str();
+  }
+
+  /**
+   * \brief create the optimizer from a string returned by \ref Encode
+   */
+  explicit ServerOptimizer(const std::string& str) {
+    std::istringstream is(str);
+    std::string name, line;
+    CHECK(std::getline(is, name)) << "invalid optimizer: " << str;
+    std::vector<std::pair<std::string, std::string>> kwargs;
+    while (std::getline(is, line)) {
+      size_t pos = line.find('=');
+      CHECK_NE(pos, std::string::npos) << "invalid optimizer parameter " << line;
+      kwargs.emplace_back(line.substr(0, pos), line.substr(pos + 1));
+    }
+    kwargs = param_.InitAllowUnknown(kwargs);
+    std::vector<std::pair<std::string, std::string>> opt_kwargs;
+    for (const auto& kv : kwargs) {
+      if (kv.first.compare(0, 8, "lr_mult.") == 0) {
+        lr_mult_[std::stoi(kv.first.substr(8))] = std::stof(kv.second);
+      } else if (kv.first.compare(0, 8, "wd_mult.") == 0) {
+        wd_mult_[std::stoi(kv.first.substr(8))] = std::stof(kv.second);
+      } else {
+        opt_kwargs.push_back(kv);
+      }
+    }
+    opt_.reset(Optimizer::Create(name.c_str()));
+    opt_->Init(opt_kwargs);
+    num_update_ = param_.begin_num_update;
+    LOG(INFO) << "update with the optimizer " << name;
+  }
+
+  /**
+   * \brief update \a weight of \a key by \a grad, the sum of \a num gradients
+   * (or a gradient damped by \a num). \a grad is averaged in place first.
+   * \a key is a slice of the array \a array_key, whose lr and wd multipliers
+   * apply, or the array itself
+   */
+  void Update(int key, int array_key, const NDArray& grad, NDArray* weight,
+              int num) {
+    CHECK_GT(num, 0);
+    int num_update = CountUpdate(key);
+    NDArray g = grad;
+    if (num > 1) g *= 1.0f / num;
+    float lr = LearningRate(num_update) * Find(lr_mult_, array_key);
+    float wd = param_.wd * Find(wd_mult_, array_key);
+    opt_->Update(key, weight, &g, lr, wd);
+  }
+
+  /**
+   * \brief as \ref Update, but only the \a ranges of the flattened \a weight
+   * and \a grad, with the states of the other elements left as they are
+   */
+  void UpdateRanges(int key, int array_key, const NDArray& grad,
+                    const std::vector<std::pair<size_t, size_t> >& ranges,
+                    NDArray* weight, int num) {
+    CHECK_GT(num, 0);
+    int num_update = CountUpdate(key);
+    NDArray g = grad;
+    if (num > 1) {
+      // averaging the whole of grad would cost as much as a dense update
+      float scale = 1.0f / num;
+      Engine::Get()->PushSync([g, ranges, scale](RunContext ctx) {
+          real_t* dptr = static_cast<real_t*>(g.data().dptr_);
+          for (const auto& r : ranges) {
+            for (size_t i = r.first; i < r.first + r.second; ++i) dptr[i] *= scale;
+          }
+        }, g.ctx(), {}, {g.var()}, FnProperty::kNormal);
+    }
+    float lr = LearningRate(num_update) * Find(lr_mult_, array_key);
+    float wd = param_.wd * Find(wd_mult_, array_key);
+    opt_->UpdateRanges(key, weight, &g, ranges, lr, wd);
+  }
+
+  /**
+   * \brief get copies of the states of \a key, taken before the next \ref
+   * Update on \a key, which must run on the same thread
+   * \param counters set to the integer states, ending with the number of
+   * updates of \a key
+   */
+  void GetState(int key, std::vector<NDArray>* arrays, std::vector<int>* counters) {
+    std::vector<NDArray> states;
+    opt_->GetState(key, &states, counters);
+    arrays->clear();
+    for (const auto& s : states) {
+      arrays->emplace_back(s.shape(), s.ctx());
+      CopyFromTo(s, &arrays->back());
+    }
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = key_update_.find(key);
+    counters->push_back(it == key_update_.end() ? param_.begin_num_update : it->second);
+  }
+
+  /**
+   * \brief restore the states of \a key of \a weight got by \ref GetState
+   */
+  void SetState(int key, const NDArray& weight, const std::vector<NDArray>& arrays,
+                std::vector<int> counters) {
+    CHECK(!counters.empty());
+    int count = counters.back();
+    counters.pop_back();
+    opt_->SetState(key, &weight, arrays, counters);
+    std::lock_guard<std::mutex> lk(mu_);
+    key_update_[key] = count;
+    num_update_ = std::max(num_update_, count);
+  }
+
+ private:
+  /// \brief count an update of \a key, and return the number of updates the
+  /// learning rate is decided by
+  int CountUpdate(int key) {
+    std::lock_guard<std::mutex> lk(mu_);
+    // the learning rate is decided before counting this update, as python
+    // optimizers do
+    int num_update = num_update_;
+    auto it = key_update_.find(key);
+    int count = it == key_update_.end() ? param_.begin_num_update : it->second;
+    key_update_[key] = ++count;
+    num_update_ = std::max(num_update_, count);
+    return num_update;
+  }
+
+  float LearningRate(int num_update) const {
+    float lr = param_.lr;
+    if (param_.lr_step > 0 && num_update > param_.lr_count) {
+      int k = (num_update - param_.lr_count - 1) / param_.lr_step;
+      if (k > 0) {
+        lr = std::max(lr * std::pow(param_.lr_factor, static_cast<float>(k)), param_.lr_stop);
+      }
+    }
+    return lr;
+  }
+
+  static float Find(const std::unordered_map<int, float>& mult, int key) {
+    auto it = mult.find(key);
+    return it == mult.end() ? 1.0f : it->second;
+  }
+
+  ServerOptimizerParam param_;
+  std::unique_ptr<Optimizer> opt_;
+  /// \brief lr and wd multipliers of keys, 1 if not found
+  std::unordered_map<int, float> lr_mult_, wd_mult_;
+  std::mutex mu_;
+  /// \brief the number of updates of each key, guarded by mu_
+  std::unordered_map<int, int> key_update_;
+  /// \brief the maximal number of updates over keys, guarded by mu_
+  int num_update_ = 0;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_SERVER_OPTIMIZER_H_
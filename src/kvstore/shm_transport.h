@@ -0,0 +1,229 @@
+/**
+ * Copyright (c) 2016 by Contributors
+ * @file   shm_transport.h
+ * @brief  pass pushed and pulled values between a worker and a server on the
+ * same host through shared memory
+ */
+#ifndef MXNET_KVSTORE_SHM_TRANSPORT_H_
+#define MXNET_KVSTORE_SHM_TRANSPORT_H_
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/base.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \return a name of this job, unique among the jobs sharing a host, which
+ * prefixes its shared memory segments
+ */
+inline std::string ShmJobName() {
+  std::string job = dmlc::GetEnv("DMLC_PS_ROOT_URI", std::string()) + "_" +
+                    dmlc::GetEnv("DMLC_PS_ROOT_PORT", std::string());
+  for (char& c : job) {
+    if (!isalnum(c)) c = '_';
+  }
+  return job;
+}
+
+/**
+ * \brief shared memory between a worker and the servers on its host.
+ *
+ * The values of a push or pull are put into a buffer shared by the worker
+ * and the server, and only a small message without them is sent by ps-lite.
+ * The server reads pushed values in place. Each ps key of a worker has its
+ * own buffer, holding the pushed values followed by the pulled ones, since a
+ * worker has at most one push and one pull in flight on a key.
+ *
+ * A worker learns which servers share its host by a handshake: it creates a
+ * marker segment holding a random nonce and sends the nonce to every server.
+ * A server on the same host finds the marker with the same nonce and
+ * acknowledges in it. Markers of another host or another run never match.
+ *
+ * Buffers are created by the worker and unlinked once the server mapped
+ * them, so that nothing is left behind when the job exits. Threadsafe.
+ */
+class ShmTransport {
+ public:
+  explicit ShmTransport(const std::string& job) : job_(job) { }
+
+  ~ShmTransport() {
+    if (marker_ != nullptr) {
+      munmap(marker_, sizeof(Marker));
+      shm_unlink(MarkerName(rank_).c_str());
+    }
+    for (auto& it : buffers_) munmap(it.second.ptr, it.second.bytes);
+  }
+
+  /**
+   * \brief create the marker of worker \a rank
+   * \return the nonce to send to the servers
+   */
+  uint64_t CreateMarker(int rank) {
+    std::lock_guard<std::mutex> lk(mu_);
+    CHECK(marker_ == nullptr);
+    rank_ = rank;
+    std::random_device rd;
+    uint64_t nonce = (static_cast<uint64_t>(rd()) << 32) ^ rd() ^
+        std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    if (nonce == 0) nonce = 1;
+    size_t bytes;
+    marker_ = static_cast<Marker*>(Map(MarkerName(rank), true, &bytes, sizeof(Marker)));
+    marker_->nonce = nonce;
+    return nonce;
+  }
+
+  /**
+   * \brief acknowledge the handshake of worker \a rank by server \a server,
+   * if the worker is on this host
+   * \return whether it is
+   */
+  bool Accept(int rank, uint64_t nonce, int server) {
+    CHECK_LT(server, kMaxServers);
+    size_t bytes;
+    auto marker = static_cast<Marker*>(Map(MarkerName(rank), false, &bytes, 0));
+    if (marker == nullptr) return false;
+    bool local = bytes == sizeof(Marker) && marker->nonce == nonce;
+    if (local) marker->acks[server].store(nonce, std::memory_order_release);
+    munmap(marker, bytes);
+    return local;
+  }
+
+  /**
+   * \brief remove the marker once all servers answered the handshake
+   * \return the servers on this host
+   */
+  std::vector<bool> RemoveMarker(int num_servers) {
+    std::lock_guard<std::mutex> lk(mu_);
+    CHECK(marker_ != nullptr);
+    std::vector<bool> local(num_servers);
+    for (int s = 0; s < num_servers && s < kMaxServers; ++s) {
+      local[s] = marker_->acks[s].load(std::memory_order_acquire) == marker_->nonce;
+    }
+    munmap(marker_, sizeof(Marker));
+    shm_unlink(MarkerName(rank_).c_str());
+    marker_ = nullptr;
+    return local;
+  }
+
+  /**
+   * \brief the buffer of \a len pushed and \a len pulled values of ps key \a
+   * key of this worker, created if new
+   */
+  real_t* WorkerBuffer(uint64_t key, size_t len) {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto& buf = buffers_[std::make_pair(rank_, key)];
+    if (buf.ptr == nullptr) {
+      buf.name = BufferName(rank_, key);
+      buf.ptr = static_cast<real_t*>(
+          Map(buf.name, true, &buf.bytes, 2 * len * sizeof(real_t)));
+    }
+    CHECK_EQ(buf.bytes, 2 * len * sizeof(real_t));
+    return buf.ptr;
+  }
+
+  /**
+   * \brief unlink the buffer of ps key \a key of this worker, once a server
+   * has mapped it
+   */
+  void Unlink(uint64_t key) {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto& buf = buffers_[std::make_pair(rank_, key)];
+    if (buf.name.empty()) return;
+    shm_unlink(buf.name.c_str());
+    buf.name.clear();
+  }
+
+  /**
+   * \brief the buffer of ps key \a key of worker \a rank, mapped by a server
+   * \param len set to the number of values
+   */
+  real_t* ServerBuffer(int rank, uint64_t key, size_t* len) {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto& buf = buffers_[std::make_pair(rank, key)];
+    if (buf.ptr == nullptr) {
+      buf.ptr = static_cast<real_t*>(Map(BufferName(rank, key), false, &buf.bytes, 0));
+      CHECK(buf.ptr != nullptr) << "no buffer of key " << key << " of worker " << rank;
+    }
+    *len = buf.bytes / sizeof(real_t) / 2;
+    return buf.ptr;
+  }
+
+ private:
+  static const int kMaxServers = 1024;
+
+  struct Marker {
+    uint64_t nonce;
+    /// \brief the nonce written by each server on this host
+    std::atomic<uint64_t> acks[kMaxServers];
+  };
+
+  struct Buffer {
+    real_t* ptr = nullptr;
+    size_t bytes = 0;
+    /// \brief the name while not unlinked, on the worker
+    std::string name;
+  };
+
+  std::string MarkerName(int rank) const {
+    return "/mxnet_" + job_ + "_w" + std::to_string(rank);
+  }
+
+  std::string BufferName(int rank, uint64_t key) const {
+    return MarkerName(rank) + "_" + std::to_string(key);
+  }
+
+  /**
+   * \brief map segment \a name. a new one of \a size bytes is created if \a
+   * create, otherwise an existing one is mapped whole
+   * \return null if not existing and not created
+   */
+  static void* Map(const std::string& name, bool create, size_t* bytes,
+                   size_t size) {
+    int fd = shm_open(name.c_str(), create ? O_CREAT | O_RDWR | O_TRUNC : O_RDWR, 0600);
+    if (fd < 0 && !create) return nullptr;
+    CHECK_GE(fd, 0) << "shm_open " << name << " failed: " << strerror(errno);
+    if (create) {
+      CHECK_EQ(ftruncate(fd, size), 0)
+          << "ftruncate " << name << " failed: " << strerror(errno);
+    } else {
+      struct stat st;
+      CHECK_EQ(fstat(fd, &st), 0);
+      size = st.st_size;
+      if (size == 0) {
+        close(fd);
+        return nullptr;
+      }
+    }
+    *bytes = size;
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    CHECK(ptr != MAP_FAILED) << "mmap " << name << " failed: " << strerror(errno);
+    close(fd);
+    return ptr;
+  }
+
+  std::string job_;
+  int rank_ = -1;
+  std::mutex mu_;
+  Marker* marker_ = nullptr;
+  /// \brief buffers by the worker rank and ps key, guarded by mu_
+  std::map<std::pair<int, uint64_t>, Buffer> buffers_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_SHM_TRANSPORT_H_
@@ -0,0 +1,185 @@
+/**
+ * Copyright (c) 2016 by Contributors
+ * @file   vector_clock.h
+ * @brief  per worker iteration clocks kept by a server node
+ */
+#ifndef MXNET_KVSTORE_VECTOR_CLOCK_H_
+#define MXNET_KVSTORE_VECTOR_CLOCK_H_
+#include <dmlc/logging.h>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief the iteration clocks of all workers on the keys of one server.
+ *
+ * The clock of a worker on a key is the number of pushes received from this
+ * worker on this key. The clock of a worker is the minimal clock over all
+ * keys, namely the number of iterations this worker has finished on this
+ * server. The clock of the server is the minimal clock over all workers.
+ *
+ * All functions are threadsafe.
+ */
+class VectorClock {
+ public:
+  /**
+   * \brief callback fired when the server clock reaches a required value
+   */
+  typedef std::function<void()> Callback;
+
+  explicit VectorClock(int num_workers)
+      : worker_clock_(num_workers, 0), key_clock_(num_workers),
+        num_behind_(num_workers, 0) { }
+
+  /**
+   * \brief register a key, each worker starts at its current clock on it
+   */
+  void AddKey(int key) {
+    std::lock_guard<std::mutex> lk(mu_);
+    bool added = false;
+    for (size_t i = 0; i < key_clock_.size(); ++i) {
+      if (key_clock_[i].emplace(key, worker_clock_[i]).second) {
+        ++num_behind_[i];
+        added = true;
+      }
+    }
+    if (added) ++num_keys_;
+  }
+
+  /**
+   * \brief advance the clock of worker \a rank on \a key by one
+   */
+  void Tick(int rank, int key) {
+    std::vector<Callback> ready;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      CHECK_LT(static_cast<size_t>(rank), key_clock_.size());
+      auto it = key_clock_[rank].find(key);
+      CHECK(it != key_clock_[rank].end()) << "unknown key " << key;
+      if (it->second++ != worker_clock_[rank]) return;
+      if (--num_behind_[rank] > 0) return;
+      // all keys of this worker have passed its clock, move it forward
+      while (num_behind_[rank] == 0) {
+        int64_t c = ++worker_clock_[rank];
+        for (const auto& kv : key_clock_[rank]) {
+          if (kv.second == c) ++num_behind_[rank];
+        }
+      }
+      Release(&ready);
+    }
+    for (const auto& cb : ready) cb();
+  }
+
+  /**
+   * \brief move the clock of worker \a rank on every key forward to at
+   * least \a clock. used by a server restored from a checkpoint, whose
+   * clocks restart from 0, once it learns where the worker is
+   */
+  void Lift(int rank, int64_t clock) {
+    std::vector<Callback> ready;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      CHECK_LT(static_cast<size_t>(rank), key_clock_.size());
+      auto& keys = key_clock_[rank];
+      if (keys.empty()) {
+        worker_clock_[rank] = std::max(worker_clock_[rank], clock);
+      } else {
+        int64_t c = std::numeric_limits<int64_t>::max();
+        for (auto& kv : keys) {
+          kv.second = std::max(kv.second, clock);
+          c = std::min(c, kv.second);
+        }
+        worker_clock_[rank] = c;
+        num_behind_[rank] = 0;
+        for (const auto& kv : keys) {
+          if (kv.second == c) ++num_behind_[rank];
+        }
+      }
+      Release(&ready);
+    }
+    for (const auto& cb : ready) cb();
+  }
+
+  /**
+   * \return the clock of worker \a rank on \a key
+   */
+  int64_t clock(int rank, int key) {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = key_clock_[rank].find(key);
+    return it == key_clock_[rank].end() ? worker_clock_[rank] : it->second;
+  }
+
+  /**
+   * \brief call \a cb once the server clock is no less than \a clock. \a cb
+   * is called immediately if it already is.
+   */
+  void WaitFor(int64_t clock, const Callback& cb) {
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      if (num_keys_ > 0 && clock_ < clock) {
+        waiters_.emplace_back(clock, cb);
+        return;
+      }
+    }
+    cb();
+  }
+
+  /**
+   * \return the clock of the server
+   */
+  int64_t clock() {
+    std::lock_guard<std::mutex> lk(mu_);
+    return clock_;
+  }
+
+  /**
+   * \return the clock of worker \a rank
+   */
+  int64_t clock(int rank) {
+    std::lock_guard<std::mutex> lk(mu_);
+    return worker_clock_[rank];
+  }
+
+ private:
+  /**
+   * \brief update the server clock, and move the callbacks of the waits it
+   * reaches to \a ready. called with mu_ held
+   */
+  void Release(std::vector<Callback>* ready) {
+    int64_t clock = *std::min_element(worker_clock_.begin(), worker_clock_.end());
+    if (clock == clock_) return;
+    clock_ = clock;
+    auto last = std::partition(waiters_.begin(), waiters_.end(),
+                               [clock](const std::pair<int64_t, Callback>& w) {
+                                 return w.first > clock;
+                               });
+    for (auto it = last; it != waiters_.end(); ++it) {
+      ready->push_back(std::move(it->second));
+    }
+    waiters_.erase(last, waiters_.end());
+  }
+
+  std::mutex mu_;
+  /// \brief number of registered keys
+  size_t num_keys_ = 0;
+  /// \brief the server clock, min(worker_clock_)
+  int64_t clock_ = 0;
+  /// \brief clock of each worker
+  std::vector<int64_t> worker_clock_;
+  /// \brief clock of each worker on each key
+  std::vector<std::unordered_map<int, int64_t>> key_clock_;
+  /// \brief number of keys on which a worker is still at its clock
+  std::vector<int> num_behind_;
+  /// \brief pending waits, (required clock, callback)
+  std::vector<std::pair<int64_t, Callback>> waiters_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_VECTOR_CLOCK_H_
@@ -0,0 +1,250 @@
+/**
+ * Copyright (c) 2016 by Contributors
+ * @file   worker_grouping.h
+ * @brief  load adaptive worker groups for the group synced mode
+ */
+#ifndef MXNET_KVSTORE_WORKER_GROUPING_H_
+#define MXNET_KVSTORE_WORKER_GROUPING_H_
+#include <dmlc/logging.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief an assignment of workers to synchronization groups
+ */
+struct GroupPlan {
+  /// \brief increased by one on every regrouping
+  int version = 0;
+  /// \brief worker ranks of each group
+  std::vector<std::vector<int>> members;
+  /// \brief the group of each worker rank
+  std::vector<int> group_of_rank;
+};
+
+/**
+ * \brief groups workers of similar speed together.
+ *
+ * The speed of a worker is measured by the time between the server replying
+ * to its push on a key and receiving its next push on the same key, namely
+ * the time the worker spends on one iteration without waiting for the
+ * others.
+ *
+ * Each server measures the workers on its own keys. To regroup, one worker
+ * gathers \ref EncodeTimes of all servers, clusters workers with similar
+ * times into the same group by \ref NextPlan, and sends the plan back to all
+ * servers, which \ref Adopt it. So all servers follow the same plan.
+ *
+ * All functions are threadsafe.
+ */
+class WorkerGrouping {
+ public:
+  /**
+   * \brief start with \a num_groups groups of consecutive ranks
+   */
+  WorkerGrouping(int num_workers, int num_groups)
+      : last_reply_(num_workers), time_sum_(num_workers, 0),
+        time_cnt_(num_workers, 0) {
+    CHECK_GT(num_workers, 0);
+    num_groups = std::min(std::max(num_groups, 1), num_workers);
+    std::vector<int> group_of_rank(num_workers);
+    for (int i = 0; i < num_groups; ++i) {
+      for (int r = num_workers * i / num_groups;
+           r < num_workers * (i + 1) / num_groups; ++r) {
+        group_of_rank[r] = i;
+      }
+    }
+    plan_ = MakePlan(0, num_groups, group_of_rank);
+  }
+
+  /**
+   * \return the current plan. a returned plan is never modified.
+   */
+  std::shared_ptr<const GroupPlan> plan() {
+    std::lock_guard<std::mutex> lk(mu_);
+    return plan_;
+  }
+
+  /**
+   * \brief the server replied to the push of worker \a rank on \a key
+   */
+  void OnReply(int rank, int key) {
+    std::lock_guard<std::mutex> lk(mu_);
+    last_reply_[rank][key] = Clock::now();
+  }
+
+  /**
+   * \brief the server received a push of worker \a rank on \a key
+   */
+  void OnPush(int rank, int key) {
+    std::lock_guard<std::mutex> lk(mu_);
+    auto it = last_reply_[rank].find(key);
+    if (it == last_reply_[rank].end()) return;
+    time_sum_[rank] += std::chrono::duration<double>(
+        Clock::now() - it->second).count();
+    ++time_cnt_[rank];
+  }
+
+  /**
+   * \return the plan version, the number of groups, and the sum and number
+   * of the iteration times of each worker measured since the last plan
+   */
+  std::string EncodeTimes() {
+    std::lock_guard<std::mutex> lk(mu_);
+    std::ostringstream os;
+    os.precision(17);
+    os << plan_->version << " " << plan_->members.size();
+    for (size_t i = 0; i < time_sum_.size(); ++i) {
+      os << " " << time_sum_[i] << " " << time_cnt_[i];
+    }
+    return os.str();
+  }
+
+  /**
+   * \brief cluster the workers by the \ref EncodeTimes of all servers.
+   *
+   * Workers are sorted by their mean iteration time, and split at the
+   * (num_groups - 1) largest gaps.
+   *
+   * \return the plan to \ref Adopt, or an empty string to keep the current
+   * plan if some worker has not been measured yet
+   */
+  static std::string NextPlan(const std::vector<std::string>& times) {
+    CHECK(!times.empty());
+    int version = 0;
+    size_t num_groups = 0;
+    std::vector<double> time_sum;
+    std::vector<int> time_cnt;
+    for (const auto& str : times) {
+      std::istringstream is(str);
+      int v;
+      size_t n;
+      CHECK(is >> v >> n) << "invalid worker times: " << str;
+      version = std::max(version, v);
+      num_groups = std::max(num_groups, n);
+      double sum;
+      int cnt;
+      for (size_t i = 0; is >> sum >> cnt; ++i) {
+        if (i == time_sum.size()) {
+          time_sum.push_back(0);
+          time_cnt.push_back(0);
+        }
+        time_sum[i] += sum;
+        time_cnt[i] += cnt;
+      }
+    }
+    int num_workers = static_cast<int>(time_sum.size());
+    CHECK_GT(num_workers, 0);
+    std::vector<double> time(num_workers);
+    for (int i = 0; i < num_workers; ++i) {
+      if (time_cnt[i] == 0) {
+        LOG(INFO) << "worker " << i << " is not measured, keep the groups";
+        return "";
+      }
+      time[i] = time_sum[i] / time_cnt[i];
+    }
+    std::vector<int> ranks(num_workers);
+    std::iota(ranks.begin(), ranks.end(), 0);
+    std::sort(ranks.begin(), ranks.end(), [&time](int a, int b) {
+        return time[a] < time[b];
+      });
+    // split before the positions with the largest gaps
+    std::vector<size_t> pos(num_workers - 1);
+    std::iota(pos.begin(), pos.end(), 1);
+    std::partial_sort(pos.begin(), pos.begin() + (num_groups - 1), pos.end(),
+                      [&time, &ranks](size_t a, size_t b) {
+                        return time[ranks[a]] - time[ranks[a-1]] >
+                            time[ranks[b]] - time[ranks[b-1]];
+                      });
+    std::vector<size_t> ends(pos.begin(), pos.begin() + (num_groups - 1));
+    ends.push_back(num_workers);
+    std::sort(ends.begin(), ends.end());
+
+    std::ostringstream os;
+    os << version + 1 << " " << num_groups;
+    std::vector<int> group_of_rank(num_workers);
+    size_t begin = 0;
+    for (size_t i = 0; i < ends.size(); ++i) {
+      std::ostringstream members;
+      for (size_t j = begin; j < ends[i]; ++j) {
+        group_of_rank[ranks[j]] = i;
+        members << " " << ranks[j] << "(" << time[ranks[j]] << "s)";
+      }
+      LOG(INFO) << "group " << i << ":" << members.str();
+      begin = ends[i];
+    }
+    for (int g : group_of_rank) os << " " << g;
+    return os.str();
+  }
+
+  /**
+   * \brief switch to the plan \a str made by \ref NextPlan, unless the
+   * current plan is as new. the times are measured again from here.
+   */
+  void Adopt(const std::string& str) {
+    std::istringstream is(str);
+    int version;
+    size_t num_groups;
+    CHECK(is >> version >> num_groups) << "invalid group plan: " << str;
+    std::vector<int> group_of_rank;
+    for (int g; is >> g;) group_of_rank.push_back(g);
+    std::lock_guard<std::mutex> lk(mu_);
+    CHECK_EQ(group_of_rank.size(), time_sum_.size()) << "invalid group plan: " << str;
+    if (version <= plan_->version) return;
+    plan_ = MakePlan(version, num_groups, group_of_rank);
+    std::fill(time_sum_.begin(), time_sum_.end(), 0);
+    std::fill(time_cnt_.begin(), time_cnt_.end(), 0);
+  }
+
+  /**
+   * \return the current plan in the form \ref Adopt takes
+   */
+  std::string EncodePlan() {
+    std::lock_guard<std::mutex> lk(mu_);
+    std::ostringstream os;
+    os << plan_->version << " " << plan_->members.size();
+    for (int g : plan_->group_of_rank) os << " " << g;
+    return os.str();
+  }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+  /**
+   * \brief the plan putting worker r into group[r], with the members of each
+   * group in the order of their ranks
+   */
+  static std::shared_ptr<GroupPlan> MakePlan(int version, size_t num_groups,
+                                             const std::vector<int>& group_of_rank) {
+    auto plan = std::make_shared<GroupPlan>();
+    plan->version = version;
+    plan->group_of_rank = group_of_rank;
+    plan->members.resize(num_groups);
+    for (size_t r = 0; r < group_of_rank.size(); ++r) {
+      CHECK_LT(static_cast<size_t>(group_of_rank[r]), num_groups);
+      plan->members[group_of_rank[r]].push_back(r);
+    }
+    return plan;
+  }
+
+  std::mutex mu_;
+  std::shared_ptr<const GroupPlan> plan_;
+  /// \brief the last time replied to each worker on each key
+  std::vector<std::unordered_map<int, Clock::time_point>> last_reply_;
+  /// \brief sum of measured iteration times of each worker
+  std::vector<double> time_sum_;
+  /// \brief number of measured iterations of each worker
+  std::vector<int> time_cnt_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_WORKER_GROUPING_H_
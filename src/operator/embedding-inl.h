@@ -29,11 +29,17 @@ enum EmbeddingOpResource {kTempSpace};
 struct EmbeddingParam: public dmlc::Parameter<EmbeddingParam> {
   int input_dim;
   int output_dim;
+  bool sparse_grad;
   DMLC_DECLARE_PARAMETER(EmbeddingParam) {
     DMLC_DECLARE_FIELD(input_dim).set_lower_bound(1)
     .describe("input dim of one-hot encoding");
     DMLC_DECLARE_FIELD(output_dim).set_lower_bound(1)
     .describe("output dim of embedding");
+    DMLC_DECLARE_FIELD(sparse_grad).set_default(false)
+    .describe("If true, only the rows of the weight gradient indexed by data are "
+              "written, the others are left as they are. Push the gradient by "
+              "KVStore.row_sparse_push with data as the row ids, so that only "
+              "these rows are sent and updated.");
   }
 };
 
@@ -97,7 +103,11 @@ class EmbeddingOp : public Operator {
          Shape2(oshape.ProdShape(0, oshape.ndim()-1), oshape[oshape.ndim()-1]), s);
     Tensor<xpu, 2, DType> grad_in = in_grad[embedding::kWeight].get<xpu, 2, DType>(s);
     if (req[embedding::kWeight] == kWriteTo || req[embedding::kWeight] == kAddTo) {
-      if (req[embedding::kWeight] == kWriteTo) {
+      if (req[embedding::kWeight] == kWriteTo && param_.sparse_grad) {
+        // only the rows seen are meant, zeroing them costs the batch instead
+        // of the whole weight
+        ZeroTakenRows(grad_in, data);
+      } else if (req[embedding::kWeight] == kWriteTo) {
 #ifdef __CUDACC__
         cudaMemsetAsync(grad_in.dptr_, 0, grad_in.MSize() * sizeof(DType),
                         Stream<gpu>::GetStream(s));
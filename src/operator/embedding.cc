@@ -5,7 +5,24 @@
  * \author Bing Xu
 */
 
+#include <algorithm>
 #include "./embedding-inl.h"
+
+namespace mshadow {
+
+template<typename DType>
+inline void ZeroTakenRows(Tensor<cpu, 2, DType> dst,
+                          const Tensor<cpu, 1, DType> &index) {
+  for (index_t i = 0; i < index.size(0); ++i) {
+    float row = static_cast<float>(index[i]);
+    if (row < 0 || row >= dst.size(0)) continue;
+    DType* dptr = dst[static_cast<index_t>(row)].dptr_;
+    std::fill(dptr, dptr + dst.size(1), DType(0));
+  }
+}
+
+}  // namespace mshadow
+
 namespace mxnet {
 namespace op {
 template<>
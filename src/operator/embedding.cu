@@ -7,6 +7,45 @@
 */
 
 #include "./embedding-inl.h"
+
+namespace mshadow {
+namespace cuda {
+
+template<typename DType>
+__global__ void ZeroTakenRowsKernel(Tensor<gpu, 2, DType> dst,
+                                    const Tensor<gpu, 1, DType> index) {
+  const index_t width = dst.size(1);
+  const index_t n = index.size(0) * width;
+  for (index_t i = threadIdx.x + blockIdx.x * blockDim.x; i < n;
+       i += blockDim.x * gridDim.x) {
+    float row = static_cast<float>(index[i / width]);
+    if (row < 0 || row >= dst.size(0)) continue;
+    dst[static_cast<index_t>(row)][i % width] = DType(0);
+  }
+}
+
+template<typename DType>
+inline void ZeroTakenRows(const Tensor<gpu, 2, DType> &dst,
+                          const Tensor<gpu, 1, DType> &index) {
+  const index_t n = index.size(0) * dst.size(1);
+  if (n == 0) return;
+  dim3 dimBlock(kBaseThreadNum);
+  dim3 dimGrid(std::min<index_t>((n + kBaseThreadNum - 1) / kBaseThreadNum, kMaxGridNum));
+  CheckLaunchParam(dimGrid, dimBlock, "ZeroTakenRows");
+  cudaStream_t stream = Stream<gpu>::GetStream(dst.stream_);
+  ZeroTakenRowsKernel<DType><<<dimGrid, dimBlock, 0, stream>>>(dst, index);
+}
+
+}  // namespace cuda
+
+template<typename DType>
+inline void ZeroTakenRows(Tensor<gpu, 2, DType> dst,
+                          const Tensor<gpu, 1, DType> &index) {
+  cuda::ZeroTakenRows(dst, index);
+}
+
+}  // namespace mshadow
+
 namespace mxnet {
 namespace op {
 template<>
@@ -0,0 +1,215 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file adam-inl.h
+ * \brief adam optimizer
+ */
+#ifndef MXNET_OPTIMIZER_ADAM_INL_H_
+#define MXNET_OPTIMIZER_ADAM_INL_H_
+
+#include <mshadow/tensor.h>
+#include <mxnet/optimizer.h>
+#include <dmlc/parameter.h>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <utility>
+#include "./sgd-inl.h"
+#include "../operator/mshadow_op.h"
+
+namespace mxnet {
+namespace opt {
+
+struct AdamParam : public dmlc::Parameter<AdamParam> {
+  float beta1;
+  float beta2;
+  float epsilon;
+  float rescale_grad;
+  float clip_gradient;
+  DMLC_DECLARE_PARAMETER(AdamParam) {
+    DMLC_DECLARE_FIELD(beta1)
+    .set_range(0.0f, 1.0f)
+    .set_default(0.9f)
+    .describe("decay rate of the first moment estimates");
+    DMLC_DECLARE_FIELD(beta2)
+    .set_range(0.0f, 1.0f)
+    .set_default(0.999f)
+    .describe("decay rate of the second moment estimates");
+    DMLC_DECLARE_FIELD(epsilon)
+    .set_default(1e-8f)
+    .describe("added to the square root of the second moment");
+    DMLC_DECLARE_FIELD(rescale_grad)
+    .set_default(1.0f)
+    .describe("rescale gradient as grad = rescale_grad*grad.");
+    DMLC_DECLARE_FIELD(clip_gradient)
+    .set_default(-1.0f)
+    .describe("If greater than 0, clip gradient to "
+              "grad = max(min(grad, -clip_gradient), clip_gradient). "
+              "Otherwise turned off.");
+  }
+};
+
+/*!
+ * \brief \a lr is the bias corrected learning rate of this step
+ */
+template<typename xpu>
+void adam_update(RunContext ctx, TBlob weight, const TBlob grad, TBlob mean,
+                 TBlob var, float lr, float wd, const AdamParam& param) {
+  using namespace mshadow;
+  using namespace mshadow::expr;
+  using namespace mxnet::op;
+  Stream<xpu>* s = ctx.get_stream<xpu>();
+  Tensor<xpu, 2> weight2d = weight.FlatTo2D<xpu, real_t>(s);
+  Tensor<xpu, 2> grad2d = grad.FlatTo2D<xpu, real_t>(s);
+  Tensor<xpu, 2> mean2d = mean.FlatTo2D<xpu, real_t>(s);
+  Tensor<xpu, 2> var2d = var.FlatTo2D<xpu, real_t>(s);
+  if (param.clip_gradient > 0.0f) {
+    mean2d = param.beta1*mean2d + (1.0f - param.beta1)*
+             F<sgd_clip>(param.rescale_grad*grad2d, param.clip_gradient);
+    var2d = param.beta2*var2d + (1.0f - param.beta2)*F<mshadow_op::square>(
+             F<sgd_clip>(param.rescale_grad*grad2d, param.clip_gradient));
+  } else {
+    mean2d = param.beta1*mean2d + (1.0f - param.beta1)*param.rescale_grad*grad2d;
+    var2d = param.beta2*var2d + (1.0f - param.beta2)*
+            F<mshadow_op::square>(param.rescale_grad*grad2d);
+  }
+  weight2d -= lr*(mean2d/(F<mshadow_op::square_root>(var2d) + param.epsilon));
+  if (wd > 0.0f) {
+    weight2d -= (lr*wd)*weight2d;
+  }
+}
+
+void call_adam_update_cpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob mean,
+                          TBlob var, float lr, float wd, const AdamParam& param);
+#if MXNET_USE_CUDA
+void call_adam_update_gpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob mean,
+                          TBlob var, float lr, float wd, const AdamParam& param);
+#endif  // MXNET_USE_CUDA
+
+#if DMLC_USE_CXX11
+
+class AdamOpt : public Optimizer {
+ public:
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+  }
+
+  void CreateState(const int index, const NDArray *weight) override {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (mean_.find(index) == mean_.end()) {
+      mean_[index] = NDArray(weight->shape(), weight->ctx());
+      mean_[index] = 0.0f;
+      var_[index] = NDArray(weight->shape(), weight->ctx());
+      var_[index] = 0.0f;
+      num_update_[index] = 0;
+    }
+  }
+
+  void Update(const int index, NDArray *weight,
+              const NDArray *grad, const float lr, const float wd) override {
+    NDArray w = *weight, g = *grad;
+    CreateState(index, weight);
+    NDArray mean, var;
+    int t;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      mean = mean_[index];
+      var = var_[index];
+      t = ++num_update_[index];
+    }
+    // bias correction of the moments
+    float coef1 = 1.0f - std::pow(param_.beta1, t);
+    float coef2 = 1.0f - std::pow(param_.beta2, t);
+    float lr_t = lr * std::sqrt(coef2) / coef1;
+    AdamParam param = param_;
+    switch (w.ctx().dev_type) {
+     case Context::kCPU:
+     case Context::kCPUPinned:
+      Engine::Get()->PushSync([w, g, mean, var, lr_t, wd, param](RunContext ctx) {
+        call_adam_update_cpu(ctx, w.data(), g.data(), mean.data(), var.data(),
+                             lr_t, wd, param);
+      }, w.ctx(), {g.var()}, {w.var(), mean.var(), var.var()}, FnProperty::kNormal);
+      break;
+     case Context::kGPU:
+#if MXNET_USE_CUDA
+      Engine::Get()->PushSync([w, g, mean, var, lr_t, wd, param](RunContext ctx) {
+        call_adam_update_gpu(ctx, w.data(), g.data(), mean.data(), var.data(),
+                             lr_t, wd, param);
+      }, w.ctx(), {g.var()}, {w.var(), mean.var(), var.var()}, FnProperty::kNormal);
+      break;
+#else
+        LOG(FATAL) << "Please compile with CUDA enabled for cuda features";
+#endif  // MXNET_USE_CUDA
+     default:
+      LOG(FATAL) << "Unsupported device type for adam optimizer: " << w.ctx().dev_type;
+    }
+  }
+
+  void UpdateRanges(const int index, NDArray *weight, const NDArray *grad,
+                    const std::vector<std::pair<size_t, size_t> > &ranges,
+                    const float lr, const float wd) override {
+    CHECK_EQ(weight->ctx().dev_mask(), cpu::kDevMask);
+    NDArray w = *weight, g = *grad;
+    CreateState(index, weight);
+    NDArray mean, var;
+    int t;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      mean = mean_[index];
+      var = var_[index];
+      // counted by updates of the weight, not of each range
+      t = ++num_update_[index];
+    }
+    float coef1 = 1.0f - std::pow(param_.beta1, t);
+    float coef2 = 1.0f - std::pow(param_.beta2, t);
+    float lr_t = lr * std::sqrt(coef2) / coef1;
+    AdamParam param = param_;
+    Engine::Get()->PushSync([w, g, mean, var, ranges, lr_t, wd, param](RunContext ctx) {
+        for (const auto& r : ranges) {
+          call_adam_update_cpu(ctx, FlatRange(w.data(), r.first, r.second),
+                               FlatRange(g.data(), r.first, r.second),
+                               FlatRange(mean.data(), r.first, r.second),
+                               FlatRange(var.data(), r.first, r.second),
+                               lr_t, wd, param);
+        }
+      }, w.ctx(), {g.var()}, {w.var(), mean.var(), var.var()}, FnProperty::kNormal);
+  }
+
+  void GetState(const int index, std::vector<NDArray> *arrays,
+                std::vector<int> *counters) override {
+    std::lock_guard<std::mutex> lk(mu_);
+    arrays->clear();
+    counters->clear();
+    if (mean_.find(index) == mean_.end()) return;
+    *arrays = {mean_[index], var_[index]};
+    *counters = {num_update_[index]};
+  }
+
+  void SetState(const int index, const NDArray *weight,
+                const std::vector<NDArray> &arrays,
+                const std::vector<int> &counters) override {
+    if (arrays.empty()) return;
+    CHECK_EQ(arrays.size(), 2U);
+    CHECK_EQ(counters.size(), 1U);
+    CreateState(index, weight);
+    std::lock_guard<std::mutex> lk(mu_);
+    CopyFromTo(arrays[0], &mean_[index]);
+    CopyFromTo(arrays[1], &var_[index]);
+    num_update_[index] = counters[0];
+  }
+
+ private:
+  AdamParam param_;
+  /*! \brief guards the states, so that different indices can be updated in parallel */
+  std::mutex mu_;
+  std::map<int, NDArray> mean_;
+  std::map<int, NDArray> var_;
+  std::map<int, int> num_update_;
+};
+
+#endif  // DMLC_USE_CXX11
+
+}  // namespace opt
+}  // namespace mxnet
+#endif  // MXNET_OPTIMIZER_ADAM_INL_H_
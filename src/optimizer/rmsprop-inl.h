@@ -0,0 +1,211 @@
+/*!
+ *  Copyright (c) 2016 by Contributors
+ * \file rmsprop-inl.h
+ * \brief rmsprop optimizer, following Eq(38) - Eq(45) of
+ *  http://arxiv.org/pdf/1308.0850v5.pdf by Alex Graves
+ */
+#ifndef MXNET_OPTIMIZER_RMSPROP_INL_H_
+#define MXNET_OPTIMIZER_RMSPROP_INL_H_
+
+#include <mshadow/tensor.h>
+#include <mxnet/optimizer.h>
+#include <dmlc/parameter.h>
+#include <array>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <utility>
+#include "./sgd-inl.h"
+#include "../operator/mshadow_op.h"
+
+namespace mxnet {
+namespace opt {
+
+struct RMSPropParam : public dmlc::Parameter<RMSPropParam> {
+  float gamma1;
+  float gamma2;
+  float epsilon;
+  float rescale_grad;
+  float clip_gradient;
+  DMLC_DECLARE_PARAMETER(RMSPropParam) {
+    DMLC_DECLARE_FIELD(gamma1)
+    .set_range(0.0f, 1.0f)
+    .set_default(0.95f)
+    .describe("decay factor of moving average for gradient, gradient^2");
+    DMLC_DECLARE_FIELD(gamma2)
+    .set_range(0.0f, 1.0f)
+    .set_default(0.9f)
+    .describe("momentum factor");
+    DMLC_DECLARE_FIELD(epsilon)
+    .set_default(1e-4f)
+    .describe("added to the variance before taking the square root");
+    DMLC_DECLARE_FIELD(rescale_grad)
+    .set_default(1.0f)
+    .describe("rescale gradient as grad = rescale_grad*grad.");
+    DMLC_DECLARE_FIELD(clip_gradient)
+    .set_default(-1.0f)
+    .describe("If greater than 0, clip gradient to "
+              "grad = max(min(grad, -clip_gradient), clip_gradient). "
+              "Otherwise turned off.");
+  }
+};
+
+template<typename xpu>
+void rmsprop_update(RunContext ctx, TBlob weight, const TBlob grad, TBlob n,
+                    TBlob g, TBlob delta, float lr, float wd,
+                    const RMSPropParam& param) {
+  using namespace mshadow;
+  using namespace mshadow::expr;
+  using namespace mxnet::op;
+  Stream<xpu>* s = ctx.get_stream<xpu>();
+  Tensor<xpu, 2> weight2d = weight.FlatTo2D<xpu, real_t>(s);
+  Tensor<xpu, 2> grad2d = grad.FlatTo2D<xpu, real_t>(s);
+  Tensor<xpu, 2> n2d = n.FlatTo2D<xpu, real_t>(s);
+  Tensor<xpu, 2> g2d = g.FlatTo2D<xpu, real_t>(s);
+  Tensor<xpu, 2> delta2d = delta.FlatTo2D<xpu, real_t>(s);
+  if (param.clip_gradient > 0.0f) {
+    n2d = (1.0f - param.gamma1)*F<mshadow_op::square>(
+          F<sgd_clip>(param.rescale_grad*grad2d, param.clip_gradient)) +
+          param.gamma1*n2d;
+    g2d = (1.0f - param.gamma1)*
+          F<sgd_clip>(param.rescale_grad*grad2d, param.clip_gradient) +
+          param.gamma1*g2d;
+    delta2d = param.gamma2*delta2d - lr*(
+              F<sgd_clip>(param.rescale_grad*grad2d, param.clip_gradient)/
+              F<mshadow_op::square_root>(n2d - g2d*g2d + param.epsilon) +
+              wd*weight2d);
+  } else {
+    n2d = (1.0f - param.gamma1)*F<mshadow_op::square>(param.rescale_grad*grad2d) +
+          param.gamma1*n2d;
+    g2d = (1.0f - param.gamma1)*param.rescale_grad*grad2d + param.gamma1*g2d;
+    delta2d = param.gamma2*delta2d - lr*(
+              param.rescale_grad*grad2d/
+              F<mshadow_op::square_root>(n2d - g2d*g2d + param.epsilon) +
+              wd*weight2d);
+  }
+  weight2d += delta2d;
+}
+
+void call_rmsprop_update_cpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob n,
+                             TBlob g, TBlob delta, float lr, float wd,
+                             const RMSPropParam& param);
+#if MXNET_USE_CUDA
+void call_rmsprop_update_gpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob n,
+                             TBlob g, TBlob delta, float lr, float wd,
+                             const RMSPropParam& param);
+#endif  // MXNET_USE_CUDA
+
+#if DMLC_USE_CXX11
+
+class RMSPropOpt : public Optimizer {
+ public:
+  void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) override {
+    param_.Init(kwargs);
+  }
+
+  void CreateState(const int index, const NDArray *weight) override {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (state_.find(index) == state_.end()) {
+      auto& state = state_[index];
+      for (NDArray& s : state) {
+        s = NDArray(weight->shape(), weight->ctx());
+        s = 0.0f;
+      }
+    }
+  }
+
+  void Update(const int index, NDArray *weight,
+              const NDArray *grad, const float lr, const float wd) override {
+    NDArray w = *weight, g = *grad;
+    CreateState(index, weight);
+    State state;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      state = state_[index];
+    }
+    RMSPropParam param = param_;
+    switch (w.ctx().dev_type) {
+     case Context::kCPU:
+     case Context::kCPUPinned:
+      Engine::Get()->PushSync([w, g, state, lr, wd, param](RunContext ctx) {
+        call_rmsprop_update_cpu(ctx, w.data(), g.data(), state[0].data(),
+                                state[1].data(), state[2].data(), lr, wd, param);
+      }, w.ctx(), {g.var()}, {w.var(), state[0].var(), state[1].var(), state[2].var()},
+      FnProperty::kNormal);
+      break;
+     case Context::kGPU:
+#if MXNET_USE_CUDA
+      Engine::Get()->PushSync([w, g, state, lr, wd, param](RunContext ctx) {
+        call_rmsprop_update_gpu(ctx, w.data(), g.data(), state[0].data(),
+                                state[1].data(), state[2].data(), lr, wd, param);
+      }, w.ctx(), {g.var()}, {w.var(), state[0].var(), state[1].var(), state[2].var()},
+      FnProperty::kNormal);
+      break;
+#else
+        LOG(FATAL) << "Please compile with CUDA enabled for cuda features";
+#endif  // MXNET_USE_CUDA
+     default:
+      LOG(FATAL) << "Unsupported device type for rmsprop optimizer: " << w.ctx().dev_type;
+    }
+  }
+
+  void UpdateRanges(const int index, NDArray *weight, const NDArray *grad,
+                    const std::vector<std::pair<size_t, size_t> > &ranges,
+                    const float lr, const float wd) override {
+    CHECK_EQ(weight->ctx().dev_mask(), cpu::kDevMask);
+    NDArray w = *weight, g = *grad;
+    CreateState(index, weight);
+    State state;
+    {
+      std::lock_guard<std::mutex> lk(mu_);
+      state = state_[index];
+    }
+    RMSPropParam param = param_;
+    Engine::Get()->PushSync([w, g, state, ranges, lr, wd, param](RunContext ctx) {
+        for (const auto& r : ranges) {
+          call_rmsprop_update_cpu(ctx, FlatRange(w.data(), r.first, r.second),
+                                  FlatRange(g.data(), r.first, r.second),
+                                  FlatRange(state[0].data(), r.first, r.second),
+                                  FlatRange(state[1].data(), r.first, r.second),
+                                  FlatRange(state[2].data(), r.first, r.second),
+                                  lr, wd, param);
+        }
+      }, w.ctx(), {g.var()}, {w.var(), state[0].var(), state[1].var(), state[2].var()},
+      FnProperty::kNormal);
+  }
+
+  void GetState(const int index, std::vector<NDArray> *arrays,
+                std::vector<int> *counters) override {
+    std::lock_guard<std::mutex> lk(mu_);
+    arrays->clear();
+    counters->clear();
+    auto it = state_.find(index);
+    if (it != state_.end()) arrays->assign(it->second.begin(), it->second.end());
+  }
+
+  void SetState(const int index, const NDArray *weight,
+                const std::vector<NDArray> &arrays,
+                const std::vector<int> &counters) override {
+    if (arrays.empty()) return;
+    CHECK_EQ(arrays.size(), 3U);
+    CreateState(index, weight);
+    std::lock_guard<std::mutex> lk(mu_);
+    auto& state = state_[index];
+    for (size_t i = 0; i < state.size(); ++i) CopyFromTo(arrays[i], &state[i]);
+  }
+
+ private:
+  /*! \brief n, g and delta of an index */
+  typedef std::array<NDArray, 3> State;
+  RMSPropParam param_;
+  /*! \brief guards the states, so that different indices can be updated in parallel */
+  std::mutex mu_;
+  std::map<int, State> state_;
+};
+
+#endif  // DMLC_USE_CXX11
+
+}  // namespace opt
+}  // namespace mxnet
+#endif  // MXNET_OPTIMIZER_RMSPROP_INL_H_
@@ -0,0 +1,18 @@
+/*!
+ * Copyright (c) 2016 by Contributors
+ * \file rmsprop.cu
+ * \brief rmsprop optimizer
+*/
+#include "./rmsprop-inl.h"
+
+namespace mxnet {
+namespace opt {
+
+void call_rmsprop_update_gpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob n,
+                             TBlob g, TBlob delta, float lr, float wd,
+                             const RMSPropParam& param) {
+  rmsprop_update<gpu>(ctx, weight, grad, n, g, delta, lr, wd, param);
+}
+
+}  // namespace opt
+}  // namespace mxnet
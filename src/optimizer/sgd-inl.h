@@ -14,6 +14,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
 #include <utility>
 
 namespace mxnet {
@@ -87,6 +88,14 @@ void sgd_update(RunContext ctx, TBlob weight, const TBlob grad,
   }
 }
 
+/*!
+ * \brief the \a len elements from \a begin of the flattened \a blob
+ */
+inline TBlob FlatRange(const TBlob& blob, size_t begin, size_t len) {
+  return TBlob(static_cast<real_t*>(blob.dptr_) + begin, mshadow::Shape1(len),
+               blob.dev_mask_);
+}
+
 void call_sgd_mom_update_cpu(RunContext ctx, TBlob weight, const TBlob grad, TBlob mom,
                 float lr, float wd, const SGDParam& param);
 void call_sgd_update_cpu(RunContext ctx, TBlob weight, const TBlob grad,
@@ -107,6 +116,7 @@ class SGDOpt : public Optimizer {
   }
 
   void CreateState(const int index, const NDArray *weight) override {
+    std::lock_guard<std::mutex> lk(mu_);
     if (param_.momentum > 0.0f && mom.find(index) == mom.end()) {
       mom[index] = NDArray(weight->shape(), weight->ctx());
       mom[index] = 0.0f;
@@ -115,17 +125,21 @@ class SGDOpt : public Optimizer {
 
   void Update(const int index, NDArray *weight,
               const NDArray *grad, const float lr, const float wd) override {
-    NDArray w = *weight, g = *grad;
+    NDArray w = *weight, g = *grad, m;
     CreateState(index, weight);
+    if (param_.momentum > 0.0f) {
+      std::lock_guard<std::mutex> lk(mu_);
+      m = mom[index];
+    }
     switch (w.ctx().dev_type) {
      case Context::kCPU:
      case Context::kCPUPinned:
       if (param_.momentum > 0.0f) {
-        Engine::Get()->PushSync([this, index, w, g, lr, wd](RunContext ctx) {
-          call_sgd_mom_update_cpu(ctx, w.data(), g.data(), mom[index].data(), lr, wd, param_);
-        }, w.ctx(), {g.var()}, {w.var(), mom[index].var()}, FnProperty::kNormal);
+        Engine::Get()->PushSync([this, w, g, m, lr, wd](RunContext ctx) {
+          call_sgd_mom_update_cpu(ctx, w.data(), g.data(), m.data(), lr, wd, param_);
+        }, w.ctx(), {g.var()}, {w.var(), m.var()}, FnProperty::kNormal);
       } else {
-        Engine::Get()->PushSync([this, index, w, g, lr, wd](RunContext ctx) {
+        Engine::Get()->PushSync([this, w, g, lr, wd](RunContext ctx) {
           call_sgd_update_cpu(ctx, w.data(), g.data(), lr, wd, param_);
         }, w.ctx(), {g.var()}, {w.var()}, FnProperty::kNormal);
       }
@@ -133,11 +147,11 @@ class SGDOpt : public Optimizer {
      case Context::kGPU:
 #if MXNET_USE_CUDA
       if (param_.momentum > 0.0f) {
-        Engine::Get()->PushSync([this, index, w, g, lr, wd](RunContext ctx) {
-          call_sgd_mom_update_gpu(ctx, w.data(), g.data(), mom[index].data(), lr, wd, param_);
-        }, w.ctx(), {g.var()}, {w.var(), mom[index].var()}, FnProperty::kNormal);
+        Engine::Get()->PushSync([this, w, g, m, lr, wd](RunContext ctx) {
+          call_sgd_mom_update_gpu(ctx, w.data(), g.data(), m.data(), lr, wd, param_);
+        }, w.ctx(), {g.var()}, {w.var(), m.var()}, FnProperty::kNormal);
       } else {
-        Engine::Get()->PushSync([this, index, w, g, lr, wd](RunContext ctx) {
+        Engine::Get()->PushSync([this, w, g, lr, wd](RunContext ctx) {
           call_sgd_update_gpu(ctx, w.data(), g.data(), lr, wd, param_);
         }, w.ctx(), {g.var()}, {w.var()}, FnProperty::kNormal);
       }
@@ -150,8 +164,56 @@ class SGDOpt : public Optimizer {
     }
   }
 
+  void UpdateRanges(const int index, NDArray *weight, const NDArray *grad,
+                    const std::vector<std::pair<size_t, size_t> > &ranges,
+                    const float lr, const float wd) override {
+    CHECK_EQ(weight->ctx().dev_mask(), cpu::kDevMask);
+    NDArray w = *weight, g = *grad, m;
+    CreateState(index, weight);
+    std::vector<Engine::VarHandle> mutable_vars = {w.var()};
+    if (param_.momentum > 0.0f) {
+      std::lock_guard<std::mutex> lk(mu_);
+      m = mom[index];
+      mutable_vars.push_back(m.var());
+    }
+    Engine::Get()->PushSync([this, w, g, m, ranges, lr, wd](RunContext ctx) {
+        for (const auto& r : ranges) {
+          TBlob wr = FlatRange(w.data(), r.first, r.second);
+          TBlob gr = FlatRange(g.data(), r.first, r.second);
+          if (param_.momentum > 0.0f) {
+            call_sgd_mom_update_cpu(ctx, wr, gr, FlatRange(m.data(), r.first, r.second),
+                                    lr, wd, param_);
+          } else {
+            call_sgd_update_cpu(ctx, wr, gr, lr, wd, param_);
+          }
+        }
+      }, w.ctx(), {g.var()}, mutable_vars, FnProperty::kNormal);
+  }
+
+  void GetState(const int index, std::vector<NDArray> *arrays,
+                std::vector<int> *counters) override {
+    std::lock_guard<std::mutex> lk(mu_);
+    arrays->clear();
+    counters->clear();
+    auto it = mom.find(index);
+    if (it != mom.end()) arrays->push_back(it->second);
+  }
+
+  void SetState(const int index, const NDArray *weight,
+                const std::vector<NDArray> &arrays,
+                const std::vector<int> &counters) override {
+    if (arrays.empty()) return;
+    CHECK_EQ(arrays.size(), 1U);
+    CreateState(index, weight);
+    std::lock_guard<std::mutex> lk(mu_);
+    CHECK(mom.find(index) != mom.end()) << "momentum is 0, but restoring it";
+    CopyFromTo(arrays[0], &mom[index]);
+  }
+
  private:
   SGDParam param_;
+  /*! \brief guards mom, so that different indices can be updated in parallel */
+  std::mutex mu_;
   std::map<int, NDArray> mom;
 };
 
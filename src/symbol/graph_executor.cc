@@ -546,6 +546,7 @@ void GraphExecutor::InitDataEntryInfo(const std::vector<NDArray> &in_args,
           << "Gradient holder NDArray's context must match the operator's context assignment";
       ++info.ref_count;
       op_nodes_[grad_source.source_id].activated = true;
+      grad_source_args_[grad_source.source_id].push_back(i);
     }
     // setup head gradient
     for (uint32_t nid : head_grad_nodes_) {
@@ -806,8 +807,11 @@ void GraphExecutor::InitOperators() {
         in_shapes.push_back(op_nodes_[e.source_id].outputs[e.index].shape);
       }
       op_node.op.reset(graph_.nodes[nid].op->CreateOperatorEx(op_node.ctx, &in_shapes, &in_types));
+      op_node.opr_name = graph_.nodes[nid].op->TypeString();
     } else {
       CHECK(graph_.nodes[nid].is_backward());
+      op_node.opr_name = "_backward_" +
+          graph_.nodes[graph_.nodes[nid].backward_source_id].op->TypeString();
       op_node.op.reset(new BackwardOpWrapper(
           graph_.nodes[graph_.nodes[nid].backward_source_id].op.get(),
           op_nodes_[graph_.nodes[nid].backward_source_id].op));
@@ -835,61 +839,71 @@ void GraphExecutor::InitCachedOps() {
           op_node.cached_exec.exec_fun,
           op_node.cached_exec.use_vars,
           op_node.cached_exec.mutate_vars,
-          FnProperty::kNormal);
+          FnProperty::kNormal,
+          op_node.opr_name.c_str());
     }
   }
 }
 
 void GraphExecutor::InitOpSegs() {
-  // heurestic to enable bulk execution.
   cached_seg_opr_.clear();
   CachedSegOpr p;
   p.opr = nullptr;
   cached_seg_opr_.resize(topo_order_.size(), p);
 
   if (!prefer_bulk_execution_) return;
-  if (num_forward_nodes_ == topo_order_.size()) {
-    cached_seg_opr_[0] = this->CreateCachedSegOpr(0, topo_order_.size());
-    return;
-  }
-  int num_cseg = 0;
-  // normal procedure
-  for (size_t i = 0; i < topo_order_.size(); ++i) {
-    size_t j = i;
-    int hit_count = 0;
-    for (; j < topo_order_.size(); ++j) {
-      if (j == num_forward_nodes_) break;
-      uint32_t nid = topo_order_[j];
-      const OpNode& op_node = op_nodes_[nid];
-      const StaticGraph::Node& gnode = graph_.nodes[nid];
-      if (!op_node.activated) continue;
-      if (graph_.nodes[nid].is_variable()) continue;
-      if (op_node.op->exec_type() != Operator::kSync) break;
-      bool hit = false, tobind = false;
+  // forward and backward are run by separate calls, so never share a segment.
+  // a graph without backward is bulked as a whole where possible, while
+  // training keeps segments short, so that gradients are released early.
+  size_t max_nodes = bulk_exec_max_nodes_;
+  if (num_forward_nodes_ == topo_order_.size()) max_nodes = topo_order_.size();
+  this->PlanOpSegs(0, num_forward_nodes_, max_nodes);
+  this->PlanOpSegs(num_forward_nodes_, topo_order_.size(), max_nodes);
+}
 
-      for (const DataEntryInfo& out : op_node.outputs) {
-        if (out.type == kBindByExternal) hit = true;
-      }
-      const size_t ninput = gnode.inputs.size() - gnode.addto_index.size();
-      for (size_t i = 0; i < ninput; ++i) {
-        const StaticGraph::DataEntry& e = graph_.nodes[nid].inputs[i];
-        const DataEntryInfo &info = op_nodes_[e.source_id].outputs[e.index];
-        if (info.type == kBindByExternal) hit = true;
-        if (info.type == kTobeBindByExternal) tobind = true;
+void GraphExecutor::PlanOpSegs(size_t topo_start, size_t topo_end, size_t max_nodes) {
+  size_t seg_start = topo_start, num_nodes = 0;
+  Context seg_ctx;
+  // end the current segment before topo order end
+  auto cut = [&](size_t end) {
+    if (num_nodes > 1) {
+      cached_seg_opr_[seg_start] = this->CreateCachedSegOpr(seg_start, end);
+    }
+    seg_start = end;
+    num_nodes = 0;
+  };
+  for (size_t k = topo_start; k < topo_end; ++k) {
+    uint32_t nid = topo_order_[k];
+    const OpNode& op_node = op_nodes_[nid];
+    const StaticGraph::Node& gnode = graph_.nodes[nid];
+    if (!op_node.activated) continue;
+    if (gnode.is_variable()) continue;
+    // ops which are async, copy across devices or use arrays bound at each
+    // run, such as the head gradients, are pushed alone
+    bool bulkable = op_node.op->exec_type() == Operator::kSync;
+    for (const DataEntryInfo& out : op_node.outputs) {
+      if (out.type == kTobeBindByExternal) bulkable = false;
+    }
+    for (const DataEntryInfo& aux : op_node.aux_states) {
+      if (aux.type == kTobeBindByExternal) bulkable = false;
+    }
+    const size_t ninput = gnode.inputs.size() - gnode.addto_index.size();
+    for (size_t i = 0; i < ninput; ++i) {
+      const StaticGraph::DataEntry& e = gnode.inputs[i];
+      if (op_nodes_[e.source_id].outputs[e.index].type == kTobeBindByExternal) {
+        bulkable = false;
       }
-      if (hit) ++hit_count;
-      if (tobind) break;
-      // if encounter consecutive 3 blocks containing parameters, use as segment.
-      // this usually means conv-relu-bn
-      const int kHitMaxMagic = 2;
-      if (hit_count > kHitMaxMagic) break;
-    }
-    if (j > i + 1) {
-      cached_seg_opr_[i] = CreateCachedSegOpr(i, j);
-      ++num_cseg;
-      i = j - 1;
     }
+    if (!bulkable) {
+      cut(k);
+      seg_start = k + 1;
+      continue;
+    }
+    if (num_nodes != 0 && op_node.ctx != seg_ctx) cut(k);
+    seg_ctx = op_node.ctx;
+    if (++num_nodes >= max_nodes) cut(k + 1);
   }
+  cut(topo_end);
 }
 
 void GraphExecutor::RunOps(bool is_train, size_t topo_start, size_t topo_end) {
@@ -906,6 +920,9 @@ void GraphExecutor::RunOps(bool is_train, size_t topo_start, size_t topo_end) {
       auto seg_op = cached_seg_opr_[i];
       if (seg_op.opr != nullptr && seg_op.topo_end <= topo_end) {
         Engine::Get()->Push(seg_op.opr, seg_op.ctx);
+        for (size_t j = i; j < seg_op.topo_end; ++j) {
+          NotifyGradReady(topo_order_[j]);
+        }
         i = seg_op.topo_end - 1;
         continue;
       }
@@ -933,8 +950,11 @@ void GraphExecutor::RunOps(bool is_train, size_t topo_start, size_t topo_end) {
           opnode.ctx,
           exec.use_vars,
           exec.mutate_vars,
-          FnProperty::kNormal);
+          FnProperty::kNormal,
+          0,
+          opnode.opr_name.c_str());
     }
+    NotifyGradReady(nid);
     if (monitor_callback_) {
       std::vector<std::string> output_names;
       if (graph_.nodes[nid].is_forward()) {
@@ -953,6 +973,19 @@ void GraphExecutor::RunOps(bool is_train, size_t topo_start, size_t topo_end) {
   }
 }
 
+void GraphExecutor::NotifyGradReady(uint32_t nid) {
+  if (!grad_ready_callback_ || grad_notified_.empty()) return;
+  auto it = grad_source_args_.find(nid);
+  if (it == grad_source_args_.end()) return;
+  for (size_t arg : it->second) {
+    if (grad_notified_[arg]) continue;
+    grad_notified_[arg] = true;
+    const StaticGraph::DataEntry& e = arg_grads_[arg];
+    grad_ready_callback_(static_cast<int>(arg),
+                         op_nodes_[e.source_id].outputs[e.index].data);
+  }
+}
+
 void GraphExecutor::Print(std::ostream &os) const {
   os << "num_forward_nodes=" << num_forward_nodes_ << '\n';
   for (size_t i = 0; i < topo_order_.size(); ++i) {
@@ -1024,7 +1057,14 @@ void GraphExecutor::Backward(const std::vector<NDArray> &head_grads) {
         << "Because the last operator is not Loss function, "
         << "head_gradient is required in calling backward.";
   }
+  grad_notified_.assign(arg_grads_.size(), false);
   RunOps(true, num_forward_nodes_, topo_order_.size());
+  // gradients not produced by any backward op, e.g. by a variable, are
+  // final now as well
+  for (const auto& kv : grad_source_args_) {
+    NotifyGradReady(kv.first);
+  }
+  grad_notified_.clear();
 }
 
 GraphExecutor::CachedSegOpr
@@ -1145,7 +1185,7 @@ GraphExecutor::CreateCachedSegOpr(size_t topo_start, size_t topo_end) {
     on_complete();
   };
   ret.opr =  Engine::Get()->NewOperator(
-      exec_fun, read_vars, write_vars, FnProperty::kNormal);
+      exec_fun, read_vars, write_vars, FnProperty::kNormal, "BulkExecution");
   return ret;
 }
 
@@ -36,6 +36,10 @@ class GraphExecutor : public Executor {
     CHECK(callback) << "invalid callback";
     monitor_callback_ = callback;
   }
+  void SetGradReadyCallback(const GradReadyCallback& callback) override {
+    CHECK(callback) << "invalid callback";
+    grad_ready_callback_ = callback;
+  }
   // implement Executor::Bind, only call it once.
   inline void Init(Symbol symbol,
                    const Context& default_ctx,
@@ -47,6 +51,7 @@ class GraphExecutor : public Executor {
                    Executor* shared_exec = nullptr) {
     enable_inplace_allocation_ = dmlc::GetEnv("MXNET_EXEC_ENABLE_INPLACE", true);
     prefer_bulk_execution_ = dmlc::GetEnv("MXNET_EXEC_PREFER_BULK_EXEC", true);
+    bulk_exec_max_nodes_ = dmlc::GetEnv("MXNET_EXEC_BULK_EXEC_MAX_NODE_TRAIN", 15);
     if (shared_exec != NULL) {
       GraphExecutor* gexec = dynamic_cast<GraphExecutor*>(shared_exec);
       CHECK(gexec) << "Input executor for sharing memory must have GraphExecutor type.";
@@ -148,6 +153,8 @@ class GraphExecutor : public Executor {
     OpExecEntry cached_exec;
     // cached operator handle
     Engine::OprHandle cached_opr{nullptr};
+    // name of the operator shown by the profiler
+    std::string opr_name;
     // constructor
     OpNode() : activated(false) {}
     // Manual option for delete operator
@@ -236,6 +243,8 @@ class GraphExecutor : public Executor {
   void InitCachedOps();
   // initialize segments of code to run together as a group.
   void InitOpSegs();
+  // cut the ops from topo order start to end into segments of at most max_nodes ops
+  void PlanOpSegs(size_t topo_start, size_t topo_end, size_t max_nodes);
   // assign context to the graph, this will mutate the graph.
   void AssignContext(const Context default_ctx,
                      const std::map<std::string, Context>& ctx_map,
@@ -245,6 +254,8 @@ class GraphExecutor : public Executor {
                      std::vector<Context> *ctx_plan);
   // run ops from topo order start to end
   void RunOps(bool is_train, size_t topo_start, size_t topo_end);
+  // fire grad_ready_callback_ for the gradients produced by node nid
+  void NotifyGradReady(uint32_t nid);
   // internal computational graph
   StaticGraph graph_;
   // topological order of nodes in computation graph
@@ -260,6 +271,8 @@ class GraphExecutor : public Executor {
   size_t num_forward_nodes_;
   // whether to enable bulk execution
   bool prefer_bulk_execution_;
+  // maximum number of ops in a segment of a graph with backward
+  size_t bulk_exec_max_nodes_;
   // head gradient node in the graph, if there is backward pass
   std::vector<uint32_t> head_grad_nodes_;
   // mirror map of nodes, experimental feature, normally can be ignored.
@@ -274,6 +287,12 @@ class GraphExecutor : public Executor {
   std::shared_ptr<GraphStoragePool> shared_mem_;
   // monitor call back
   std::function<void(const char*, void*)> monitor_callback_;
+  // gradient ready call back
+  GradReadyCallback grad_ready_callback_;
+  // the arguments whose gradients are produced by each node
+  std::map<uint32_t, std::vector<size_t> > grad_source_args_;
+  // whether the gradient of each argument is notified in this backward
+  std::vector<bool> grad_notified_;
   // cached segment operator
   std::vector<CachedSegOpr> cached_seg_opr_;
 };  // class GraphExecutor
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+#include "../../src/kvstore/allreduce.h"
+
+using mxnet::real_t;
+using mxnet::kvstore::Allreduce;
+
+/// \brief a free port to meet at
+static int FreePort() {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+  socklen_t len = sizeof(addr);
+  getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+  close(fd);
+  return ntohs(addr.sin_port);
+}
+
+/// \brief run \a f(rank, allreduce) on \a n workers in threads
+template <typename F>
+static void RunWorkers(int n, F f) {
+  int port = FreePort();
+  std::vector<std::thread> workers;
+  for (int r = 0; r < n; ++r) {
+    workers.emplace_back([=]() {
+        Allreduce comm(r, n, "127.0.0.1", port);
+        f(r, &comm);
+      });
+  }
+  for (auto& w : workers) w.join();
+}
+
+TEST(Allreduce, Sum) {
+  for (int n = 1; n <= 5; ++n) {
+    for (bool ring : {true, false}) {
+      // fewer values than workers leaves some chunks empty
+      for (size_t len : {1, 3, 1001}) {
+        RunWorkers(n, [=](int rank, Allreduce* comm) {
+            std::vector<real_t> data(len);
+            for (size_t i = 0; i < len; ++i) data[i] = rank * 1000 + i;
+            comm->Sum(data.data(), len, ring);
+            for (size_t i = 0; i < len; ++i) {
+              EXPECT_EQ(data[i], 1000 * n * (n - 1) / 2 + n * i)
+                  << "n=" << n << " ring=" << ring << " i=" << i;
+            }
+          });
+      }
+    }
+  }
+}
+
+TEST(Allreduce, BroadcastAndBarrier) {
+  for (int n = 1; n <= 5; ++n) {
+    RunWorkers(n, [=](int rank, Allreduce* comm) {
+        std::vector<real_t> data(7, rank);
+        comm->Broadcast(data.data(), data.size(), n - 1);
+        for (real_t x : data) EXPECT_EQ(x, n - 1);
+        comm->Barrier();
+      });
+  }
+}
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "../../src/kvstore/gradient_compression.h"
+
+using mxnet::real_t;
+using mxnet::kvstore::GradientCompression;
+
+static GradientCompression Create(const std::string& type,
+                                  const std::string& key,
+                                  const std::string& value) {
+  GradientCompression gc;
+  gc.SetParams({{"type", type}, {key, value}});
+  return gc;
+}
+
+TEST(GradientCompression, TwoBit) {
+  auto gc = Create("2bit", "threshold", "0.5");
+  EXPECT_TRUE(gc.enabled());
+  const size_t n = 20;
+  EXPECT_EQ(gc.CompressedSize(n), 2U);
+  std::vector<real_t> grad(n, 0.3f), residual(n, 0), out(n);
+  grad[0] = 0.7f; grad[1] = -0.6f;
+  std::vector<real_t> compr(gc.CompressedSize(n));
+
+  gc.Compress(grad.data(), residual.data(), n, compr.data());
+  gc.Decompress(compr.data(), n, out.data());
+  EXPECT_FLOAT_EQ(out[0], 0.5f);
+  EXPECT_FLOAT_EQ(out[1], -0.5f);
+  EXPECT_FLOAT_EQ(out[19], 0.0f);
+  EXPECT_FLOAT_EQ(residual[0], 0.2f);
+  EXPECT_FLOAT_EQ(residual[19], 0.3f);
+
+  // the residual is sent by the next push
+  gc.Compress(grad.data(), residual.data(), n, compr.data());
+  gc.Decompress(compr.data(), n, out.data());
+  EXPECT_FLOAT_EQ(out[19], 0.5f);
+  EXPECT_FLOAT_EQ(residual[19], 0.1f);
+}
+
+TEST(GradientCompression, TopK) {
+  auto gc = Create("topk", "ratio", "0.25");
+  const size_t n = 8;
+  EXPECT_EQ(gc.CompressedSize(n), 4U);
+  std::vector<real_t> grad = {1, -9, 3, 0, 7, 2, 0, 1};
+  std::vector<real_t> residual(n, 0), out(n);
+  std::vector<real_t> compr(gc.CompressedSize(n));
+
+  gc.Compress(grad.data(), residual.data(), n, compr.data());
+  gc.Decompress(compr.data(), n, out.data());
+  std::vector<real_t> sent = {0, -9, 0, 0, 7, 0, 0, 0};
+  std::vector<real_t> kept = {1, 0, 3, 0, 0, 2, 0, 1};
+  for (size_t i = 0; i < n; ++i) {
+    EXPECT_FLOAT_EQ(out[i], sent[i]);
+    EXPECT_FLOAT_EQ(residual[i], kept[i]);
+  }
+}
+
+TEST(GradientCompression, Half) {
+  using namespace mxnet::kvstore::compression;
+  EXPECT_EQ(FloatToHalf(1.0f), 0x3c00);
+  EXPECT_EQ(FloatToHalf(-2.0f), 0xc000);
+  EXPECT_EQ(FloatToHalf(65504.0f), 0x7bff);
+  EXPECT_EQ(FloatToHalf(1e6f), 0x7c00);
+  EXPECT_EQ(FloatToHalf(1e-10f), 0);
+  // ties to even
+  EXPECT_EQ(FloatToHalf(1.0f + 1.0f / 2048), 0x3c00);
+  EXPECT_EQ(FloatToHalf(1.0f + 3.0f / 2048), 0x3c02);
+  EXPECT_EQ(FloatToBF16(1.0f + 1.0f / 256), 0x3f80);
+  EXPECT_EQ(FloatToBF16(1.0f + 3.0f / 256), 0x3f82);
+  for (uint32_t h = 0; h < 0x7c00; ++h) {
+    // every finite half, the subnormals included, round trips
+    EXPECT_EQ(FloatToHalf(HalfToFloat(h)), h);
+    EXPECT_EQ(FloatToHalf(HalfToFloat(h | 0x8000)), h | 0x8000);
+  }
+  std::vector<float> in(37), out(in.size());
+  std::vector<uint16_t> half(in.size());
+  for (size_t i = 0; i < in.size(); ++i) in[i] = (i * 7919 % 1000) / 37.0f - 13;
+  ToHalf(in.data(), in.size(), half.data());
+  FromHalf(half.data(), half.size(), out.data());
+  for (size_t i = 0; i < in.size(); ++i) {
+    EXPECT_EQ(half[i], FloatToHalf(in[i]));
+    EXPECT_EQ(out[i], HalfToFloat(half[i]));
+  }
+}
+
+TEST(GradientCompression, FP16) {
+  for (const char* type : {"fp16", "bf16"}) {
+    auto gc = Create(type, "ratio", "0.01");
+    EXPECT_TRUE(gc.compresses_pull());
+    const size_t n = 5;
+    EXPECT_EQ(gc.CompressedSize(n), 3U);
+    std::vector<real_t> grad = {1, -0.5f, 1e-3f, 3.14159f, 0};
+    std::vector<real_t> residual(n, 0), out(n), sum(n, 0);
+    std::vector<real_t> compr(gc.CompressedSize(n));
+    const int rounds = 1000;
+    for (int r = 0; r < rounds; ++r) {
+      gc.Compress(grad.data(), residual.data(), n, compr.data());
+      gc.Decompress(compr.data(), n, out.data());
+      for (size_t i = 0; i < n; ++i) {
+        EXPECT_NEAR(out[i], grad[i], std::fabs(grad[i]) / 64);
+        sum[i] += out[i];
+      }
+    }
+    // the rounding errors do not accumulate
+    for (size_t i = 0; i < n; ++i) {
+      EXPECT_NEAR(sum[i] + residual[i], grad[i] * rounds, std::fabs(grad[i]) * 1e-2);
+    }
+    gc.CompressWeights(grad.data(), n, compr.data());
+    gc.Decompress(compr.data(), n, out.data());
+    EXPECT_FLOAT_EQ(out[0], 1);
+    EXPECT_FLOAT_EQ(out[4], 0);
+
+    // a longer array, for the vector path and its tail
+    const size_t m = 37;
+    std::vector<real_t> g(m), res(m), before(m), dec(m);
+    compr.resize(gc.CompressedSize(m));
+    for (size_t i = 0; i < m; ++i) {
+      g[i] = (i * 7919 % 1000) / 37.0f - 13;
+      res[i] = before[i] = (i % 5) * 1e-3f;
+    }
+    gc.Compress(g.data(), res.data(), m, compr.data());
+    gc.Decompress(compr.data(), m, dec.data());
+    for (size_t i = 0; i < m; ++i) {
+      EXPECT_EQ(res[i], (before[i] + g[i]) - dec[i]);
+    }
+  }
+}
+
+TEST(GradientCompression, EncodeParams) {
+  auto gc = Create("2bit", "threshold", "0.25");
+  GradientCompression server;
+  EXPECT_FALSE(server.enabled());
+  server.DecodeParams(gc.EncodeParams());
+  EXPECT_EQ(server.EncodeParams(), gc.EncodeParams());
+
+  const size_t n = 3;
+  std::vector<real_t> grad = {0.3f, -0.3f, 0.1f}, residual(n, 0), out(n);
+  std::vector<real_t> compr(gc.CompressedSize(n));
+  gc.Compress(grad.data(), residual.data(), n, compr.data());
+  server.Decompress(compr.data(), n, out.data());
+  EXPECT_FLOAT_EQ(out[0], 0.25f);
+  EXPECT_FLOAT_EQ(out[1], -0.25f);
+  EXPECT_FLOAT_EQ(out[2], 0.0f);
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../src/kvstore/host_aggregation.h"
+
+using mxnet::real_t;
+using mxnet::kvstore::HostAggregation;
+
+/// \brief a barrier of \a n threads
+class ThreadBarrier {
+ public:
+  explicit ThreadBarrier(int n) : n_(n) {}
+  void Wait() {
+    std::unique_lock<std::mutex> lk(mu_);
+    int gen = gen_;
+    if (++count_ == n_) {
+      count_ = 0;
+      ++gen_;
+      cond_.notify_all();
+    } else {
+      cond_.wait(lk, [this, gen]() { return gen != gen_; });
+    }
+  }
+
+ private:
+  int n_, count_ = 0, gen_ = 0;
+  std::mutex mu_;
+  std::condition_variable cond_;
+};
+
+/// \brief call an asynchronous \a f and wait for its callback
+template <typename F>
+static void Wait(F f) {
+  std::promise<void> done;
+  f([&done]() { done.set_value(); });
+  done.get_future().wait();
+}
+
+TEST(HostAggregation, PushPull) {
+  const int n = 3;
+  const size_t len = 1001;
+  const std::string job = "test_" + std::to_string(getpid());
+  ThreadBarrier barrier(n);
+  std::vector<std::thread> workers;
+  for (int r = 0; r < n; ++r) {
+    workers.emplace_back([&, r]() {
+        // ranks need not be consecutive
+        HostAggregation host(job, 10 * r, [&]() { barrier.Wait(); });
+        EXPECT_EQ(host.num_local(), n);
+        EXPECT_EQ(host.is_leader(), r == 0);
+        host.InitKey(7, len);
+        barrier.Wait();
+        host.Unlink();
+        std::vector<real_t> grad(len), val(len);
+        for (int v = 1; v <= 3; ++v) {
+          for (size_t i = 0; i < len; ++i) grad[i] = r + v * i;
+          if (host.is_leader()) {
+            Wait([&](HostAggregation::Callback cb) {
+                host.Gather(7, grad.data(), v, cb);
+              });
+            // stands in for the push and pull of the servers
+            Wait([&](HostAggregation::Callback cb) {
+                host.Share(7, grad.data(), v, cb);
+              });
+            val = grad;
+          } else {
+            Wait([&](HostAggregation::Callback cb) {
+                host.Publish(7, grad.data(), v, cb);
+              });
+            Wait([&](HostAggregation::Callback cb) {
+                host.Fetch(7, val.data(), v, cb);
+              });
+          }
+          for (size_t i = 0; i < len; ++i) {
+            EXPECT_EQ(val[i], n * (n - 1) / 2 + n * v * i) << "v=" << v;
+          }
+        }
+      });
+  }
+  for (auto& w : workers) w.join();
+}
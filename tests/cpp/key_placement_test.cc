@@ -0,0 +1,36 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "../../src/kvstore/key_placement.h"
+
+using mxnet::kvstore::KeyPlacement;
+
+TEST(KeyPlacement, Balance) {
+  KeyPlacement placement(2, 100);
+  placement.Place({0, 1, 2, 3}, {60, 50, 40, 30});
+  // longest first: 60 -> 0, 50 -> 1, 40 -> 1, 30 -> 0
+  EXPECT_EQ(placement.Find(0)->at(0).server, 0);
+  EXPECT_EQ(placement.Find(2)->at(0).server, 1);
+  EXPECT_EQ(placement.Find(3)->at(0).server, 0);
+  EXPECT_EQ(placement.loads(), std::vector<size_t>({90, 90}));
+  EXPECT_EQ(placement.Find(4), nullptr);
+}
+
+TEST(KeyPlacement, SplitOnlyIfBetter) {
+  KeyPlacement placement(2, 100);
+  // two big keys of the same size fit whole
+  placement.Place({0, 1}, {400, 400});
+  EXPECT_EQ(placement.Find(0)->size(), 1U);
+  EXPECT_EQ(placement.Find(1)->size(), 1U);
+
+  // a single big key next to small ones is split
+  KeyPlacement other(2, 100);
+  other.Place({0, 1, 2}, {1000, 10, 10});
+  ASSERT_EQ(other.Find(0)->size(), 2U);
+  EXPECT_EQ(other.Find(0)->at(0).size + other.Find(0)->at(1).size, 1000U);
+  EXPECT_EQ(other.loads(), std::vector<size_t>({510, 510}));
+
+  // small keys are never split
+  KeyPlacement small(2, 100);
+  small.Place({0, 1}, {99, 1});
+  EXPECT_EQ(small.Find(0)->size(), 1U);
+}
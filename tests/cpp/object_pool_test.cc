@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <thread>
+#include <vector>
+#include "../../src/common/object_pool.h"
+
+using mxnet::common::ObjectPoolAllocatable;
+
+struct PoolObj : public ObjectPoolAllocatable<PoolObj> {
+  explicit PoolObj(int v) : value(v) {}
+  int value;
+  char pad[20];
+};
+
+TEST(ObjectPool, CrossThread) {
+  // objects allocated by a thread and freed by others, as the blocks of the
+  // engine are, come back to the allocating thread through the pool
+  const int num_threads = 4, n = 10000;
+  for (int round = 0; round < 3; ++round) {
+    std::vector<std::vector<PoolObj*> > objs(num_threads);
+    std::set<PoolObj*> all;
+    for (int i = 0; i < n * num_threads; ++i) {
+      PoolObj* p = PoolObj::New(i);
+      EXPECT_EQ(p->value, i);
+      EXPECT_TRUE(all.insert(p).second);
+      objs[i % num_threads].push_back(p);
+    }
+    std::vector<std::thread> threads;
+    for (int k = 0; k < num_threads; ++k) {
+      threads.emplace_back([&objs, k]() {
+          for (PoolObj* p : objs[k]) PoolObj::Delete(p);
+          // allocate and free a few on this thread too
+          std::vector<PoolObj*> mine;
+          for (int i = 0; i < 1000; ++i) mine.push_back(PoolObj::New(i));
+          for (PoolObj* p : mine) PoolObj::Delete(p);
+        });
+    }
+    for (auto& t : threads) t.join();
+  }
+}
+
+namespace {
+// frees its object when its thread exits, after the cache of the thread
+struct FreeOnExit {
+  PoolObj* obj{nullptr};
+  ~FreeOnExit() {
+    PoolObj::Delete(obj);
+    PoolObj::Delete(PoolObj::New(0));
+  }
+};
+}  // namespace
+
+TEST(ObjectPool, ThreadExit) {
+  // threads give their caches back when they exit, so the objects are
+  // reused by the next threads instead of piling up
+  const int n = 1000;
+  std::set<PoolObj*> all;
+  for (int round = 0; round < 50; ++round) {
+    std::vector<PoolObj*> objs;
+    std::thread([&objs]() {
+        static thread_local FreeOnExit free_on_exit;
+        for (int i = 0; i < n; ++i) objs.push_back(PoolObj::New(i));
+        free_on_exit.obj = PoolObj::New(-1);
+        for (int i = 0; i < n / 2; ++i) PoolObj::Delete(objs[i]);
+      }).join();
+    for (int i = n / 2; i < n; ++i) PoolObj::Delete(objs[i]);
+    all.insert(objs.begin(), objs.end());
+  }
+  EXPECT_LT(all.size(), 4U * n);
+}
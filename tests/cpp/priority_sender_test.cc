@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include <future>
+#include <mutex>
+#include <vector>
+#include "../../src/kvstore/priority_sender.h"
+
+using mxnet::kvstore::PrioritySender;
+
+TEST(PrioritySender, Order) {
+  std::mutex mu;
+  std::vector<int> sent;
+  std::vector<PrioritySender::Callback> pending;
+  std::promise<void> first;
+  {
+    PrioritySender sender(10);
+    auto send = [&](int id) {
+      return [&, id](const PrioritySender::Callback& done) {
+        std::lock_guard<std::mutex> lk(mu);
+        sent.push_back(id);
+        pending.push_back(done);
+        if (id == 0) first.set_value();
+      };
+    };
+    // fills the window, the others wait
+    sender.Add(0, 10, send(0));
+    first.get_future().wait();
+    sender.Add(-1, 5, send(1));
+    sender.Add(-5, 5, send(2));
+    sender.Add(3, 5, send(3));
+    sender.Add(-1, 5, send(4));
+    // complete every send as soon as it is issued
+    while (true) {
+      PrioritySender::Callback done;
+      {
+        std::lock_guard<std::mutex> lk(mu);
+        if (sent.size() == 5 && pending.empty()) break;
+        if (!pending.empty()) {
+          done = pending.front();
+          pending.erase(pending.begin());
+        }
+      }
+      if (done) done();
+    }
+  }
+  EXPECT_EQ(sent, std::vector<int>({0, 3, 1, 4, 2}));
+}
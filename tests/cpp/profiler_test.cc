@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+#include <dmlc/io.h>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include "../../src/engine/profiler.h"
+
+using mxnet::Context;
+using mxnet::engine::Profiler;
+
+TEST(Profiler, Dump) {
+  Profiler* profiler = Profiler::Get();
+  EXPECT_FALSE(profiler->IsRunning());
+  profiler->SetState(Profiler::kRunning);
+  EXPECT_TRUE(profiler->IsRunning());
+  auto record = [profiler](const char* name) {
+    int tid = profiler->ThreadIndex();
+    uint64_t start = profiler->NowInUsec();
+    profiler->AddOprStat(name, Context::CPU(), tid, start, start, start + 5);
+  };
+  std::thread t1(record, "FullyConnected");
+  std::thread t2(record, "\"quoted\"");
+  t1.join();
+  t2.join();
+  profiler->SetState(Profiler::kNotRunning);
+
+  std::string filename = "profiler_test.json";
+  profiler->DumpProfile(filename);
+  std::string json;
+  {
+    std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(filename.c_str(), "r"));
+    char buf[4096];
+    size_t n;
+    while ((n = fi->Read(buf, sizeof(buf))) != 0) json.append(buf, n);
+  }
+  std::remove(filename.c_str());
+  EXPECT_NE(json.find("\"traceEvents\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\": \"FullyConnected\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\": \"\\\"quoted\\\"\""), std::string::npos);
+  EXPECT_NE(json.find("\"dur\": 5"), std::string::npos);
+  EXPECT_NE(json.find("\"name\": \"cpu/0\""), std::string::npos);
+}
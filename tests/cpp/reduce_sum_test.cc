@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "../../src/kvstore/reduce_sum.h"
+
+using mxnet::real_t;
+using mxnet::kvstore::ReduceSum;
+
+static void CheckReduceSum(size_t n, size_t size, size_t begin, bool stream,
+                           bool inplace) {
+  std::vector<std::vector<real_t>> data(n, std::vector<real_t>(size));
+  for (size_t k = 0; k < n; ++k) {
+    for (size_t i = 0; i < size; ++i) {
+      data[k][i] = static_cast<real_t>((k + 1) * 0.5 + i % 7);
+    }
+  }
+  std::vector<real_t> expected(size, 0);
+  for (size_t i = begin; i < size; ++i) {
+    for (size_t k = 0; k < n; ++k) expected[i] += data[k][i];
+  }
+  std::vector<real_t> out(size, 0);
+  real_t* optr = inplace ? data[0].data() : out.data();
+  std::vector<const real_t*> in;
+  for (const auto& d : data) in.push_back(d.data());
+
+  ReduceSum(in, optr, begin, size, stream);
+  for (size_t i = begin; i < size; ++i) {
+    EXPECT_FLOAT_EQ(optr[i], expected[i]) << "n=" << n << " i=" << i;
+  }
+}
+
+TEST(ReduceSum, NWay) {
+  for (size_t n = 1; n <= 9; ++n) {
+    CheckReduceSum(n, 1000, 0, false, false);
+  }
+}
+
+TEST(ReduceSum, UnalignedStream) {
+  for (size_t begin : {0, 1, 5, 17}) {
+    CheckReduceSum(8, 4099, begin, true, false);
+  }
+}
+
+TEST(ReduceSum, InPlace) {
+  CheckReduceSum(3, 5000, 3, false, true);
+  CheckReduceSum(8, 5000, 0, true, true);
+}
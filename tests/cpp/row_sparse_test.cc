@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "../../src/kvstore/row_sparse.h"
+
+using mxnet::real_t;
+using namespace mxnet::kvstore;
+
+TEST(RowSparse, Ranges) {
+  std::vector<real_t> ids = {7, 2, 3, 7, -1, 100, 9};
+  auto rows = UniqueRows(ids.data(), ids.size(), 10);
+  EXPECT_EQ(rows, std::vector<size_t>({2, 3, 7, 9}));
+
+  // rows of 4 elements, the part [10, 30) cuts rows 2 and 7
+  auto ranges = RowRanges(rows, 4, 10, 30);
+  EXPECT_EQ(ranges, std::vector<Range>({{0, 6}, {18, 2}}));
+  EXPECT_EQ(RangesSize(ranges), 8U);
+  EXPECT_TRUE(RowRanges(rows, 4, 16, 28).empty());
+
+  auto merged = UnionRanges({{0, 2}, {5, 2}, {20, 1}}, {{1, 3}, {7, 1}, {10, 1}});
+  EXPECT_EQ(merged, std::vector<Range>({{0, 4}, {5, 3}, {10, 1}, {20, 1}}));
+}
+
+TEST(RowSparse, Message) {
+  std::vector<Range> ranges = {{1, 2}, {5, 1}};
+  std::vector<real_t> src = {0, 1, 2, 3, 4, 5, 6};
+  std::vector<real_t> msg(RangesHeaderSize(ranges) + RangesSize(ranges));
+  EncodeRanges(ranges, msg.data());
+  GatherRanges(src.data(), ranges, msg.data() + RangesHeaderSize(ranges));
+
+  std::vector<Range> decoded;
+  size_t header = DecodeRanges(msg.data(), msg.size(), src.size(), &decoded);
+  EXPECT_EQ(header, 5U);
+  EXPECT_EQ(decoded, ranges);
+  std::vector<real_t> dst(src.size(), 0);
+  ScatterRanges(msg.data() + header, decoded, dst.data());
+  EXPECT_EQ(dst, std::vector<real_t>({0, 1, 2, 0, 0, 5, 0}));
+  AddRanges(msg.data() + header, decoded, dst.data());
+  EXPECT_EQ(dst, std::vector<real_t>({0, 2, 4, 0, 0, 10, 0}));
+}
@@ -0,0 +1,40 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "../../src/kvstore/shm_transport.h"
+
+using mxnet::real_t;
+using mxnet::kvstore::ShmTransport;
+
+TEST(ShmTransport, Handshake) {
+  const std::string job = "test_" + std::to_string(getpid());
+  ShmTransport worker(job), server(job);
+  uint64_t nonce = worker.CreateMarker(3);
+  // a marker of another run, or no marker at all
+  EXPECT_FALSE(server.Accept(3, nonce + 1, 0));
+  EXPECT_FALSE(server.Accept(4, nonce, 0));
+  EXPECT_TRUE(server.Accept(3, nonce, 1));
+  EXPECT_EQ(worker.RemoveMarker(3), std::vector<bool>({false, true, false}));
+  EXPECT_FALSE(server.Accept(3, nonce, 1));
+}
+
+TEST(ShmTransport, Buffer) {
+  const std::string job = "test_" + std::to_string(getpid());
+  ShmTransport worker(job), server(job);
+  worker.CreateMarker(2);
+  worker.RemoveMarker(1);
+  const size_t len = 100;
+  real_t* wbuf = worker.WorkerBuffer(42, len);
+  for (size_t i = 0; i < len; ++i) wbuf[i] = i;
+
+  size_t slen;
+  real_t* sbuf = server.ServerBuffer(2, 42, &slen);
+  EXPECT_EQ(slen, len);
+  EXPECT_EQ(sbuf[7], 7);
+  sbuf[len + 5] = 3;
+  worker.Unlink(42);
+  // still mapped by both after unlinking
+  EXPECT_EQ(wbuf[len + 5], 3);
+  EXPECT_EQ(worker.WorkerBuffer(42, len), wbuf);
+}
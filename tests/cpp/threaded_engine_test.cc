@@ -6,6 +6,7 @@
 #include <gtest/gtest.h>
 #include <thread>
 #include <chrono>
+#include <memory>
 #include <vector>
 
 #include <mxnet/engine.h>
@@ -130,6 +131,36 @@ TEST(Engine, RandSumExpr) {
   LOG(INFO) << "ThreadedEnginePerDevice\t" << t[3] << " sec";
 }
 
+/**
+ * push throughput of empty operations from several threads, each writing a
+ * variable of its own
+ */
+TEST(Engine, PushThroughput) {
+  using namespace mxnet;
+  const int num_ops = 20000;
+  std::unique_ptr<Engine> engine(engine::CreateThreadedEnginePerDevice());
+  for (int num_threads = 1; num_threads <= 32; num_threads *= 2) {
+    std::vector<Engine::VarHandle> vars;
+    for (int i = 0; i < num_threads; ++i) vars.push_back(engine->NewVariable());
+    double t = dmlc::GetTime();
+    std::vector<std::thread> pushers;
+    for (int i = 0; i < num_threads; ++i) {
+      pushers.emplace_back([&engine, &vars, i]() {
+          for (int k = 0; k < num_ops; ++k) {
+            engine->PushSync([](RunContext) {}, Context::CPU(), {}, {vars[i]});
+          }
+        });
+    }
+    for (auto& p : pushers) p.join();
+    engine->WaitForAll();
+    t = dmlc::GetTime() - t;
+    LOG(INFO) << num_threads << " pusher threads\t"
+              << num_ops * num_threads / t << " ops/sec";
+    for (auto var : vars) engine->DeleteVariable([](RunContext) {}, Context::CPU(), var);
+    engine->WaitForAll();
+  }
+}
+
 void Foo(mxnet::RunContext, int i) { printf("The fox says %d\n", i); }
 
 TEST(Engine, basics) {
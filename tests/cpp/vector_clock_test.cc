@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "../../src/kvstore/vector_clock.h"
+
+using namespace mxnet::kvstore;
+
+TEST(VectorClock, Ticks) {
+  VectorClock vc(2);
+  vc.AddKey(0);
+  vc.AddKey(1);
+
+  // a worker moves once it pushed all keys, in any order
+  vc.Tick(0, 1);
+  EXPECT_EQ(vc.clock(0), 0);
+  EXPECT_EQ(vc.clock(0, 1), 1);
+  vc.Tick(0, 0);
+  EXPECT_EQ(vc.clock(0), 1);
+  EXPECT_EQ(vc.clock(), 0);
+
+  // worker 0 runs ahead on key 0, its clock follows its slowest key
+  vc.Tick(0, 0);
+  vc.Tick(0, 0);
+  EXPECT_EQ(vc.clock(0, 0), 3);
+  EXPECT_EQ(vc.clock(0), 1);
+  vc.Tick(0, 1);
+  EXPECT_EQ(vc.clock(0), 2);
+  vc.Tick(0, 1);
+  EXPECT_EQ(vc.clock(0), 3);
+
+  // the server follows the slowest worker
+  vc.Tick(1, 0);
+  vc.Tick(1, 1);
+  EXPECT_EQ(vc.clock(1), 1);
+  EXPECT_EQ(vc.clock(), 1);
+
+  // a key added later starts at the clock of each worker, which then waits
+  // for it
+  vc.AddKey(2);
+  EXPECT_EQ(vc.clock(0, 2), 3);
+  EXPECT_EQ(vc.clock(1, 2), 1);
+  vc.Tick(1, 0);
+  vc.Tick(1, 1);
+  EXPECT_EQ(vc.clock(1), 1);
+  vc.Tick(1, 2);
+  EXPECT_EQ(vc.clock(1), 2);
+  EXPECT_EQ(vc.clock(), 2);
+}
+
+TEST(VectorClock, WaitFor) {
+  VectorClock vc(2);
+  std::vector<int> fired;
+  // nothing to wait for before any key
+  vc.WaitFor(5, [&]() { fired.push_back(0); });
+  EXPECT_EQ(fired, std::vector<int>({0}));
+
+  vc.AddKey(0);
+  vc.WaitFor(0, [&]() { fired.push_back(1); });
+  EXPECT_EQ(fired, std::vector<int>({0, 1}));
+  vc.WaitFor(1, [&]() { fired.push_back(2); });
+  vc.WaitFor(2, [&]() { fired.push_back(3); });
+
+  vc.Tick(0, 0);
+  vc.Tick(0, 0);
+  EXPECT_EQ(fired.size(), 2U);
+  // the minimum reaches 1 with the slow worker
+  vc.Tick(1, 0);
+  EXPECT_EQ(fired, std::vector<int>({0, 1, 2}));
+  vc.Tick(0, 0);
+  EXPECT_EQ(fired.size(), 3U);
+  vc.Tick(1, 0);
+  EXPECT_EQ(fired, std::vector<int>({0, 1, 2, 3}));
+  // fired once only
+  vc.Tick(0, 0);
+  vc.Tick(1, 0);
+  EXPECT_EQ(fired.size(), 4U);
+}
+
+TEST(VectorClock, Lift) {
+  // a restored server, whose workers are at iterations 12 and 10
+  VectorClock vc(2);
+  vc.AddKey(0);
+  vc.AddKey(1);
+  vc.Tick(0, 0);
+  std::vector<int> fired;
+  vc.WaitFor(10, [&]() { fired.push_back(0); });
+  vc.Lift(0, 12);
+  EXPECT_EQ(vc.clock(0), 12);
+  EXPECT_EQ(vc.clock(0, 0), 12);
+  EXPECT_TRUE(fired.empty());
+  vc.Lift(1, 10);
+  EXPECT_EQ(vc.clock(), 10);
+  EXPECT_EQ(fired, std::vector<int>({0}));
+
+  // ticks go on from there, and clocks never move back
+  vc.Tick(1, 1);
+  vc.Tick(1, 0);
+  EXPECT_EQ(vc.clock(1), 11);
+  vc.Lift(0, 5);
+  EXPECT_EQ(vc.clock(0), 12);
+  EXPECT_EQ(vc.clock(), 11);
+
+  // a lift evens out the keys of the worker
+  vc.Tick(1, 0);
+  vc.Lift(1, 12);
+  EXPECT_EQ(vc.clock(1, 0), 12);
+  EXPECT_EQ(vc.clock(1), 12);
+  vc.Tick(1, 1);
+  EXPECT_EQ(vc.clock(1), 12);
+  vc.Tick(1, 0);
+  EXPECT_EQ(vc.clock(1), 13);
+}
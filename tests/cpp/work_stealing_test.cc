@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "../../src/engine/work_stealing_pool.h"
+
+using namespace mxnet::engine;
+
+TEST(WorkStealing, Deque) {
+  // the owner pops what it pushed last, thieves take what it pushed first
+  WorkStealingDeque<int> deque(2);
+  for (int i = 0; i < 5; ++i) deque.Push(i);
+  int x;
+  EXPECT_TRUE(deque.Steal(&x));
+  EXPECT_EQ(x, 0);
+  EXPECT_TRUE(deque.Pop(&x));
+  EXPECT_EQ(x, 4);
+  EXPECT_TRUE(deque.Pop(&x));
+  EXPECT_TRUE(deque.Pop(&x));
+  EXPECT_TRUE(deque.Pop(&x));
+  EXPECT_EQ(x, 1);
+  EXPECT_FALSE(deque.Pop(&x));
+  EXPECT_FALSE(deque.Steal(&x));
+  EXPECT_TRUE(deque.Empty());
+
+  // every element is taken exactly once while thieves race with the owner
+  const int n = 100000, num_thieves = 3;
+  std::vector<std::atomic<int> > taken(n);
+  for (auto& t : taken) t = 0;
+  std::atomic<bool> done{false};
+  std::vector<std::thread> thieves;
+  for (int k = 0; k < num_thieves; ++k) {
+    thieves.emplace_back([&]() {
+      int y;
+      while (!done.load() || !deque.Empty()) {
+        if (deque.Steal(&y)) ++taken[y];
+      }
+    });
+  }
+  for (int i = 0; i < n; ++i) {
+    deque.Push(i);
+    if (i % 3 == 0 && deque.Pop(&x)) ++taken[x];
+  }
+  while (deque.Pop(&x)) ++taken[x];
+  done = true;
+  for (auto& t : thieves) t.join();
+  for (int i = 0; i < n; ++i) EXPECT_EQ(taken[i].load(), 1) << i;
+}
+
+TEST(WorkStealing, Pool) {
+  // tasks push more tasks, as operations completing make others ready
+  const int depth = 12;
+  std::atomic<int> count{0};
+  {
+    WorkStealingPool<int>* pool = nullptr;
+    std::function<void(int)> run = [&](int level) {
+      ++count;
+      if (level < depth) {
+        pool->Push(level + 1);
+        pool->Push(level + 1);
+      }
+    };
+    pool = new WorkStealingPool<int>(4, run);
+    pool->Push(1);
+    const int total = (1 << depth) - 1;
+    while (count.load() < total) std::this_thread::yield();
+    delete pool;
+    EXPECT_EQ(count.load(), total);
+  }
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../src/kvstore/worker_grouping.h"
+
+using namespace mxnet::kvstore;
+
+namespace {
+// one iteration on key 0, in which the workers in slow take longer
+void Iterate(WorkerGrouping* grouping, int num_workers,
+             const std::vector<int>& slow) {
+  for (int r = 0; r < num_workers; ++r) grouping->OnReply(r, 0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  for (int r = 0; r < num_workers; ++r) {
+    if (std::find(slow.begin(), slow.end(), r) == slow.end()) {
+      grouping->OnPush(r, 0);
+    }
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(40));
+  for (int r : slow) grouping->OnPush(r, 0);
+}
+
+// one regrouping with the times of all servers, adopted by every server
+void Regroup(const std::vector<WorkerGrouping*>& servers) {
+  std::vector<std::string> times;
+  for (auto* s : servers) times.push_back(s->EncodeTimes());
+  std::string plan = WorkerGrouping::NextPlan(times);
+  if (plan.empty()) return;
+  for (auto* s : servers) s->Adopt(plan);
+}
+}  // namespace
+
+TEST(WorkerGrouping, Regroup) {
+  WorkerGrouping grouping(4, 2);
+  auto plan = grouping.plan();
+  EXPECT_EQ(plan->version, 0);
+  EXPECT_EQ(plan->members, std::vector<std::vector<int>>({{0, 1}, {2, 3}}));
+
+  // the slow workers 1 and 3 end up together
+  Iterate(&grouping, 4, {1, 3});
+  Iterate(&grouping, 4, {1, 3});
+  Regroup({&grouping});
+  plan = grouping.plan();
+  EXPECT_EQ(plan->version, 1);
+  EXPECT_EQ(plan->members, std::vector<std::vector<int>>({{0, 2}, {1, 3}}));
+  EXPECT_EQ(plan->group_of_rank, std::vector<int>({0, 1, 0, 1}));
+
+  // the plan is kept while a worker is not measured, the others are
+  // measured from the last regrouping
+  for (int r = 0; r < 3; ++r) grouping.OnReply(r, 0);
+  for (int r = 0; r < 3; ++r) grouping.OnPush(r, 0);
+  Regroup({&grouping});
+  EXPECT_EQ(grouping.plan(), plan);
+  EXPECT_EQ(grouping.plan()->version, 1);
+}
+
+TEST(WorkerGrouping, OneSlowWorker) {
+  WorkerGrouping grouping(5, 2);
+  EXPECT_EQ(grouping.plan()->members,
+            std::vector<std::vector<int>>({{0, 1}, {2, 3, 4}}));
+  Iterate(&grouping, 5, {0});
+  Regroup({&grouping});
+  auto plan = grouping.plan();
+  EXPECT_EQ(plan->version, 1);
+  EXPECT_EQ(plan->members, std::vector<std::vector<int>>({{1, 2, 3, 4}, {0}}));
+  EXPECT_EQ(plan->group_of_rank, std::vector<int>({1, 0, 0, 0, 0}));
+}
+
+TEST(WorkerGrouping, Servers) {
+  // worker 2 is slow on the keys of server a only, it is slow on average
+  WorkerGrouping a(4, 2), b(4, 2);
+  Iterate(&a, 4, {2});
+  Iterate(&a, 4, {2});
+  Iterate(&b, 4, {});
+  Regroup({&a, &b});
+  EXPECT_EQ(a.plan()->version, 1);
+  EXPECT_EQ(a.plan()->members, std::vector<std::vector<int>>({{0, 1, 3}, {2}}));
+  EXPECT_EQ(b.plan()->members, a.plan()->members);
+  EXPECT_EQ(b.EncodePlan(), a.EncodePlan());
+
+  // a restored server catches up with the plan of the others, and an old
+  // plan is ignored
+  WorkerGrouping restored(4, 2);
+  std::string old = restored.EncodePlan();
+  restored.Adopt(a.EncodePlan());
+  EXPECT_EQ(restored.plan()->members, a.plan()->members);
+  restored.Adopt(old);
+  EXPECT_EQ(restored.plan()->version, 1);
+
+  // the next plan is newer than that of every server, so a server still at
+  // an old plan adopts it too
+  WorkerGrouping fresh(4, 2);
+  for (auto* s : {&a, &fresh}) Iterate(s, 4, {0});
+  Regroup({&fresh, &a});
+  EXPECT_EQ(a.plan()->version, 2);
+  EXPECT_EQ(a.plan()->members, std::vector<std::vector<int>>({{1, 2, 3}, {0}}));
+  EXPECT_EQ(fresh.EncodePlan(), a.EncodePlan());
+}
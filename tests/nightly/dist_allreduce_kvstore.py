@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+# pylint: skip-file
+# run N workers on localhost: python dist_allreduce_kvstore.py [N]
+import os
+import sys
+import subprocess
+sys.path.insert(0, "../../python/")
+
+def launch(nworker):
+    procs = []
+    for rank in range(nworker):
+        env = os.environ.copy()
+        env.update({'DMLC_NUM_WORKER': str(nworker),
+                    'DMLC_WORKER_ID': str(rank),
+                    'DMLC_PS_ROOT_URI': '127.0.0.1',
+                    'DMLC_PS_ROOT_PORT': env.get('DMLC_PS_ROOT_PORT', '9191')})
+        procs.append(subprocess.Popen([sys.executable, __file__], env=env))
+    codes = [p.wait() for p in procs]
+    assert all(c == 0 for c in codes), codes
+
+if 'DMLC_WORKER_ID' not in os.environ:
+    launch(int(sys.argv[1]) if len(sys.argv) > 1 else 4)
+    sys.exit(0)
+
+import mxnet as mx
+import numpy as np
+
+def check_diff_to_scalar(A, x):
+    """ assert A == x"""
+    assert(np.sum(np.abs((A - x).asnumpy())) == 0), A.asnumpy()
+
+keys = [3, 5, 7]
+shape = (2, 2)
+big_shape = (1200, 1200)        # summed along the ring
+
+kv = mx.kv.create('dist_allreduce')
+my_rank = kv.rank
+nworker = kv.num_workers
+
+# every worker starts from the values of rank 0
+kv.init(keys, [mx.nd.ones(shape) * (my_rank + 1)] * len(keys))
+kv.init(99, mx.nd.ones(big_shape) * (my_rank + 1))
+
+def test_init():
+    val = mx.nd.zeros(shape)
+    kv.pull(5, out = val)
+    check_diff_to_scalar(val, 1)
+
+def test_sum():
+    total = (nworker + 1) * nworker / 2
+    for key, s in [(3, shape), (99, big_shape)]:
+        kv.push(key, mx.nd.ones(s) * (my_rank + 1))
+        val = mx.nd.zeros(s)
+        kv.pull(key, out = val)
+        check_diff_to_scalar(val, total)
+
+def test_updater():
+    def update(key, grad, weight, num):
+        weight[:] += grad / num
+    kv._set_updater(update)
+    nrepeat = 3
+    for i in range(nrepeat):
+        kv.push(7, mx.nd.ones(shape) * (my_rank + 1))
+    val = mx.nd.zeros(shape)
+    kv.pull(7, out = val)
+    check_diff_to_scalar(val, 1 + (nworker + 1) / 2.0 * nrepeat)
+
+if __name__ == "__main__":
+    test_init()
+    test_sum()
+    kv._barrier()
+    test_updater()
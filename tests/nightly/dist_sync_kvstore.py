@@ -15,6 +15,8 @@ keys = [3, 5, 7]
 rate = 2
 shape = (2, 2)
 big_shape = (1200, 1200)        # big than BIGARRAY_BOUND
+mid_shape = (50, 50)            # sliced, yet below the fusion threshold, when
+                                # test_all.sh sets both
 
 
 kv = mx.kv.create('dist_sync')
@@ -22,6 +24,7 @@ kv = mx.kv.create('dist_sync')
 # init kv
 kv.init(keys, [mx.nd.ones(shape)] * len(keys))
 kv.init(99, mx.nd.ones(big_shape))
+kv.init(11, mx.nd.ones(mid_shape))
 # init updater on servers
 kv.set_optimizer(mx.optimizer.create('test', rate))
 
@@ -33,6 +36,7 @@ def test_sync_push_pull():
     for i in range(nrepeat):
         kv.push(3, mx.nd.ones(shape)*(my_rank+1))
         kv.push(99, mx.nd.ones(big_shape)*(my_rank+1))
+        kv.push(11, mx.nd.ones(mid_shape)*(my_rank+1))
 
     num = (nworker + 1 ) * nworker * rate / 2 * nrepeat + 1
     val = mx.nd.zeros(shape)
@@ -44,5 +48,9 @@ def test_sync_push_pull():
     kv.pull(99, out = val2)
     check_diff_to_scalar(val2, num)
 
+    val3 = mx.nd.zeros(mid_shape)
+    kv.pull(11, out = val3)
+    check_diff_to_scalar(val3, num)
+
 if __name__ == "__main__":
     test_sync_push_pull()
@@ -35,6 +35,8 @@ juLog -name=Python.Local.KVStore -error=Error python test_kvstore.py
 
 # python: distributed kvstore
 juLog -name=Python.Distributed.KVStore -error=Error ../../tools/launch.py -n 4 python dist_sync_kvstore.py
+MXNET_KVSTORE_SLICE_SIZE=1000 MXNET_KVSTORE_FUSION_THRESHOLD=100000 \
+  juLog -name=Python.Distributed.KVStore.FusionSlice -error=Error ../../tools/launch.py -n 4 python dist_sync_kvstore.py
 
 # download data
 juLog -name=DownloadData bash ./download.sh
@@ -1,3 +1,4 @@
+import os
 import numpy as np
 import mxnet as mx
 
@@ -129,6 +130,54 @@ def test_reshape():
     exe.forward(is_train=False)
     assert np.all(exe.outputs[0].asnumpy() == 4)
 
+def check_bulk_exec(env):
+    """run forward and backward of a small net with the environment env,
+    return the outputs, the gradients and the gradients notified ready"""
+    old_env = dict((k, os.environ.get(k)) for k in env)
+    os.environ.update(env)
+    try:
+        data = mx.sym.Variable('data')
+        net = mx.sym.FullyConnected(data, num_hidden=8, name='fc1')
+        net = mx.sym.Activation(net, act_type='relu')
+        net = mx.sym.FullyConnected(net, num_hidden=6, name='fc2')
+        net = mx.sym.Activation(net, act_type='tanh')
+        net = mx.sym.FullyConnected(net, num_hidden=4, name='fc3')
+        np.random.seed(0)
+        shapes, _, _ = net.infer_shape(data=(5, 3))
+        args = [mx.nd.array(np.random.uniform(-1, 1, s)) for s in shapes]
+        grads = [mx.nd.zeros(s) for s in shapes]
+        exe = net.bind(mx.cpu(), args=args, args_grad=grads)
+        ready = []
+        exe.set_grad_ready_callback(lambda i, _: ready.append(i))
+        head_grad = mx.nd.array(np.random.uniform(-1, 1, (5, 4)))
+        for _ in range(2):
+            exe.forward(is_train=True)
+            exe.backward([head_grad])
+        outputs = exe.outputs[0].asnumpy()
+        return outputs, [g.asnumpy() for g in grads], ready
+    finally:
+        for k, v in old_env.items():
+            if v is None:
+                del os.environ[k]
+            else:
+                os.environ[k] = v
+
+
+def test_bulk_exec():
+    out, grads, ready = check_bulk_exec({'MXNET_EXEC_PREFER_BULK_EXEC': '0'})
+    num_args = len(grads)
+    assert sorted(ready) == sorted(list(range(num_args)) * 2)
+    for max_node in ['1', '3', '1000']:
+        out2, grads2, ready2 = check_bulk_exec(
+            {'MXNET_EXEC_PREFER_BULK_EXEC': '1',
+             'MXNET_EXEC_BULK_EXEC_MAX_NODE_TRAIN': max_node})
+        assert reldiff(out, out2) < 1e-6
+        for g, g2 in zip(grads, grads2):
+            assert reldiff(g, g2) < 1e-6
+        # once per argument in every backward
+        assert sorted(ready2) == sorted(list(range(num_args)) * 2)
+
 if __name__ == "__main__":
     test_bind()
     test_reshape()
+    test_bulk_exec()
@@ -117,10 +117,22 @@ def test_get_type():
     kv = mx.kv.create(kvtype)
     assert kv.type == kvtype
 
+def test_slice_key_multipliers():
+    """slices of an array on servers share its lr and wd multipliers"""
+    opt = mx.optimizer.SGD(learning_rate=0.1, wd=0.01,
+                           param_idx2name={3: 'fc_weight'})
+    opt.set_lr_mult({'fc_weight': 2.0})
+    opt.set_wd_mult({'fc_weight': 0.5})
+    slice_key = (1 << 30) + 3 * 1024 + 2
+    assert opt._get_lr(slice_key) == opt._get_lr(3) == 0.2
+    assert opt._get_wd(slice_key) == opt._get_wd(3) == 0.005
+    assert opt._get_lr(4) == 0.1
+
 if __name__ == '__main__':
     test_init()
     test_get_type()
     test_single_kv_pair()
     test_list_kv_pair()
     test_aggregator()
-    test_updater()
\ No newline at end of file
+    test_updater()
+    test_slice_key_multipliers()
\ No newline at end of file